@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * compact_entries -- compares regions with regular entries and regions allocated with
+ * PMEMSTREAM_REGION_COMPACT_ENTRIES flag, for small records. For each record size, it measures mean time of a single
+ * append and capacity of a region: number of records which fit in 1 MiB of a region.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+constexpr size_t MiB = 1024 * 1024;
+
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	std::vector<size_t> element_sizes = {8, 16, 32, 64};
+	size_t element_count = 100000;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_sizes = {std::stoull(optarg)};
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_count == 0) {
+			throw std::invalid_argument("Invalid element_count");
+		}
+		if (iterations == 0) {
+			throw std::invalid_argument("Invalid iterations");
+		}
+		return 0;
+	}
+
+	/* Each entry occupies at most its size and 16 bytes of metadata (rounded up to 8 bytes). */
+	size_t region_size(size_t element_size) const
+	{
+		return element_count * (element_size + 24);
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares appends to regions with regular and compact entries.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_size [size]", "number of bytes of each element (8, 16, 32 and 64 by default)"},
+			{"--element_count [count]", "number of elements appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+class append_workload : public benchmark::workload_base {
+ public:
+	append_workload(const config &cfg, size_t element_size, uint64_t region_flags)
+	    : cfg(cfg), element_size(element_size), region_flags(region_flags)
+	{
+		prepare_data(element_size);
+	}
+
+	void initialize() override
+	{
+		map = map_open(cfg.path.c_str(), cfg.size, true);
+		if (!map) {
+			throw std::runtime_error(pmem2_errormsg());
+		}
+
+		if (pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map)) {
+			throw std::runtime_error("pmemstream_from_map failed");
+		}
+
+		size_t region_size = cfg.region_size(element_size);
+		if (pmemstream_region_allocate_with_flags(stream, region_size, region_flags, &region) ||
+		    pmemstream_region_runtime_initialize(stream, region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+	}
+
+	void perform() override
+	{
+		for (size_t i = 0; i < cfg.element_count; i++) {
+			if (pmemstream_append(stream, region, region_runtime, get_data_chunks(), element_size,
+					      nullptr)) {
+				throw std::runtime_error("Error while appending");
+			}
+		}
+	}
+
+	void clean() override
+	{
+		pmemstream_delete(&stream);
+		pmem2_map_delete(&map);
+	}
+
+ private:
+	const config &cfg;
+	size_t element_size;
+	uint64_t region_flags;
+
+	struct pmem2_map *map = nullptr;
+	struct pmemstream *stream = nullptr;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+};
+
+/* Returns mean time (in nanoseconds) of a single append. */
+double measure_append(const config &cfg, size_t element_size, uint64_t region_flags)
+{
+	append_workload workload(cfg, element_size, region_flags);
+	auto results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload);
+	return benchmark::mean(results) / static_cast<double>(cfg.element_count);
+}
+
+/* Returns number of elements which fit in 1 MiB region. */
+size_t measure_capacity(const config &cfg, size_t element_size, uint64_t region_flags)
+{
+	struct pmem2_map *map = map_open(cfg.path.c_str(), cfg.size, true);
+	if (!map) {
+		throw std::runtime_error(pmem2_errormsg());
+	}
+
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+	if (pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map)) {
+		pmem2_map_delete(&map);
+		throw std::runtime_error("pmemstream_from_map failed");
+	}
+
+	size_t count = 0;
+	if (pmemstream_region_allocate_with_flags(stream, MiB, region_flags, &region) == 0) {
+		std::vector<uint8_t> data(element_size, 0xAB);
+		while (pmemstream_append(stream, region, nullptr, data.data(), element_size, nullptr) == 0) {
+			count++;
+		}
+	}
+
+	pmemstream_delete(&stream);
+	pmem2_map_delete(&map);
+
+	if (count == 0) {
+		throw std::runtime_error("Error during region allocation");
+	}
+	return count;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	const std::vector<std::pair<std::string, uint64_t>> formats = {{"regular", 0},
+								       {"compact", PMEMSTREAM_REGION_COMPACT_ENTRIES}};
+
+	std::cout << "compact_entries measurement (element_count: " << cfg.element_count << "):" << std::endl;
+	std::cout << std::setw(15) << std::left << "element_size" << std::setw(12) << "entries" << std::setw(20)
+		  << "time [ns/append]" << std::setw(20) << "throughput [MB/s]" << std::setw(20)
+		  << "capacity [entries/MiB]" << std::endl;
+
+	try {
+		for (auto element_size : cfg.element_sizes) {
+			for (auto &format : formats) {
+				double time = measure_append(cfg, element_size, format.second);
+				double throughput = static_cast<double>(element_size) * 1000.0 / time;
+				size_t capacity = measure_capacity(cfg, element_size, format.second);
+				std::cout << std::setw(15) << element_size << std::setw(12) << format.first
+					  << std::setw(20) << time << std::setw(20) << throughput << std::setw(20)
+					  << capacity << std::endl;
+			}
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * compressed_entries -- compares regions with regular entries and regions allocated with
+ * PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ) flag, for JSON-like records. For each record size, it measures mean
+ * time of a single append, mean time of reading an entry into a DRAM buffer and space taken by a single entry.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 256;
+	std::vector<size_t> element_sizes = {64, 256, 1024, 4096};
+	size_t element_count = 10000;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_sizes = {std::stoull(optarg)};
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_count == 0) {
+			throw std::invalid_argument("Invalid element_count");
+		}
+		if (iterations == 0) {
+			throw std::invalid_argument("Invalid iterations");
+		}
+		return 0;
+	}
+
+	/* Each entry occupies at most its size and 24 bytes of metadata (rounded up to 8 bytes). */
+	size_t region_size(size_t element_size) const
+	{
+		return element_count * (element_size + 32);
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares appends to (and reads from) regions with regular and compressed entries.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_size [size]", "number of bytes of each element (64, 256, 1024, 4096 by default)"},
+			{"--element_count [count]", "number of elements appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+/* Returns 'size' bytes of JSON records, which differ in a few fields only. */
+std::vector<uint8_t> make_json_records(size_t size)
+{
+	std::vector<uint8_t> data;
+	for (size_t i = 0; data.size() < size; i++) {
+		std::string record = "{\"id\": " + std::to_string(i) + ", \"user\": \"user" + std::to_string(i % 7) +
+			"\", \"status\": \"active\", \"score\": " + std::to_string((i * 37) % 101) + "}, ";
+		data.insert(data.end(), record.begin(), record.end());
+	}
+	data.resize(size);
+	return data;
+}
+
+struct append_result {
+	double append_time;
+	double read_time;
+	double entry_space;
+};
+
+append_result measure(const config &cfg, size_t element_size, uint64_t region_flags)
+{
+	std::vector<uint8_t> data = make_json_records(element_size);
+	std::vector<uint8_t> buffer(element_size);
+	append_result result = {0, 0, 0};
+
+	for (size_t iteration = 0; iteration < cfg.iterations; iteration++) {
+		struct pmem2_map *map = map_open(cfg.path.c_str(), cfg.size, true);
+		if (!map) {
+			throw std::runtime_error(pmem2_errormsg());
+		}
+
+		struct pmemstream *stream;
+		if (pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map)) {
+			pmem2_map_delete(&map);
+			throw std::runtime_error("pmemstream_from_map failed");
+		}
+
+		struct pmemstream_region region;
+		struct pmemstream_region_runtime *region_runtime;
+		if (pmemstream_region_allocate_with_flags(stream, cfg.region_size(element_size), region_flags,
+							  &region) ||
+		    pmemstream_region_runtime_initialize(stream, region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+		size_t initial_usable_size = pmemstream_region_usable_size(stream, region);
+
+		auto append_time = benchmark::measure<std::chrono::nanoseconds>([&]() {
+			for (size_t i = 0; i < cfg.element_count; i++) {
+				if (pmemstream_append(stream, region, region_runtime, data.data(), data.size(),
+						      nullptr)) {
+					throw std::runtime_error("Error while appending");
+				}
+			}
+		});
+
+		struct pmemstream_entry_iterator *it;
+		if (pmemstream_entry_iterator_new(&it, stream, region)) {
+			throw std::runtime_error("Error during iterator creation");
+		}
+		auto read_time = benchmark::measure<std::chrono::nanoseconds>([&]() {
+			for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+			     pmemstream_entry_iterator_next(it)) {
+				auto entry = pmemstream_entry_iterator_get(it);
+				if (pmemstream_entry_read(stream, entry, buffer.data(), buffer.size())) {
+					throw std::runtime_error("Error while reading");
+				}
+			}
+		});
+		pmemstream_entry_iterator_delete(&it);
+
+		if (std::memcmp(buffer.data(), data.data(), data.size()) != 0) {
+			throw std::runtime_error("Read data differs from appended one");
+		}
+
+		size_t used_size = initial_usable_size - pmemstream_region_usable_size(stream, region);
+		result.append_time += static_cast<double>(append_time);
+		result.read_time += static_cast<double>(read_time);
+		result.entry_space += static_cast<double>(used_size);
+
+		pmemstream_delete(&stream);
+		pmem2_map_delete(&map);
+	}
+
+	double operations = static_cast<double>(cfg.element_count * cfg.iterations);
+	result.append_time /= operations;
+	result.read_time /= operations;
+	result.entry_space /= operations;
+	return result;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	const std::vector<std::pair<std::string, uint64_t>> formats = {
+		{"regular", 0}, {"lz", PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ)}};
+
+	std::cout << "compressed_entries measurement (element_count: " << cfg.element_count << "):" << std::endl;
+	std::cout << std::setw(15) << std::left << "element_size" << std::setw(12) << "entries" << std::setw(20)
+		  << "append [ns/entry]" << std::setw(20) << "read [ns/entry]" << std::setw(20) << "space [B/entry]"
+		  << std::endl;
+
+	try {
+		for (auto element_size : cfg.element_sizes) {
+			for (auto &format : formats) {
+				auto result = measure(cfg, element_size, format.second);
+				std::cout << std::setw(15) << element_size << std::setw(12) << format.first
+					  << std::setw(20) << result.append_time << std::setw(20) << result.read_time
+					  << std::setw(20) << result.entry_space << std::endl;
+			}
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
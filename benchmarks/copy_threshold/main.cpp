@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * copy_threshold -- compares synchronous appends with data copied using regular stores (and flushed on commit)
+ * against data copied using non-temporal stores, for a range of entry sizes. Prints a suggested value for
+ * pmemstream_config_set_nontemporal_copy_threshold: the smallest entry size, starting from which non-temporal
+ * copies are faster.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	size_t min_element_size = 64;
+	size_t max_element_size = 64 * 1024;
+	size_t bytes_per_iteration = TEST_DEFAULT_STREAM_SIZE * 16;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"min_element_size", required_argument, NULL, 'm'},
+							  {"max_element_size", required_argument, NULL, 'M'},
+							  {"bytes_per_iteration", required_argument, NULL, 'b'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:m:M:b:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 'm':
+					min_element_size = std::stoull(optarg);
+					break;
+				case 'M':
+					max_element_size = std::stoull(optarg);
+					break;
+				case 'b':
+					bytes_per_iteration = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (min_element_size == 0 || min_element_size > max_element_size) {
+			throw std::invalid_argument("Invalid element sizes");
+		}
+		if (iterations == 0) {
+			throw std::invalid_argument("Invalid iterations");
+		}
+		if (bytes_per_iteration < max_element_size || bytes_per_iteration * 2 > size) {
+			throw std::invalid_argument("bytes_per_iteration must fit (twice) in the stream");
+		}
+		return 0;
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares regular and non-temporal copies of appended entries.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--min_element_size [size]", "smallest entry size to be measured"},
+			{"--max_element_size [size]", "biggest entry size to be measured (sizes are doubled)"},
+			{"--bytes_per_iteration [size]", "number of bytes appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(30) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+class append_workload : public benchmark::workload_base {
+ public:
+	append_workload(const config &cfg, size_t element_size, size_t threshold)
+	    : cfg(cfg), element_size(element_size), threshold(threshold)
+	{
+		prepare_data(element_size);
+	}
+
+	void initialize() override
+	{
+		map = map_open(cfg.path.c_str(), cfg.size, true);
+		if (!map) {
+			throw std::runtime_error(pmem2_errormsg());
+		}
+
+		struct pmemstream_config *stream_config;
+		if (pmemstream_config_new(&stream_config) ||
+		    pmemstream_config_set_nontemporal_copy_threshold(stream_config, threshold)) {
+			throw std::runtime_error("Cannot create config");
+		}
+		int ret = pmemstream_from_map_with_config(&stream, TEST_DEFAULT_BLOCK_SIZE, map, stream_config);
+		pmemstream_config_delete(&stream_config);
+		if (ret) {
+			throw std::runtime_error("pmemstream_from_map_with_config failed");
+		}
+
+		if (pmemstream_region_allocate(stream, cfg.bytes_per_iteration * 2, &region) ||
+		    pmemstream_region_runtime_initialize(stream, region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+	}
+
+	void perform() override
+	{
+		size_t count = cfg.bytes_per_iteration / element_size;
+		for (size_t i = 0; i < count; i++) {
+			if (pmemstream_append(stream, region, region_runtime, get_data_chunks(), element_size, nullptr)) {
+				throw std::runtime_error("Error while appending");
+			}
+		}
+	}
+
+	void clean() override
+	{
+		pmemstream_delete(&stream);
+		pmem2_map_delete(&map);
+	}
+
+ private:
+	const config &cfg;
+	size_t element_size;
+	size_t threshold;
+
+	struct pmem2_map *map = nullptr;
+	struct pmemstream *stream = nullptr;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+};
+
+/* Returns mean time (in nanoseconds) of a single append. */
+double measure_append(const config &cfg, size_t element_size, size_t threshold)
+{
+	append_workload workload(cfg, element_size, threshold);
+	auto results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload);
+	return benchmark::mean(results) / static_cast<double>(cfg.bytes_per_iteration / element_size);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	static constexpr size_t never_nontemporal = SIZE_MAX;
+	static constexpr size_t always_nontemporal = 0;
+
+	std::cout << std::setw(15) << std::left << "element_size" << std::setw(20) << "regular [ns/append]"
+		  << std::setw(25) << "non-temporal [ns/append]" << std::endl;
+
+	size_t suggested_threshold = never_nontemporal;
+	try {
+		for (size_t element_size = cfg.min_element_size; element_size <= cfg.max_element_size;
+		     element_size *= 2) {
+			double regular = measure_append(cfg, element_size, never_nontemporal);
+			double nontemporal = measure_append(cfg, element_size, always_nontemporal);
+			std::cout << std::setw(15) << element_size << std::setw(20) << regular << std::setw(25)
+				  << nontemporal << std::endl;
+
+			/* Threshold is the smallest size, starting from which non-temporal copies always win. */
+			if (nontemporal < regular) {
+				if (suggested_threshold == never_nontemporal)
+					suggested_threshold = element_size;
+			} else {
+				suggested_threshold = never_nontemporal;
+			}
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	if (suggested_threshold == never_nontemporal) {
+		std::cout << "suggested nontemporal_copy_threshold: SIZE_MAX (non-temporal copies never win)"
+			  << std::endl;
+	} else {
+		std::cout << "suggested nontemporal_copy_threshold: " << suggested_threshold << std::endl;
+	}
+
+	return 0;
+}
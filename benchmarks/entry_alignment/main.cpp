@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * entry_alignment -- compares synchronous appends to regions with entries aligned to 8 B (default), 64 B
+ * (PMEMSTREAM_REGION_ENTRY_ALIGN_64) and 256 B (PMEMSTREAM_REGION_ENTRY_ALIGN_256). For each alignment, it measures
+ * mean time of an append and estimates write amplification: number of 256 B media blocks (XPLines) touched by
+ * flushes, multiplied by the block size and divided by the number of appended bytes. Each flushed block is counted
+ * separately, so it's an upper bound - the device might combine writes to the same block.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "libpmemstream_internal.h"
+#include "measure.hpp"
+#include "runtime_counters.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+constexpr size_t media_block_size = benchmark::runtime_counters::media_block_size;
+
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	size_t element_size = 64;
+	size_t element_count = 100000;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_size = std::stoull(optarg);
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_size == 0 || element_count == 0) {
+			throw std::invalid_argument("Invalid element_size or element_count");
+		}
+		if (iterations == 0) {
+			throw std::invalid_argument("Invalid iterations");
+		}
+		return 0;
+	}
+
+	/* Each entry occupies at most its size, metadata and two media blocks of padding. */
+	size_t region_size() const
+	{
+		return element_count * (element_size + sizeof(struct span_entry) + 2 * media_block_size);
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares appends to regions with different entry alignments.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_size [size]", "number of bytes of each element"},
+			{"--element_count [count]", "number of elements appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+class append_workload : public benchmark::workload_base {
+ public:
+	append_workload(const config &cfg, uint64_t region_flags, bool count_flushes)
+	    : cfg(cfg), region_flags(region_flags), count_flushes(count_flushes)
+	{
+		prepare_data(cfg.element_size);
+	}
+
+	void initialize() override
+	{
+		map = map_open(cfg.path.c_str(), cfg.size, true);
+		if (!map) {
+			throw std::runtime_error(pmem2_errormsg());
+		}
+
+		/* Data is always copied with regular stores, so that all of it is flushed on commit. */
+		struct pmemstream_config *stream_config;
+		if (pmemstream_config_new(&stream_config) ||
+		    pmemstream_config_set_nontemporal_copy_threshold(stream_config, SIZE_MAX)) {
+			throw std::runtime_error("Cannot create config");
+		}
+		int ret = pmemstream_from_map_with_config(&stream, TEST_DEFAULT_BLOCK_SIZE, map, stream_config);
+		pmemstream_config_delete(&stream_config);
+		if (ret) {
+			throw std::runtime_error("pmemstream_from_map_with_config failed");
+		}
+
+		if (pmemstream_region_allocate_with_flags(stream, cfg.region_size(), region_flags, &region) ||
+		    pmemstream_region_runtime_initialize(stream, region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+
+		if (count_flushes) {
+			benchmark::runtime_counters::install(stream);
+		}
+	}
+
+	void perform() override
+	{
+		for (size_t i = 0; i < cfg.element_count; i++) {
+			if (pmemstream_append(stream, region, region_runtime, get_data_chunks(), cfg.element_size,
+					      nullptr)) {
+				throw std::runtime_error("Error while appending");
+			}
+		}
+	}
+
+	void clean() override
+	{
+		if (count_flushes) {
+			benchmark::runtime_counters::uninstall(stream);
+		}
+		pmemstream_delete(&stream);
+		pmem2_map_delete(&map);
+	}
+
+ private:
+	const config &cfg;
+	uint64_t region_flags;
+	bool count_flushes;
+
+	struct pmem2_map *map = nullptr;
+	struct pmemstream *stream = nullptr;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+};
+
+/* Returns mean time (in nanoseconds) of a single append. */
+double measure_append(const config &cfg, uint64_t region_flags)
+{
+	append_workload workload(cfg, region_flags, false);
+	auto results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload);
+	return benchmark::mean(results) / static_cast<double>(cfg.element_count);
+}
+
+/* Returns number of bytes of media blocks touched by flushes per each appended byte. */
+double measure_write_amplification(const config &cfg, uint64_t region_flags)
+{
+	append_workload workload(cfg, region_flags, true);
+	benchmark::runtime_counters::reset();
+	benchmark::measure<std::chrono::nanoseconds>(1, &workload);
+	return static_cast<double>(benchmark::runtime_counters::flushed_blocks * media_block_size) /
+		static_cast<double>(cfg.element_count * cfg.element_size);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	const std::vector<std::pair<std::string, uint64_t>> alignments = {
+		{"8 B", 0}, {"64 B", PMEMSTREAM_REGION_ENTRY_ALIGN_64}, {"256 B", PMEMSTREAM_REGION_ENTRY_ALIGN_256}};
+
+	std::cout << "entry_alignment measurement (element_count: " << cfg.element_count
+		  << ", element_size: " << cfg.element_size << "):" << std::endl;
+	std::cout << std::setw(12) << std::left << "alignment" << std::setw(20) << "time [ns/append]"
+		  << std::setw(25) << "throughput [MB/s]" << std::setw(25) << "write amplification" << std::endl;
+
+	try {
+		for (auto &alignment : alignments) {
+			double time = measure_append(cfg, alignment.second);
+			double throughput = static_cast<double>(cfg.element_size) * 1000.0 / time;
+			double write_amplification = measure_write_amplification(cfg, alignment.second);
+			std::cout << std::setw(12) << alignment.first << std::setw(20) << time << std::setw(25)
+				  << throughput << std::setw(25) << write_amplification << std::endl;
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * entry_checksums -- compares synchronous appends to regions with regular entries and regions allocated with
+ * PMEMSTREAM_REGION_ENTRY_CHECKSUMS flag (for single and multi-writer regions). For each format, it measures mean
+ * time of an append and number of drains (including persists) issued per append.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "libpmemstream_internal.h"
+#include "measure.hpp"
+#include "runtime_counters.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	std::vector<size_t> element_sizes = {8, 64, 256, 1024};
+	size_t element_count = 100000;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_sizes = {std::stoull(optarg)};
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_count == 0) {
+			throw std::invalid_argument("Invalid element_count");
+		}
+		if (iterations == 0) {
+			throw std::invalid_argument("Invalid iterations");
+		}
+		return 0;
+	}
+
+	/* Each entry occupies at most its size and 24 bytes of metadata (rounded up to 8 bytes). */
+	size_t region_size(size_t element_size) const
+	{
+		return element_count * (element_size + 32);
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares appends to regions with and without entry checksums.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_size [size]", "number of bytes of each element (8, 64, 256 and 1024 by default)"},
+			{"--element_count [count]", "number of elements appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+class append_workload : public benchmark::workload_base {
+ public:
+	append_workload(const config &cfg, size_t element_size, uint64_t region_flags)
+	    : cfg(cfg), element_size(element_size), region_flags(region_flags)
+	{
+		prepare_data(element_size);
+	}
+
+	void initialize() override
+	{
+		map = map_open(cfg.path.c_str(), cfg.size, true);
+		if (!map) {
+			throw std::runtime_error(pmem2_errormsg());
+		}
+
+		if (pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map)) {
+			throw std::runtime_error("pmemstream_from_map failed");
+		}
+
+		size_t region_size = cfg.region_size(element_size);
+		if (pmemstream_region_allocate_with_flags(stream, region_size, region_flags, &region) ||
+		    pmemstream_region_runtime_initialize(stream, region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+
+		benchmark::runtime_counters::install(stream);
+	}
+
+	void perform() override
+	{
+		for (size_t i = 0; i < cfg.element_count; i++) {
+			if (pmemstream_append(stream, region, region_runtime, get_data_chunks(), element_size,
+					      nullptr)) {
+				throw std::runtime_error("Error while appending");
+			}
+		}
+	}
+
+	void clean() override
+	{
+		benchmark::runtime_counters::uninstall(stream);
+		pmemstream_delete(&stream);
+		pmem2_map_delete(&map);
+	}
+
+ private:
+	const config &cfg;
+	size_t element_size;
+	uint64_t region_flags;
+
+	struct pmem2_map *map = nullptr;
+	struct pmemstream *stream = nullptr;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	const std::vector<std::pair<std::string, uint64_t>> formats = {
+		{"regular", 0},
+		{"checksums", PMEMSTREAM_REGION_ENTRY_CHECKSUMS},
+		{"regular-mw", PMEMSTREAM_REGION_MULTI_WRITER},
+		{"checksums-mw", PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_MULTI_WRITER}};
+
+	std::cout << "entry_checksums measurement (element_count: " << cfg.element_count << "):" << std::endl;
+	std::cout << std::setw(15) << std::left << "element_size" << std::setw(15) << "entries" << std::setw(20)
+		  << "time [ns/append]" << std::setw(20) << "drains per append" << std::endl;
+
+	try {
+		for (auto element_size : cfg.element_sizes) {
+			for (auto &format : formats) {
+				append_workload workload(cfg, element_size, format.second);
+				benchmark::runtime_counters::reset();
+				auto results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload);
+				double appends = static_cast<double>(cfg.element_count * cfg.iterations);
+				double time = benchmark::mean(results) / static_cast<double>(cfg.element_count);
+				double drains = static_cast<double>(benchmark::runtime_counters::drains) / appends;
+				std::cout << std::setw(15) << element_size << std::setw(15) << format.first
+					  << std::setw(20) << time << std::setw(20) << drains << std::endl;
+			}
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
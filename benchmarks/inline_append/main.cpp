@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * inline_append -- compares synchronous appends of small entries, which are copied inline by the stream, with
+ * appends which copy data using a vdm future (async append with data_mover_sync, waited for right away).
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	std::vector<size_t> element_sizes = {16, 64, 256};
+	size_t element_count = 100000;
+	size_t iterations = 3;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_sizes", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"iterations", required_argument, NULL, 'i'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:i:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_sizes = parse_sizes(optarg);
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_count == 0 || iterations == 0) {
+			throw std::invalid_argument("Invalid element_count or iterations");
+		}
+		for (auto element_size : element_sizes) {
+			if (element_size == 0 || element_count * (element_size + 16) * 2 > size) {
+				throw std::invalid_argument("Entries do not fit in the stream, please increase size");
+			}
+		}
+		return 0;
+	}
+
+	static std::vector<size_t> parse_sizes(const std::string &arg)
+	{
+		std::vector<size_t> sizes;
+		std::stringstream stream(arg);
+		std::string size;
+		while (std::getline(stream, size, ',')) {
+			sizes.push_back(std::stoull(size));
+		}
+		return sizes;
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares inline and vdm-based copies of small, synchronously appended entries.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_sizes [size,...]", "comma separated list of entry sizes"},
+			{"--element_count [count]", "number of elements appended in each iteration"},
+			{"--iterations [count]", "number of iterations"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(30) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+class append_workload : public benchmark::workload_base {
+ public:
+	append_workload(const config &cfg, size_t element_size, bool inline_copy)
+	    : cfg(cfg), element_size(element_size), inline_copy(inline_copy)
+	{
+		prepare_data(element_size);
+	}
+
+	void initialize() override
+	{
+		stream = make_pmemstream(cfg.path, TEST_DEFAULT_BLOCK_SIZE, cfg.size);
+		if (pmemstream_region_allocate(stream.get(), cfg.size / 2, &region) ||
+		    pmemstream_region_runtime_initialize(stream.get(), region, &region_runtime)) {
+			throw std::runtime_error("Error during region allocation");
+		}
+		dms = data_mover_sync_new();
+		if (!dms) {
+			throw std::runtime_error("Cannot create data mover");
+		}
+	}
+
+	void perform() override
+	{
+		for (size_t i = 0; i < cfg.element_count; i++) {
+			inline_copy ? append_inline() : append_vdm();
+		}
+	}
+
+	void clean() override
+	{
+		data_mover_sync_delete(dms);
+		stream.reset();
+	}
+
+ private:
+	void append_inline()
+	{
+		if (pmemstream_append(stream.get(), region, region_runtime, get_data_chunks(), element_size, nullptr)) {
+			throw std::runtime_error("Error while appending");
+		}
+	}
+
+	void append_vdm()
+	{
+		struct pmemstream_entry entry;
+		if (pmemstream_async_append(stream.get(), data_mover_sync_get_vdm(dms), region, region_runtime,
+					    get_data_chunks(), element_size, &entry)) {
+			throw std::runtime_error("Error while appending");
+		}
+
+		auto future =
+			pmemstream_async_wait_persisted(stream.get(), pmemstream_entry_timestamp(stream.get(), entry));
+		while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+			;
+	}
+
+	const config &cfg;
+	size_t element_size;
+	bool inline_copy;
+
+	std::unique_ptr<struct pmemstream, std::function<void(struct pmemstream *)>> stream;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+	struct data_mover_sync *dms = nullptr;
+};
+
+/* Returns mean time (in nanoseconds) of a single append. */
+double measure_append(const config &cfg, size_t element_size, bool inline_copy)
+{
+	append_workload workload(cfg, element_size, inline_copy);
+	auto results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload);
+	return benchmark::mean(results) / static_cast<double>(cfg.element_count);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	std::cout << std::setw(15) << std::left << "element_size" << std::setw(20) << "inline [ns/append]"
+		  << std::setw(20) << "vdm [ns/append]" << std::endl;
+
+	try {
+		for (auto element_size : cfg.element_sizes) {
+			double inline_copy = measure_append(cfg, element_size, true);
+			double vdm = measure_append(cfg, element_size, false);
+			std::cout << std::setw(15) << element_size << std::setw(20) << inline_copy << std::setw(20) << vdm
+				  << std::endl;
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
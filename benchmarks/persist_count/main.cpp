@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * persist_count -- counts flushes and drains issued by pmemstream per appended entry.
+ * Entries are appended asynchronously in batches of 'batch_size' entries and each batch is waited for
+ * (persisted) at once, so that commit can combine persists of contiguous entries.
+ */
+
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "libpmemstream_internal.h"
+#include "runtime_counters.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 10;
+	size_t region_size = TEST_DEFAULT_REGION_SIZE * 9;
+	size_t element_count = 1000;
+	size_t element_size = 64;
+	size_t batch_size = 16;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"region_size", required_argument, NULL, 'r'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"batch_size", required_argument, NULL, 'b'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:r:c:s:b:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 'r':
+					region_size = std::stoull(optarg);
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 's':
+					element_size = std::stoull(optarg);
+					break;
+				case 'b':
+					batch_size = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (batch_size == 0) {
+			throw std::invalid_argument("Invalid batch_size");
+		}
+		return 0;
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Counts flushes and drains issued by pmemstream per appended entry.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--region_size [size]", "region size"},
+			{"--element_count [count]", "number of elements to be appended"},
+			{"--element_size [size]", "number of bytes of each element"},
+			{"--batch_size [count]", "number of async appends waited for at once"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	auto stream = make_pmemstream(cfg.path.c_str(), TEST_DEFAULT_BLOCK_SIZE, cfg.size);
+
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+	if (pmemstream_region_allocate(stream.get(), cfg.region_size, &region) ||
+	    pmemstream_region_runtime_initialize(stream.get(), region, &region_runtime)) {
+		std::cerr << "Error during region allocation!" << std::endl;
+		return -2;
+	}
+
+	benchmark::runtime_counters::install(stream.get());
+
+	std::vector<char> data(cfg.element_size, 'x');
+	auto *dms = data_mover_sync_new();
+	struct vdm *vdm = data_mover_sync_get_vdm(dms);
+
+	for (size_t i = 0; i < cfg.element_count; i += cfg.batch_size) {
+		struct pmemstream_entry entry;
+		for (size_t j = i; j < std::min(i + cfg.batch_size, cfg.element_count); j++) {
+			if (pmemstream_async_append(stream.get(), vdm, region, region_runtime, data.data(), data.size(),
+						    &entry)) {
+				std::cerr << "Error while appending " << j << " entry!" << std::endl;
+				return -2;
+			}
+		}
+
+		auto future = pmemstream_async_wait_persisted(stream.get(), pmemstream_entry_timestamp(stream.get(), entry));
+		while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+			;
+	}
+
+	benchmark::runtime_counters::uninstall(stream.get());
+	data_mover_sync_delete(dms);
+
+	std::cout << "persist_count measurement (element_count: " << cfg.element_count
+		  << ", element_size: " << cfg.element_size << ", batch_size: " << cfg.batch_size << "):" << std::endl;
+	double entries = static_cast<double>(cfg.element_count);
+	std::cout << "\tflushes per entry: " << static_cast<double>(benchmark::runtime_counters::flushes) / entries
+		  << std::endl;
+	std::cout << "\tdrains per entry: " << static_cast<double>(benchmark::runtime_counters::drains) / entries
+		  << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#ifndef LIBPMEMSTREAM_BENCHMARK_RUNTIME_COUNTERS_HPP
+#define LIBPMEMSTREAM_BENCHMARK_RUNTIME_COUNTERS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "libpmemstream_internal.h"
+
+namespace benchmark
+{
+
+/*
+ * Counts flushes and drains issued by a stream, by replacing flush, drain and persist functions of its runtime
+ * (persist is counted as both a flush and a drain). Counters are global - only one stream can be counted at a time.
+ */
+namespace runtime_counters
+{
+
+/* Size of a media block of persistent memory (XPLine). */
+constexpr size_t media_block_size = 256;
+
+inline size_t flushes = 0;
+inline size_t drains = 0;
+/* Number of media blocks touched by flushes. Each flushed block is counted separately, so it's an upper bound - the
+ * device might combine writes to the same block. */
+inline size_t flushed_blocks = 0;
+
+namespace detail
+{
+inline struct pmemstream_runtime original_runtime;
+
+inline void count_flush(const void *ptr, size_t size)
+{
+	uintptr_t begin = ALIGN_DOWN(reinterpret_cast<uintptr_t>(ptr), media_block_size);
+	uintptr_t end = ALIGN_UP(reinterpret_cast<uintptr_t>(ptr) + size, media_block_size);
+	flushes++;
+	flushed_blocks += (end - begin) / media_block_size;
+}
+
+inline void counting_flush(const void *ptr, size_t size)
+{
+	count_flush(ptr, size);
+	original_runtime.flush(ptr, size);
+}
+
+inline void counting_drain(void)
+{
+	drains++;
+	original_runtime.drain();
+}
+
+inline void counting_persist(const void *ptr, size_t size)
+{
+	count_flush(ptr, size);
+	drains++;
+	original_runtime.persist(ptr, size);
+}
+} // namespace detail
+
+inline void reset()
+{
+	flushes = 0;
+	drains = 0;
+	flushed_blocks = 0;
+}
+
+/* Replaces runtime functions of the 'stream' with counting ones. */
+inline void install(struct pmemstream *stream)
+{
+	detail::original_runtime = stream->data;
+	stream->data.flush = detail::counting_flush;
+	stream->data.drain = detail::counting_drain;
+	stream->data.persist = detail::counting_persist;
+}
+
+/* Restores runtime functions of the 'stream', replaced by install. */
+inline void uninstall(struct pmemstream *stream)
+{
+	stream->data = detail::original_runtime;
+}
+
+} // namespace runtime_counters
+} // namespace benchmark
+
+#endif /* LIBPMEMSTREAM_BENCHMARK_RUNTIME_COUNTERS_HPP */
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * seek_timestamp -- compares finding an entry by timestamp with a linear scan (pmemstream_entry_iterator_seek_first
+ * followed by pmemstream_entry_iterator_next calls) and with pmemstream_entry_iterator_seek_timestamp. It measures
+ * mean time of a seek to a random entry of a region and time of the first seek (which builds the region index).
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+namespace
+{
+struct config {
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 64;
+	size_t element_size = 64;
+	std::vector<size_t> element_counts = {1000, 10000, 100000};
+	size_t seek_count = 1000;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+							  {"size", required_argument, NULL, 'x'},
+							  {"element_size", required_argument, NULL, 's'},
+							  {"element_count", required_argument, NULL, 'c'},
+							  {"seek_count", required_argument, NULL, 'k'},
+							  {"help", no_argument, NULL, 'h'},
+							  {NULL, 0, NULL, 0}};
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:s:c:k:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 's':
+					element_size = std::stoull(optarg);
+					break;
+				case 'c':
+					element_counts = {std::stoull(optarg)};
+					break;
+				case 'k':
+					seek_count = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (element_size < sizeof(uint64_t)) {
+			throw std::invalid_argument("Invalid element_size");
+		}
+		if (seek_count == 0) {
+			throw std::invalid_argument("Invalid seek_count");
+		}
+		return 0;
+	}
+
+	/* Each entry occupies at most its size and 16 bytes of metadata (rounded up to 8 bytes). */
+	size_t region_size(size_t element_count) const
+	{
+		return element_count * (element_size + 24);
+	}
+
+	static void print_usage(const char *app_name)
+	{
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + std::string(app_name) + " [OPTION]...", ""},
+			{"Compares seeking an entry by timestamp with a linear scan.", ""},
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--element_size [size]", "number of bytes of each element"},
+			{"--element_count [count]", "number of elements in the region (1000-100000 by default)"},
+			{"--seek_count [count]", "number of measured seeks"},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(25) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+
+struct seek_result {
+	double linear_time;
+	double first_seek_time;
+	double seek_time;
+};
+
+/* Moves iterator to the first entry with timestamp not less than 'timestamp', examining entries one by one. */
+void linear_seek(struct pmemstream *stream, struct pmemstream_entry_iterator *it, uint64_t timestamp)
+{
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		if (pmemstream_entry_timestamp(stream, pmemstream_entry_iterator_get(it)) >= timestamp) {
+			return;
+		}
+	}
+}
+
+void verify_value(struct pmemstream *stream, struct pmemstream_entry_iterator *it, uint64_t expected)
+{
+	if (pmemstream_entry_iterator_is_valid(it) != 0 ||
+	    *static_cast<const uint64_t *>(pmemstream_entry_data(stream, pmemstream_entry_iterator_get(it))) !=
+		    expected) {
+		throw std::runtime_error("Seek found a wrong entry");
+	}
+}
+
+seek_result measure(const config &cfg, size_t element_count)
+{
+	struct pmem2_map *map = map_open(cfg.path.c_str(), cfg.size, true);
+	if (!map) {
+		throw std::runtime_error(pmem2_errormsg());
+	}
+
+	struct pmemstream *stream;
+	if (pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map)) {
+		pmem2_map_delete(&map);
+		throw std::runtime_error("pmemstream_from_map failed");
+	}
+
+	struct pmemstream_region region;
+	if (pmemstream_region_allocate(stream, cfg.region_size(element_count), &region)) {
+		throw std::runtime_error("Error during region allocation");
+	}
+
+	std::vector<uint8_t> data(cfg.element_size);
+	std::vector<uint64_t> timestamps(element_count);
+	for (uint64_t i = 0; i < element_count; i++) {
+		struct pmemstream_entry entry;
+		*reinterpret_cast<uint64_t *>(data.data()) = i;
+		if (pmemstream_append(stream, region, nullptr, data.data(), data.size(), &entry)) {
+			throw std::runtime_error("Error while appending");
+		}
+		timestamps[i] = pmemstream_entry_timestamp(stream, entry);
+	}
+
+	std::mt19937_64 generator(0);
+	std::uniform_int_distribution<uint64_t> distribution(0, element_count - 1);
+	std::vector<uint64_t> targets(cfg.seek_count);
+	for (auto &target : targets) {
+		target = distribution(generator);
+	}
+
+	struct pmemstream_entry_iterator *it;
+	if (pmemstream_entry_iterator_new(&it, stream, region)) {
+		throw std::runtime_error("Error during iterator creation");
+	}
+
+	seek_result result;
+	result.linear_time = static_cast<double>(benchmark::measure<std::chrono::nanoseconds>([&]() {
+		for (auto target : targets) {
+			linear_seek(stream, it, timestamps[target]);
+			verify_value(stream, it, target);
+		}
+	}));
+
+	/* The first seek (to the last entry) builds the index of the whole region. */
+	result.first_seek_time = static_cast<double>(benchmark::measure<std::chrono::nanoseconds>([&]() {
+		pmemstream_entry_iterator_seek_timestamp(it, timestamps[element_count - 1]);
+		verify_value(stream, it, element_count - 1);
+	}));
+
+	result.seek_time = static_cast<double>(benchmark::measure<std::chrono::nanoseconds>([&]() {
+		for (auto target : targets) {
+			pmemstream_entry_iterator_seek_timestamp(it, timestamps[target]);
+			verify_value(stream, it, target);
+		}
+	}));
+
+	result.linear_time /= static_cast<double>(cfg.seek_count);
+	result.seek_time /= static_cast<double>(cfg.seek_count);
+
+	pmemstream_entry_iterator_delete(&it);
+	pmemstream_delete(&stream);
+	pmem2_map_delete(&map);
+
+	return result;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage(argv[0]);
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+
+	std::cout << "seek_timestamp measurement (element_size: " << cfg.element_size
+		  << ", seek_count: " << cfg.seek_count << "):" << std::endl;
+	std::cout << std::setw(15) << std::left << "element_count" << std::setw(20) << "linear [ns/seek]"
+		  << std::setw(20) << "first seek [ns]" << std::setw(20) << "seek [ns/seek]" << std::endl;
+
+	try {
+		for (auto element_count : cfg.element_counts) {
+			auto result = measure(cfg, element_count);
+			std::cout << std::setw(15) << element_count << std::setw(20) << result.linear_time
+				  << std::setw(20) << result.first_seek_time << std::setw(20) << result.seek_time
+				  << std::endl;
+		}
+	} catch (std::runtime_error const &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	return 0;
+}
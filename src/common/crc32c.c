@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#include "crc32c.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+/* Reflected CRC32C polynomial. */
+#define CRC32C_POLYNOMIAL (0x82F63B78U)
+
+static uint32_t crc32c_table[256];
+static bool crc32c_hw_supported;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+		}
+		crc32c_table[i] = crc;
+	}
+
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	crc32c_hw_supported = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		crc = crc32c_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *data, size_t size)
+{
+	uint64_t crc64 = crc;
+	for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		crc64 = _mm_crc32_u64(crc64, value);
+	}
+
+	crc = (uint32_t)crc64;
+	for (; size > 0; size--, data++) {
+		crc = _mm_crc32_u8(crc, *data);
+	}
+	return crc;
+}
+#endif
+
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t size)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+
+#if defined(__x86_64__)
+	if (crc32c_hw_supported) {
+		return crc32c_update_hw(crc, data, size);
+	}
+#endif
+	return crc32c_update_sw(crc, data, size);
+}
+
+uint32_t crc32c(const void *data, size_t size)
+{
+	return ~crc32c_update(CRC32C_INIT, data, size);
+}
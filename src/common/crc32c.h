@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_CRC32C_H
+#define LIBPMEMSTREAM_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRC32C_INIT (0xFFFFFFFFU)
+
+/* Updates CRC32C (Castagnoli) checksum 'crc' with 'size' bytes of 'data'. Checksum computation starts with
+ * CRC32C_INIT and the final value is bitwise negated (see crc32c). SSE4.2 crc32 instructions are used if the CPU
+ * supports them, table-driven implementation otherwise. */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t size);
+
+/* Returns CRC32C checksum of 'size' bytes of 'data'. */
+uint32_t crc32c(const void *data, size_t size);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_CRC32C_H */
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_FUTEX_H
+#define LIBPMEMSTREAM_FUTEX_H
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Blocks the calling thread as long as '*address' is equal to 'value' (and until it is woken up). It might return
+ * spuriously. */
+static inline void futex_wait(uint32_t *address, uint32_t value)
+{
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+/* Wakes up all threads blocked on 'address'. */
+static inline void futex_wake_all(uint32_t *address)
+{
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif /* LIBPMEMSTREAM_FUTEX_H */
@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_TOKEN_MAX_LENGTH 15
+#define LZ_HASH_BITS 12
+
+/* After this many consecutive bytes without a match, the search step is increased (by one byte per such
+ * distance), so that incompressible data is skipped quickly. */
+#define LZ_SKIP_TRIGGER_BITS 6
+
+static uint32_t lz_read32(const uint8_t *ptr)
+{
+	uint32_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+static uint64_t lz_read64(const uint8_t *ptr)
+{
+	uint64_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+/* Returns length of the common prefix of 'ip' and 'match' (which precedes it), not exceeding 'in_end'. */
+static size_t lz_match_size(const uint8_t *ip, const uint8_t *match, const uint8_t *in_end)
+{
+	const uint8_t *begin = ip;
+	while (in_end - ip >= (ptrdiff_t)sizeof(uint64_t)) {
+		uint64_t diff = lz_read64(ip) ^ lz_read64(match);
+		if (diff != 0) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return (size_t)(ip - begin) + ((size_t)__builtin_ctzll(diff) >> 3);
+#else
+			return (size_t)(ip - begin) + ((size_t)__builtin_clzll(diff) >> 3);
+#endif
+		}
+		ip += sizeof(uint64_t);
+		match += sizeof(uint64_t);
+	}
+
+	while (ip < in_end && *ip == *match) {
+		ip++;
+		match++;
+	}
+	return (size_t)(ip - begin);
+}
+
+static uint32_t lz_hash(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes extension of a length (its part exceeding the token). Returns NULL if it does not fit. */
+static uint8_t *lz_write_length(uint8_t *out, const uint8_t *out_end, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		if (out == out_end) {
+			return NULL;
+		}
+		*out++ = 255;
+	}
+
+	if (out == out_end) {
+		return NULL;
+	}
+	*out++ = (uint8_t)length;
+
+	return out;
+}
+
+/* Writes a sequence of literals followed by a match ('match_size' == 0 for the last sequence, without a match).
+ * Returns NULL if it does not fit. */
+static uint8_t *lz_write_sequence(uint8_t *out, const uint8_t *out_end, const uint8_t *literals, size_t literals_size,
+				  size_t offset, size_t match_size)
+{
+	if (out == out_end) {
+		return NULL;
+	}
+
+	uint8_t *token = out++;
+	if (literals_size >= LZ_TOKEN_MAX_LENGTH) {
+		*token = LZ_TOKEN_MAX_LENGTH << 4;
+		out = lz_write_length(out, out_end, literals_size - LZ_TOKEN_MAX_LENGTH);
+		if (!out) {
+			return NULL;
+		}
+	} else {
+		*token = (uint8_t)(literals_size << 4);
+	}
+
+	if ((size_t)(out_end - out) < literals_size) {
+		return NULL;
+	}
+	memcpy(out, literals, literals_size);
+	out += literals_size;
+
+	if (match_size == 0) {
+		return out;
+	}
+
+	if (out_end - out < 2) {
+		return NULL;
+	}
+	*out++ = (uint8_t)(offset & 0xFF);
+	*out++ = (uint8_t)(offset >> 8);
+
+	size_t length = match_size - LZ_MIN_MATCH;
+	if (length >= LZ_TOKEN_MAX_LENGTH) {
+		*token |= LZ_TOKEN_MAX_LENGTH;
+		return lz_write_length(out, out_end, length - LZ_TOKEN_MAX_LENGTH);
+	}
+	*token |= (uint8_t)length;
+
+	return out;
+}
+
+size_t lz_compress(const void *src, size_t src_size, void *dst, size_t dst_capacity)
+{
+	const uint8_t *in = (const uint8_t *)src;
+	const uint8_t *in_end = in + src_size;
+	uint8_t *out = (uint8_t *)dst;
+	const uint8_t *out_end = out + dst_capacity;
+
+	/* Positions (relative to 'in') of the last occurrences of 4-byte sequences. Stale or colliding entries are
+	 * harmless - each candidate is verified before use. */
+	uint32_t table[1 << LZ_HASH_BITS];
+	memset(table, 0, sizeof(table));
+
+	const uint8_t *anchor = in;
+	const uint8_t *ip = in;
+	while (in_end - ip >= LZ_MIN_MATCH) {
+		uint32_t sequence = lz_read32(ip);
+		uint32_t hash = lz_hash(sequence);
+		size_t position = (size_t)(ip - in);
+		size_t candidate = table[hash];
+		table[hash] = (uint32_t)position;
+
+		if (candidate >= position || position - candidate > LZ_MAX_OFFSET ||
+		    lz_read32(in + candidate) != sequence) {
+			ip += 1 + ((size_t)(ip - anchor) >> LZ_SKIP_TRIGGER_BITS);
+			continue;
+		}
+
+		size_t match_size =
+			LZ_MIN_MATCH + lz_match_size(ip + LZ_MIN_MATCH, in + candidate + LZ_MIN_MATCH, in_end);
+
+		out = lz_write_sequence(out, out_end, anchor, (size_t)(ip - anchor), position - candidate, match_size);
+		if (!out) {
+			return 0;
+		}
+
+		ip += match_size;
+		anchor = ip;
+	}
+
+	out = lz_write_sequence(out, out_end, anchor, (size_t)(in_end - anchor), 0, 0);
+	if (!out) {
+		return 0;
+	}
+
+	return (size_t)(out - (uint8_t *)dst);
+}
+
+/* Reads extension of a length and adds it to 'length'. Returns -1 if input ends prematurely. */
+static int lz_read_length(const uint8_t **in, const uint8_t *in_end, size_t *length)
+{
+	uint8_t byte;
+	do {
+		if (*in == in_end) {
+			return -1;
+		}
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+
+	return 0;
+}
+
+int lz_decompress(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	const uint8_t *in = (const uint8_t *)src;
+	const uint8_t *in_end = in + src_size;
+	uint8_t *out = (uint8_t *)dst;
+	uint8_t *out_end = out + dst_size;
+
+	while (in < in_end) {
+		uint8_t token = *in++;
+
+		size_t literals_size = token >> 4;
+		if (literals_size == LZ_TOKEN_MAX_LENGTH && lz_read_length(&in, in_end, &literals_size)) {
+			return -1;
+		}
+		if ((size_t)(in_end - in) < literals_size || (size_t)(out_end - out) < literals_size) {
+			return -1;
+		}
+		memcpy(out, in, literals_size);
+		in += literals_size;
+		out += literals_size;
+
+		if (in == in_end) {
+			/* The last sequence. */
+			break;
+		}
+
+		if (in_end - in < 2) {
+			return -1;
+		}
+		size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - (uint8_t *)dst)) {
+			return -1;
+		}
+
+		size_t match_size = token & LZ_TOKEN_MAX_LENGTH;
+		if (match_size == LZ_TOKEN_MAX_LENGTH && lz_read_length(&in, in_end, &match_size)) {
+			return -1;
+		}
+		match_size += LZ_MIN_MATCH;
+		if ((size_t)(out_end - out) < match_size) {
+			return -1;
+		}
+
+		/* Match might overlap with the data it produces - then it's copied in chunks not longer than the
+		 * offset. */
+		const uint8_t *match = out - offset;
+		if (offset >= match_size) {
+			memcpy(out, match, match_size);
+		} else if (offset >= sizeof(uint64_t)) {
+			size_t i = 0;
+			for (; i + sizeof(uint64_t) <= match_size; i += sizeof(uint64_t)) {
+				memcpy(out + i, match + i, sizeof(uint64_t));
+			}
+			for (; i < match_size; i++) {
+				out[i] = match[i];
+			}
+		} else {
+			for (size_t i = 0; i < match_size; i++) {
+				out[i] = match[i];
+			}
+		}
+		out += match_size;
+	}
+
+	return out == out_end ? 0 : -1;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_LZ_H
+#define LIBPMEMSTREAM_LZ_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fast LZ77 codec (LZ4-like block format), used as PMEMSTREAM_CODEC_LZ.
+ *
+ * Compressed data is a sequence of: token (4 bits of literals length and 4 bits of match length), length
+ * extension of literals, literals, 2-byte little-endian match offset and length extension of the match.
+ * The last sequence contains only literals.
+ */
+
+/* Compresses 'src_size' bytes of 'src' into 'dst'. Returns size of compressed data or 0 if it does not fit in
+ * 'dst_capacity' bytes. */
+size_t lz_compress(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+
+/* Decompresses 'src_size' bytes of 'src' into exactly 'dst_size' bytes of 'dst'.
+ * Returns 0 on success, -1 if compressed data is malformed or does not decompress to 'dst_size' bytes. */
+int lz_decompress(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_LZ_H */
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#include "config.h"
+#include "common/lz.h"
+#include "common/util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void config_initialize_default(struct pmemstream_config *config)
+{
+	config->max_concurrency = PMEMSTREAM_DEFAULT_MAX_CONCURRENCY;
+	config->timestamp_lease_size = 0;
+	config->nontemporal_copy_threshold = PMEMSTREAM_DEFAULT_NONTEMPORAL_COPY_THRESHOLD;
+	config->background_persist = false;
+
+	memset(config->codecs, 0, sizeof(config->codecs));
+	config->codecs[PMEMSTREAM_CODEC_LZ].compress = lz_compress;
+	config->codecs[PMEMSTREAM_CODEC_LZ].decompress = lz_decompress;
+}
+
+int pmemstream_config_new(struct pmemstream_config **config)
+{
+	if (!config) {
+		return -1;
+	}
+
+	struct pmemstream_config *c = malloc(sizeof(*c));
+	if (!c) {
+		return -1;
+	}
+
+	config_initialize_default(c);
+	*config = c;
+
+	return 0;
+}
+
+void pmemstream_config_delete(struct pmemstream_config **config)
+{
+	if (!config) {
+		return;
+	}
+
+	free(*config);
+	*config = NULL;
+}
+
+int pmemstream_config_set_max_concurrency(struct pmemstream_config *config, size_t max_concurrency)
+{
+	if (!config) {
+		return -1;
+	}
+
+	if (!IS_POW2(max_concurrency)) {
+		return -1;
+	}
+
+	config->max_concurrency = max_concurrency;
+
+	return 0;
+}
+
+int pmemstream_config_set_timestamp_lease_size(struct pmemstream_config *config, size_t lease_size)
+{
+	if (!config) {
+		return -1;
+	}
+
+	if (lease_size != 0 && !IS_POW2(lease_size)) {
+		return -1;
+	}
+
+	config->timestamp_lease_size = lease_size;
+
+	return 0;
+}
+
+int pmemstream_config_set_background_persist(struct pmemstream_config *config, int enable)
+{
+	if (!config) {
+		return -1;
+	}
+
+	config->background_persist = enable != 0;
+
+	return 0;
+}
+
+int pmemstream_config_set_nontemporal_copy_threshold(struct pmemstream_config *config, size_t threshold)
+{
+	if (!config) {
+		return -1;
+	}
+
+	config->nontemporal_copy_threshold = threshold;
+
+	return 0;
+}
+
+int pmemstream_config_set_codec(struct pmemstream_config *config, unsigned codec_id,
+				const struct pmemstream_codec *codec)
+{
+	if (!config || !codec || !codec->compress || !codec->decompress) {
+		return -1;
+	}
+
+	if (codec_id <= PMEMSTREAM_CODEC_LZ || codec_id >= PMEMSTREAM_MAX_CODECS) {
+		return -1;
+	}
+
+	config->codecs[codec_id] = *codec;
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_CONFIG_H
+#define LIBPMEMSTREAM_CONFIG_H
+
+#include "libpmemstream.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default size of the ring of async operations. */
+#define PMEMSTREAM_DEFAULT_MAX_CONCURRENCY 1024ULL
+
+/* Default size of entries, starting from which data is copied with non-temporal stores. */
+#define PMEMSTREAM_DEFAULT_NONTEMPORAL_COPY_THRESHOLD 256ULL
+
+/* Runtime (not persisted) parameters of a pmemstream instance. */
+struct pmemstream_config {
+	/* Maximum number of async operations in flight (size of the async operations' ring); power of 2. */
+	size_t max_concurrency;
+
+	/* Number of timestamps leased at once by a lane (0 if timestamps are not leased); power of 2. */
+	size_t timestamp_lease_size;
+
+	/* Entries of at least this size, copied by the stream itself, are written with non-temporal stores. */
+	size_t nontemporal_copy_threshold;
+
+	/* Published operations are committed and persisted by a background thread, owned by the stream. */
+	bool background_persist;
+
+	/* Codecs, indexed by their identifiers (entries of unregistered identifiers are zeroed). */
+	struct pmemstream_codec codecs[PMEMSTREAM_MAX_CODECS];
+};
+
+void config_initialize_default(struct pmemstream_config *config);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_CONFIG_H */
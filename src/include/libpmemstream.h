@@ -15,15 +15,19 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct pmemstream;
+struct pmemstream_config;
 struct pmemstream_entry_iterator;
+struct pmemstream_region_chain;
 struct pmemstream_region_iterator;
 struct pmemstream_region_runtime;
+struct pmemstream_write_buffer;
 struct pmemstream_region {
 	uint64_t offset;
 };
@@ -58,12 +62,105 @@ FUTURE(pmemstream_async_wait_fut, struct pmemstream_async_wait_data, struct pmem
  *
  * If this function is called with a map representing an empty file, the new pmemstream instance will be initialized.
  * If mapping points to a previously existing pmemstream instance, it re-opens it and reads persisted header's data.
+ * It fails if the instance was created by a version of the library with an incompatible persistent layout.
  * In any other case, it's undefined behavior.
  *
  * It returns 0 on success, error code otherwise.
  */
 int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pmem2_map *map);
 
+/* Works as pmemstream_from_map, but runtime parameters of the stream instance are taken from 'config'.
+ * If 'config' is NULL, default values are used. 'config' can be deleted right after this call.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_from_map_with_config(struct pmemstream **stream, size_t block_size, struct pmem2_map *map,
+				    const struct pmemstream_config *config);
+
+/* Creates new config (for pmemstream_from_map_with_config), with all parameters set to default values.
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_new(struct pmemstream_config **config);
+
+/* Releases the given 'config' and sets 'config' pointer to NULL. */
+void pmemstream_config_delete(struct pmemstream_config **config);
+
+/* Sets maximum number of async operations (e.g. appends which are not yet committed), which can be in flight
+ * at once, in a single stream. Each in-flight operation takes a slot in a runtime ring, so a bigger value costs
+ * more memory. When all slots are taken, new appends wait for the oldest operations to commit.
+ * 'max_concurrency' must be a power of 2; default value is 1024. It also limits 'count' of batched appends.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_max_concurrency(struct pmemstream_config *config, size_t max_concurrency);
+
+/* Sets size of entries, starting from which data copied by the stream itself (by synchronous appends) is written
+ * with non-temporal stores. Such data is durable right after a drain, so it is not flushed again on commit.
+ * Smaller entries are copied with regular stores and flushed on commit (along with other entries placed next to
+ * them). Asynchronous appends always use the given data mover. Default value is 256; SIZE_MAX disables
+ * non-temporal copies. The best value depends on the platform - see the copy_threshold benchmark.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_nontemporal_copy_threshold(struct pmemstream_config *config, size_t threshold);
+
+/* Enables leasing of timestamps. By default, each append takes its timestamp from a single, stream-wide counter.
+ * With leases enabled, appends to a region take timestamps from a block of 'lease_size' timestamps, leased
+ * (from the stream-wide counter) by one of the stream's lanes - regions are spread among a fixed number of lanes.
+ * This way the stream-wide counter is touched once per 'lease_size' appends.
+ *
+ * Entries are still committed in order of their timestamps. Unused timestamps of a lease are given up (and skipped
+ * by commit) when someone waits for a commit of a bigger timestamp, so there might be gaps between timestamps of
+ * consecutive entries. Timestamps of entries within a single region (if appended by one thread) still increase.
+ * Leasing pays off mostly for asynchronous appends, for which commit is awaited rarely.
+ *
+ * 'lease_size' must be 0 (leasing disabled, default) or a power of 2, not bigger than half of max_concurrency
+ * (otherwise pmemstream_from_map_with_config fails).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_timestamp_lease_size(struct pmemstream_config *config, size_t lease_size);
+
+/* Enables (if 'enable' is not 0) background persist mode. In this mode the stream owns a thread, which commits and
+ * persists published operations (in batches, as soon as they are ready). Synchronous appends and
+ * pmemstream_wait_committed/pmemstream_wait_persisted only sleep until their entries are committed/persisted
+ * by that thread, so the cost of commits is taken off the appending threads. Futures returned by
+ * pmemstream_async_wait_committed/pmemstream_async_wait_persisted still commit entries by themselves, when polled.
+ * Disabled by default; a caller-provided thread can drive commits using pmemstream_process_persisted instead.
+ * The background thread does not revoke timestamp leases (see pmemstream_config_set_timestamp_lease_size) - a thread
+ * which waits for its entries revokes leases holding earlier timestamps before it sleeps.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_background_persist(struct pmemstream_config *config, int enable);
+
+/* Codec used to compress data of entries appended to regions allocated with PMEMSTREAM_REGION_CODEC flag.
+ * Both functions are called concurrently, by appending and reading threads. */
+struct pmemstream_codec {
+	/* Compresses 'src_size' bytes of 'src' into 'dst'. Returns size of compressed data or 0 if it does not fit
+	 * in 'dst_capacity' bytes (such an entry is stored uncompressed). */
+	size_t (*compress)(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+
+	/* Decompresses 'src_size' bytes of 'src' into exactly 'dst_size' bytes of 'dst'.
+	 * Returns 0 on success, non-zero value if 'src' does not hold valid compressed data. */
+	int (*decompress)(const void *src, size_t src_size, void *dst, size_t dst_size);
+};
+
+/* Identifier of the built-in, fast LZ77 codec (LZ4-like block format), available in every stream. */
+#define PMEMSTREAM_CODEC_LZ 1
+
+/* Codec identifiers are smaller than this value (0 stands for no codec). */
+#define PMEMSTREAM_MAX_CODECS 16
+
+/* Registers 'codec' under 'codec_id' (between 2 and PMEMSTREAM_MAX_CODECS - 1; 1 is taken by PMEMSTREAM_CODEC_LZ).
+ * Codecs are not stored persistently, only their identifiers are - the same codec must be registered (under the
+ * same identifier) each time a stream with regions using it is opened.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_codec(struct pmemstream_config *config, unsigned codec_id,
+				const struct pmemstream_codec *codec);
+
 /* Releases the given 'stream' resources and sets 'stream' pointer to NULL. */
 void pmemstream_delete(struct pmemstream **stream);
 
@@ -78,6 +175,64 @@ void pmemstream_delete(struct pmemstream **stream);
  */
 int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pmemstream_region *region);
 
+/* Region allocated with this flag accepts appends (and reservations) from many threads at the same time.
+ * Space for each entry is claimed with a single atomic operation (no lock is taken on the append path).
+ * Entries in such a region are stored in the order of space reservation, which might differ from the order of
+ * their timestamps. Entries which were reserved but not committed before a crash are skipped by iterators. */
+#define PMEMSTREAM_REGION_MULTI_WRITER (1ULL << 0)
+
+/* Entries in a region allocated with one of these flags start at 64 B (cacheline) or 256 B boundaries of memory
+ * (entry offsets do not have to be multiples of the alignment - they are relative to the beginning of the stream's
+ * spans, which is aligned only to the stream's block size). Space between consecutive entries is filled with
+ * padding, which is skipped by iterators. Such a region trades space for lower write amplification: entries never
+ * share a cacheline (or a 256 B internal block of the persistent memory media).
+ * If an entry would leave exactly 8 bytes of padding, it occupies one more aligned unit (padding must fit a span
+ * header). At most one of those flags can be set. */
+#define PMEMSTREAM_REGION_ENTRY_ALIGN_64 (1ULL << 1)
+#define PMEMSTREAM_REGION_ENTRY_ALIGN_256 (1ULL << 2)
+
+/* Entries in a region allocated with this flag use compact, 8-byte metadata (instead of 16 bytes): entry size and
+ * entry timestamp, stored as a delta from a timestamp base of the region (set on allocation). It's meant for
+ * small records. Entries must be smaller than 64 KiB - bigger ones cannot be appended (or reserved) in such
+ * a region. Region stops accepting new entries (as if it was full) once 2^45 timestamps were acquired in the stream
+ * since the region's allocation - all reserved entries must be published before 2^46 timestamps are acquired. */
+#define PMEMSTREAM_REGION_COMPACT_ENTRIES (1ULL << 3)
+
+/* Entries in a region allocated with this flag carry CRC32C checksum of their metadata and data (in 24 bytes of
+ * metadata, instead of 16 bytes). Checksums are verified by region recovery, which lets it detect torn entries.
+ * Because of that, if all entries committed at once have checksums, they are persisted along with the persisted
+ * timestamp, using a single drain (instead of two). After a crash, entries which were not reported as persisted
+ * might be lost independently of each other (not only as a suffix of the stream). Cannot be combined with
+ * PMEMSTREAM_REGION_COMPACT_ENTRIES. */
+#define PMEMSTREAM_REGION_ENTRY_CHECKSUMS (1ULL << 4)
+
+/* Region allocated with this flag keeps a persistent, sparse index of its entries at its end (it takes about 24 bytes
+ * per 256 entries of the smallest size possible in the region, which are not available for entries). Offset,
+ * ordinal and timestamp of every 256th entry are recorded there by pmemstream_append, pmemstream_appendv,
+ * pmemstream_append_batch, pmemstream_publish, pmemstream_publish_batch and
+ * pmemstream_entry_iterator_seek_timestamp (entries appended in other ways are recorded by the next of these calls).
+ * After the stream is reopened, seeks by timestamp and recovery of a single-writer region only examine entries
+ * following the last record, instead of the whole region. */
+#define PMEMSTREAM_REGION_PERSISTENT_INDEX (1ULL << 5)
+
+/* Data of entries appended to a region allocated with this flag is compressed with a codec of the given 'codec_id'
+ * (PMEMSTREAM_CODEC_LZ or one registered with pmemstream_config_set_codec). Entry metadata (24 bytes, instead of 16)
+ * records the codec and size of uncompressed data. Data is compressed by pmemstream_append and
+ * pmemstream_async_append (synchronously, by the calling thread) - entries which do not compress, or which are
+ * appended in other ways (reserved, appended in batches or from multiple buffers) are stored uncompressed. So are
+ * entries in multi-writer regions whose compression would leave exactly 8 bytes of their reservation unused.
+ * Data of compressed entries is read with pmemstream_entry_read. Cannot be combined with
+ * PMEMSTREAM_REGION_COMPACT_ENTRIES nor PMEMSTREAM_REGION_ENTRY_CHECKSUMS. */
+#define PMEMSTREAM_REGION_CODEC(codec_id) (((uint64_t)(codec_id) & (PMEMSTREAM_MAX_CODECS - 1)) << 8)
+
+/* Allocates new region with specified 'size' and 'flags' (a bitwise OR of PMEMSTREAM_REGION_* flags or 0).
+ * Flags are stored persistently, together with the region. Apart from that, it works as pmemstream_region_allocate.
+ *
+ * It returns 0 on success, error code otherwise (e.g. on unknown flags).
+ */
+int pmemstream_region_allocate_with_flags(struct pmemstream *stream, size_t size, uint64_t flags,
+					  struct pmemstream_region *region);
+
 /* Frees previously allocated, specified 'region'.
  * It returns 0 on success, error code otherwise.
  */
@@ -113,6 +268,34 @@ size_t pmemstream_region_usable_size(struct pmemstream *stream, struct pmemstrea
 int pmemstream_region_runtime_initialize(struct pmemstream *stream, struct pmemstream_region region,
 					 struct pmemstream_region_runtime **runtime);
 
+/* Creates a region chain - a logical log spanning multiple regions, starting with the 'head' region.
+ * Entries are appended to the last used region of the chain (tail). When it's full, the chain rolls to the next
+ * region, which is allocated (and linked to the chain) in advance, so that appends do not wait for allocations.
+ * All regions of the chain have the same size and flags as the 'head' (see pmemstream_region_allocate_with_flags).
+ *
+ * Links between regions are stored persistently - to reopen a chain, call this function with the same 'head'.
+ * Regions of a chain must not be freed, nor used directly for appends.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_chain_new(struct pmemstream_region_chain **chain, struct pmemstream *stream,
+				struct pmemstream_region head);
+
+/* Releases the given 'chain' resources and sets 'chain' pointer to NULL. Regions of the chain are not freed. */
+void pmemstream_region_chain_delete(struct pmemstream_region_chain **chain);
+
+/* Synchronously appends data buffer to the tail region of a 'chain' (like pmemstream_append), rolling to the next
+ * region if the tail is full. It can be called concurrently only if regions of the chain were allocated with
+ * PMEMSTREAM_REGION_MULTI_WRITER flag.
+ * Fails if the entry would not fit into an empty region, or if no more regions can be allocated.
+ *
+ * 'new_entry' is an optional pointer. On success, it will contain information about position of the appended entry.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_chain_append(struct pmemstream_region_chain *chain, const void *data, size_t size,
+				   struct pmemstream_entry *new_entry);
+
 /* Reserves space (for a future, custom write) of the given 'size', in a 'region' at offset determined
  * by 'region_runtime'. Entry's data have to be copied into reserved space by the user and then published
  * using pmemstream_publish. This approach is only recommended for special use cases, e.g. custom memcpy
@@ -125,7 +308,8 @@ int pmemstream_region_runtime_initialize(struct pmemstream *stream, struct pmems
  * pmemstream_publish for completing the custom append process.
  * 'data' is updated with a pointer to reserved space - this is a destination for, e.g., custom memcpy.
  *
- * It is not allowed to call pmemstream_reserve for the second time before calling pmemstream_publish.
+ * It is not allowed to call pmemstream_reserve for the second time before calling pmemstream_publish, unless
+ * the region was allocated with PMEMSTREAM_REGION_MULTI_WRITER flag.
  *
  * It returns 0 on success, error code otherwise.
  */
@@ -133,22 +317,60 @@ int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region regio
 		       struct pmemstream_region_runtime *region_runtime, size_t size,
 		       struct pmemstream_entry *reserved_entry, void **data);
 
+/* Reserves space for 'count' entries of the given 'sizes' at once. Entries are placed contiguously in a 'region'
+ * and have to be published together, using pmemstream_publish_batch (or pmemstream_async_publish_batch).
+ * Fails (without reserving anything) if there is not enough space for all of the entries.
+ *
+ * 'reserved_entries' is an array of 'count' entries, updated with offsets of the reserved entries.
+ * 'data' is an array of 'count' pointers, updated with pointers to reserved space of each entry.
+ * 'count' can't be bigger than max_concurrency of the stream (see pmemstream_config_set_max_concurrency).
+ *
+ * The same restrictions as for pmemstream_reserve apply - the batch has to be published before the next
+ * reservation, unless the region was allocated with PMEMSTREAM_REGION_MULTI_WRITER flag.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_reserve_batch(struct pmemstream *stream, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const size_t *sizes, size_t count,
+			     struct pmemstream_entry *reserved_entries, void **data);
+
 /* Synchronously publishes previously custom-written 'entry' in a 'region'.
  * After calling pmemstream_reserve and writing/memcpy'ing data into a reserved_entry, it's required
  * to call this function for setting proper entry's metadata and persist the data.
  *
  * 'region_runtime' is an optional parameter which can be obtained from pmemstream_region_runtime_initialize.
  * If it's NULL, it will be obtained from its internal structures (which might incur overhead).
- * 'size' of the entry has to match the previous reservation and the actual size of the data written by user.
+ * 'size' is the actual size of the data written by user. It can be smaller than the size of the previous reservation
+ * (e.g. when data is serialized directly into the reserved space and its final size is not known up front) - the
+ * unused space is given back to the region. In regions allocated with PMEMSTREAM_REGION_MULTI_WRITER flag, it's
+ * skipped (as padding) instead, since other entries might have been reserved after this one already - it fails if
+ * the unused space is exactly 8 bytes (padding span takes at least 16 bytes).
+ * Publishing an entry bigger than its reservation fails. On failure, the reservation is released (the entry has to
+ * be reserved again).
  *
  * It returns 0 on success, error code otherwise.
  */
 int pmemstream_publish(struct pmemstream *stream, struct pmemstream_region region,
 		       struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry, size_t size);
 
+/* Synchronously publishes 'count' custom-written 'entries', reserved by pmemstream_reserve_batch. Entries get
+ * consecutive timestamps and are persisted together, like entries appended by pmemstream_append_batch.
+ *
+ * 'entries' and 'sizes' have to match the previous reservation (entries must be placed contiguously).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_publish_batch(struct pmemstream *stream, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const struct pmemstream_entry *entries,
+			     const size_t *sizes, size_t count);
+
 /* Synchronously appends data buffer to a given region, at offset determined by region_runtime.
  * Fails if no space is available.
  *
+ * Entries appended concurrently by synchronous functions (pmemstream_append, pmemstream_publish, etc.) are
+ * persisted together (group commit): one of the calling threads persists all of them, along with
+ * a single update of the stream's persisted timestamp, while the others wait for it to finish.
+ *
  * 'region_runtime' is an optional parameter which can be obtained from pmemstream_region_runtime_initialize.
  * If it's NULL, it will be obtained from its internal structures (which might incur overhead).
  *
@@ -163,8 +385,45 @@ int pmemstream_append(struct pmemstream *stream, struct pmemstream_region region
 		      struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
 		      struct pmemstream_entry *new_entry);
 
+/* Synchronously appends 'count' data buffers to a given region, each as a separate entry.
+ * Entries are placed contiguously in the region (at offset determined by region_runtime), get consecutive
+ * timestamps and are persisted together. Fails (without appending anything) if there is not enough space
+ * for all of the entries.
+ *
+ * 'region_runtime' is an optional parameter which can be obtained from pmemstream_region_runtime_initialize.
+ * If it's NULL, it will be obtained from its internal structures (which might incur overhead).
+ *
+ * 'data' is an array of 'count' pointers to the data buffers, to be appended.
+ * 'sizes' is an array of 'count' sizes of the data buffers, to be appended.
+ * 'new_entries' is an optional array of 'count' entries. On success, it will contain information about newly
+ * appended entries (with their offsets within pmemstream), in the order of buffers in 'data'.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_append_batch(struct pmemstream *stream, struct pmemstream_region region,
+			    struct pmemstream_region_runtime *region_runtime, const void *const *data,
+			    const size_t *sizes, size_t count, struct pmemstream_entry *new_entries);
+
+/* Synchronously appends data gathered from multiple buffers to a given region, as a single entry.
+ * Buffers are copied (in order) directly into the entry's space, so the entry's data is a concatenation of them.
+ * Fails if no space is available.
+ *
+ * 'region_runtime' is an optional parameter which can be obtained from pmemstream_region_runtime_initialize.
+ * If it's NULL, it will be obtained from its internal structures (which might incur overhead).
+ *
+ * 'iov' is an array of 'iovcnt' buffers descriptions (see **writev**(2)), to be appended.
+ * 'new_entry' is an optional pointer. On success, it will contain information about newly appended entry
+ * (with its offset within pmemstream).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_appendv(struct pmemstream *stream, struct pmemstream_region region,
+		       struct pmemstream_region_runtime *region_runtime, const struct iovec *iov, size_t iovcnt,
+		       struct pmemstream_entry *new_entry);
+
 /* Asynchronous version of pmemstream_publish.
  * It publishes previously custom-written entry. 'entry' is marked as ready for commit.
+ * Like in pmemstream_publish, 'size' can be smaller than the size of the previous reservation.
  *
  * There is no guarantee whether data is visible by iterators or persisted after this call.
  * To commit (and make the data visible to iterators) or persist the data use: pmemstream_async_wait_committed or
@@ -176,6 +435,20 @@ int pmemstream_async_publish(struct pmemstream *stream, struct pmemstream_region
 			     struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry,
 			     size_t size);
 
+/* Asynchronous version of pmemstream_publish_batch.
+ * It publishes previously custom-written entries. All 'entries' are marked as ready for commit.
+ * Entries from a single batch are always committed and persisted together.
+ *
+ * There is no guarantee whether data is visible by iterators or persisted after this call.
+ * To commit (and make the data visible to iterators) or persist the data use: pmemstream_async_wait_committed or
+ * pmemstream_async_wait_persisted (with the timestamp of the last entry) and poll returned future to completion.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_async_publish_batch(struct pmemstream *stream, struct pmemstream_region region,
+				   struct pmemstream_region_runtime *region_runtime,
+				   const struct pmemstream_entry *entries, const size_t *sizes, size_t count);
+
 /* Asynchronous version of pmemstream_append.
  * It appends 'data' to the region and marks it as ready for commit.
  *
@@ -189,6 +462,87 @@ int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct p
 			    struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
 			    struct pmemstream_entry *new_entry);
 
+/* Asynchronous version of pmemstream_append_batch.
+ * It appends all buffers from 'data' to the region and marks them as ready for commit.
+ * Entries from a single batch are always committed and persisted together.
+ *
+ * There is no guarantee whether data is visible by iterators or persisted after this call.
+ * To commit (and make the data visible to iterators) or persist the data use: pmemstream_async_wait_committed or
+ * pmemstream_async_wait_persisted (with the timestamp of the last entry) and poll returned future to completion.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_async_append_batch(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+				  struct pmemstream_region_runtime *region_runtime, const void *const *data,
+				  const size_t *sizes, size_t count, struct pmemstream_entry *new_entries);
+
+/* Asynchronous version of pmemstream_appendv.
+ * It appends data gathered from all buffers described by 'iov' to the region (as a single entry) and marks it as
+ * ready for commit. Each buffer is copied by a separate vdm operation.
+ * Both 'iov' array and the buffers must remain valid until the entry is committed.
+ *
+ * There is no guarantee whether data is visible by iterators or persisted after this call.
+ * To commit (and make the data visible to iterators) or persist the data use: pmemstream_async_wait_committed or
+ * pmemstream_async_wait_persisted and poll returned future to completion.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_async_appendv(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const struct iovec *iov, size_t iovcnt,
+			     struct pmemstream_entry *new_entry);
+
+/* Creates a write buffer, which combines tiny appends to a 'region' (done by a single thread). Appended entries are
+ * staged in DRAM (up to 'capacity' bytes, including entries' metadata) and emitted to the region at once - with a
+ * single copy, as one batch which is flushed together on commit. Each entry still gets its own timestamp.
+ * Staged entries are emitted when the buffer is full, when pmemstream_write_buffer_flush is called or, if
+ * 'max_delay_ns' is not 0, once the first staged entry waits at least 'max_delay_ns' nanoseconds. The buffer has no
+ * timer of its own - the deadline is checked only by pmemstream_write_buffer_append and pmemstream_write_buffer_poll.
+ *
+ * A buffer must not be used by multiple threads concurrently. Multiple buffers (e.g. one per thread) can be used with
+ * a single region only if it was allocated with PMEMSTREAM_REGION_MULTI_WRITER flag.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_write_buffer_new(struct pmemstream_write_buffer **buffer, struct pmemstream *stream,
+				struct pmemstream_region region, size_t capacity, uint64_t max_delay_ns);
+
+/* Emits staged entries (see pmemstream_write_buffer_flush), releases the given 'buffer' resources and sets 'buffer'
+ * pointer to NULL. Resources are released even if staged entries could not be emitted (e.g. because the region is
+ * full) - such entries are lost. To handle that error without losing entries, call pmemstream_write_buffer_flush
+ * before this function.
+ *
+ * It returns 0 on success, error code if staged entries could not be emitted.
+ */
+int pmemstream_write_buffer_delete(struct pmemstream_write_buffer **buffer);
+
+/* Stages data buffer in a write 'buffer', to be appended as a separate entry. Staged entries are emitted first, if
+ * there is not enough space for it. Entries which do not fit into an empty buffer are appended directly.
+ *
+ * There is no guarantee whether data is visible by iterators or persisted after this call - see
+ * pmemstream_write_buffer_flush.
+ *
+ * It returns 0 on success, error code otherwise (e.g. if staged entries could not be emitted, because the region is
+ * full - they stay staged then).
+ */
+int pmemstream_write_buffer_append(struct pmemstream_write_buffer *buffer, const void *data, size_t size);
+
+/* Emits all staged entries of a write 'buffer' to its region. Entries are not committed by this call.
+ * To commit or persist them, use e.g. pmemstream_wait_persisted with the returned timestamp.
+ *
+ * Returns timestamp of the last entry appended (emitted) through the buffer, or invalid timestamp if no entry was
+ * appended yet. On error returns invalid timestamp.
+ */
+uint64_t pmemstream_write_buffer_flush(struct pmemstream_write_buffer *buffer);
+
+/* Emits staged entries of a write 'buffer' if the first of them has waited at least 'max_delay_ns' nanoseconds (see
+ * pmemstream_write_buffer_new). Appends check that deadline themselves, but if they may stop for a while, the thread
+ * which owns the buffer should call this function periodically (e.g. from its event loop or on a timer), so that
+ * staged entries do not wait longer than that. It does nothing for buffers created with 'max_delay_ns' equal to 0.
+ *
+ * It returns 0 on success (also if nothing had to be emitted), error code otherwise (entries stay staged then).
+ */
+int pmemstream_write_buffer_poll(struct pmemstream_write_buffer *buffer);
+
 /* Returns the most recent committed timestamp in the given stream. All entries with timestamps less than or equal to
  * that timestamp can be treated as committed.
  *
@@ -220,12 +574,53 @@ struct pmemstream_async_wait_fut pmemstream_async_wait_committed(struct pmemstre
  */
 struct pmemstream_async_wait_fut pmemstream_async_wait_persisted(struct pmemstream *stream, uint64_t timestamp);
 
+/* Blocks until all entries up to specified 'timestamp' are committed. A calling thread which can't make progress
+ * (e.g. waits for other threads to publish their entries) sleeps instead of spinning.
+ *
+ * Returns 0 on success. It returns -1 if 'stream' is NULL or 'timestamp' was not acquired by any append (yet).
+ */
+int pmemstream_wait_committed(struct pmemstream *stream, uint64_t timestamp);
+
+/* Blocks until all entries up to specified 'timestamp' are persisted. Behaves like pmemstream_wait_committed.
+ *
+ * Returns 0 on success. It returns -1 if 'stream' is NULL or 'timestamp' was not acquired by any append (yet).
+ */
+int pmemstream_wait_persisted(struct pmemstream *stream, uint64_t timestamp);
+
+/* Commits as many entries as possible, without waiting for any (not yet published) entry. Entries are committed
+ * only if no other thread is committing at the moment - it is meant to be called periodically, e.g. by an event loop
+ * or a housekeeping thread. It does not revoke timestamp leases (see pmemstream_config_set_timestamp_lease_size):
+ * entries following a timestamp which is leased, but not handed out yet, are not committed.
+ *
+ * Published entries of asynchronous appends might still have their data copied - the call does not wait for these
+ * copies. Copies are checked once: entries preceding the first one which is not copied yet are committed, and the
+ * remaining ones are committed by the next call (or by any thread which waits for them to be committed).
+ *
+ * Returns committed timestamp (after processing). On error returns invalid timestamp.
+ */
+uint64_t pmemstream_process_committed(struct pmemstream *stream);
+
+/* Commits (see pmemstream_process_committed) and persists as many entries as possible, without waiting for any
+ * (not yet published) entry.
+ *
+ * Returns persisted timestamp (after processing). On error returns invalid timestamp.
+ */
+uint64_t pmemstream_process_persisted(struct pmemstream *stream);
+
 /* Returns pointer to the data of the given 'entry' (if it points to a valid entry).
- * On error returns NULL.
+ * On error, or if data of the entry is compressed (see PMEMSTREAM_REGION_CODEC), returns NULL.
  */
 const void *pmemstream_entry_data(struct pmemstream *stream, struct pmemstream_entry entry);
 
-/* Returns the size of the data of given 'entry'. It's the same value as was passed to `pmemstream_append`.
+/* Copies data of the given 'entry' into 'buffer' of 'size' bytes, decompressing it if needed. 'buffer' must be at
+ * least pmemstream_entry_size bytes long.
+ *
+ * It returns 0 on success, error code otherwise (e.g. if the entry's codec is not registered in the stream).
+ */
+int pmemstream_entry_read(struct pmemstream *stream, struct pmemstream_entry entry, void *buffer, size_t size);
+
+/* Returns the size of the data of given 'entry'. It's the same value as was passed to `pmemstream_append`
+ * (size of uncompressed data, for compressed entries).
  * Note that pmemstream_entry contains metadata along with appended data - the space occupied
  * by pmemstream_entry is actually bigger than the size of appended data.
  *
@@ -289,6 +684,16 @@ void pmemstream_region_iterator_delete(struct pmemstream_region_iterator **itera
 int pmemstream_entry_iterator_new(struct pmemstream_entry_iterator **iterator, struct pmemstream *stream,
 				  struct pmemstream_region region);
 
+/* Creates a new pmemstream_entry_iterator for given 'chain' and assigns it to 'iterator' pointer.
+ * Such iterator goes over entries of all regions of the chain, in the order of regions in the chain. Once it reaches
+ * the end of a region which the chain already rolled past, it moves on to the next region.
+ * It's used with the same functions as an iterator created by pmemstream_entry_iterator_new.
+ *
+ * Returns 0 on success, and error code otherwise.
+ */
+int pmemstream_region_chain_entry_iterator_new(struct pmemstream_entry_iterator **iterator,
+					       struct pmemstream_region_chain *chain);
+
 /* Checks that entry 'iterator' is in valid state.
  *
  * Returns 0 when iterator is valid, and error code otherwise.
@@ -300,6 +705,15 @@ int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterato
  */
 void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iterator);
 
+/* Sets entry 'iterator' to the first entry (in the order of iteration) with timestamp not less than 'timestamp',
+ * or sets iterator to invalid entry if there is no such entry. Timestamps of entries within a region usually
+ * increase, so it can be used to resume reading from a checkpoint timestamp.
+ *
+ * Offsets and timestamps of every few entries of a region are sampled in DRAM (during the first seek in the region),
+ * so subsequent seeks only examine a few entries preceding the sought one.
+ */
+void pmemstream_entry_iterator_seek_timestamp(struct pmemstream_entry_iterator *iterator, uint64_t timestamp);
+
 /* Moves entry 'iterator' to next entry if possible.
  * It iterates over all committed (but not necessarily persisted) entries. They are accessed
  * in the order of appending (which is always linear). Note: entries cannot be removed from the stream,
@@ -97,7 +97,8 @@ int entry_iterator_initialize(struct pmemstream_entry_iterator *iterator, struct
 						 .offset = PMEMSTREAM_INVALID_OFFSET,
 						 .region = region,
 						 .region_runtime = region_rt,
-						 .perform_recovery = perform_recovery};
+						 .perform_recovery = perform_recovery,
+						 .chain_head = {.offset = PMEMSTREAM_INVALID_OFFSET}};
 	memcpy(iterator, &iter, sizeof(struct pmemstream_entry_iterator));
 
 	return 0;
@@ -129,6 +130,51 @@ err:
 	return ret;
 }
 
+/* Returns true if nothing more can be read from the current region of the iterator: there is no space left at its
+ * offset or nothing was written there (it's not even reserved). */
+static bool entry_iterator_is_at_data_end(const struct pmemstream_entry_iterator *iterator)
+{
+	struct pmemstream_entry_iterator tmp_iterator = *iterator;
+	skip_padding(&tmp_iterator);
+
+	uint64_t end_offset = region_end_offset(&iterator->stream->data, iterator->region);
+	if (tmp_iterator.offset + sizeof(struct span_entry) > end_offset) {
+		return true;
+	}
+
+	const struct span_base *span_base = span_offset_to_span_ptr(&iterator->stream->data, tmp_iterator.offset);
+	struct span_base span = {.size_and_type = __atomic_load_n(&span_base->size_and_type, __ATOMIC_ACQUIRE)};
+	return span_get_type(&span) == SPAN_EMPTY && span_get_size(&span) == 0;
+}
+
+/* Moves iterator, which follows a region chain, to the first valid entry of the following regions of the chain.
+ * It's only done at the end of data of the current region - after the chain rolled to the next region, nothing more
+ * is appended to the previous one. Returns true if the iterator was moved. */
+static bool entry_iterator_move_to_next_chained_region(struct pmemstream_entry_iterator *iterator)
+{
+	if (iterator->chain_head.offset == PMEMSTREAM_INVALID_OFFSET || !entry_iterator_is_at_data_end(iterator)) {
+		return false;
+	}
+
+	struct pmemstream_region next = region_next_chained(&iterator->stream->data, iterator->region);
+	while (next.offset != PMEMSTREAM_INVALID_OFFSET) {
+		struct pmemstream_entry_iterator tmp_iterator;
+		if (entry_iterator_initialize(&tmp_iterator, iterator->stream, next, iterator->perform_recovery)) {
+			return false;
+		}
+
+		tmp_iterator.offset = region_first_entry_offset(next);
+		tmp_iterator.chain_head = iterator->chain_head;
+		if (check_entry_and_maybe_recover_region(&tmp_iterator)) {
+			memcpy(iterator, &tmp_iterator, sizeof(struct pmemstream_entry_iterator));
+			return true;
+		}
+		next = region_next_chained(&iterator->stream->data, next);
+	}
+
+	return false;
+}
+
 int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterator)
 {
 	if (!iterator) {
@@ -139,7 +185,7 @@ int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterato
 		return -1;
 	}
 
-	if (check_entry_consistency(iterator)) {
+	if (check_entry_consistency(iterator) || entry_iterator_move_to_next_chained_region(iterator)) {
 		return 0;
 	}
 	return -1;
@@ -147,9 +193,8 @@ int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterato
 
 static bool pmemstream_entry_iterator_offset_is_inside_region(struct pmemstream_entry_iterator *iterator)
 {
-	const struct span_base *span_base = span_offset_to_span_ptr(&iterator->stream->data, iterator->region.offset);
-	uint64_t region_end_offset = iterator->region.offset + span_get_total_size(span_base);
-	return iterator->offset >= iterator->region.offset && iterator->offset <= region_end_offset;
+	uint64_t end_offset = region_end_offset(&iterator->stream->data, iterator->region);
+	return iterator->offset >= iterator->region.offset && iterator->offset <= end_offset;
 }
 
 static void pmemstream_entry_iterator_advance(struct pmemstream_entry_iterator *iterator)
@@ -181,7 +226,23 @@ void pmemstream_entry_iterator_next(struct pmemstream_entry_iterator *iterator)
 		 * increment - this check should not fail unless stream was corrupted. */
 		assert(pmemstream_entry_iterator_offset_is_inside_region(iterator));
 	}
-	check_entry_and_maybe_recover_region(iterator);
+	if (!check_entry_and_maybe_recover_region(iterator)) {
+		entry_iterator_move_to_next_chained_region(iterator);
+	}
+}
+
+/* Moves iterator, which follows a region chain, back to the first region of the chain. */
+static int entry_iterator_move_to_chain_head(struct pmemstream_entry_iterator *iterator)
+{
+	if (iterator->chain_head.offset == PMEMSTREAM_INVALID_OFFSET ||
+	    iterator->region.offset == iterator->chain_head.offset) {
+		return 0;
+	}
+
+	struct pmemstream_region chain_head = iterator->chain_head;
+	int ret = entry_iterator_initialize(iterator, iterator->stream, chain_head, iterator->perform_recovery);
+	iterator->chain_head = chain_head;
+	return ret;
 }
 
 void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iterator)
@@ -191,12 +252,49 @@ void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iter
 	}
 	struct pmemstream_entry_iterator tmp_iterator = *iterator;
 
-	tmp_iterator.offset = region_first_entry_offset(iterator->region);
-	if (!check_entry_and_maybe_recover_region(&tmp_iterator)) {
+	if (entry_iterator_move_to_chain_head(&tmp_iterator)) {
+		iterator->offset = PMEMSTREAM_INVALID_OFFSET;
+		return;
+	}
+
+	tmp_iterator.offset = region_first_entry_offset(tmp_iterator.region);
+	if (!check_entry_and_maybe_recover_region(&tmp_iterator) &&
+	    !entry_iterator_move_to_next_chained_region(&tmp_iterator)) {
+		iterator->offset = PMEMSTREAM_INVALID_OFFSET;
+		return;
+	}
+	memcpy(iterator, &tmp_iterator, sizeof(struct pmemstream_entry_iterator));
+	assert(pmemstream_entry_iterator_is_valid(iterator) == 0);
+}
+
+void pmemstream_entry_iterator_seek_timestamp(struct pmemstream_entry_iterator *iterator, uint64_t timestamp)
+{
+	if (!iterator) {
+		return;
+	}
+	struct pmemstream_entry_iterator tmp_iterator = *iterator;
+
+	if (entry_iterator_move_to_chain_head(&tmp_iterator)) {
 		iterator->offset = PMEMSTREAM_INVALID_OFFSET;
 		return;
 	}
-	iterator->offset = tmp_iterator.offset;
+
+	/* Following regions of a chain are only searched if there is no such entry in the current one. */
+	while (!region_seek_timestamp(&tmp_iterator, timestamp)) {
+		struct pmemstream_region next = {.offset = PMEMSTREAM_INVALID_OFFSET};
+		if (tmp_iterator.chain_head.offset != PMEMSTREAM_INVALID_OFFSET) {
+			next = region_next_chained(&tmp_iterator.stream->data, tmp_iterator.region);
+		}
+
+		struct pmemstream_region chain_head = tmp_iterator.chain_head;
+		if (next.offset == PMEMSTREAM_INVALID_OFFSET ||
+		    entry_iterator_initialize(&tmp_iterator, iterator->stream, next, iterator->perform_recovery)) {
+			iterator->offset = PMEMSTREAM_INVALID_OFFSET;
+			return;
+		}
+		tmp_iterator.chain_head = chain_head;
+	}
+	memcpy(iterator, &tmp_iterator, sizeof(struct pmemstream_entry_iterator));
 	assert(pmemstream_entry_iterator_is_valid(iterator) == 0);
 }
 
@@ -18,9 +18,13 @@ extern "C" {
 struct pmemstream_entry_iterator {
 	bool perform_recovery;
 	struct pmemstream *const stream;
-	const struct pmemstream_region region;
-	struct pmemstream_region_runtime *const region_runtime;
+	/* Region (and its runtime) which is currently iterated over. It only changes if iterator follows a chain. */
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
 	uint64_t offset;
+	/* First region of a region chain followed by the iterator (PMEMSTREAM_INVALID_OFFSET if iterator does not
+	 * follow any chain). */
+	struct pmemstream_region chain_head;
 };
 
 struct pmemstream_region_iterator {
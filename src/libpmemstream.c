@@ -3,6 +3,7 @@
 
 /* Implementation of public C API */
 
+#include "common/futex.h"
 #include "common/util.h"
 #include "libpmemstream_internal.h"
 #include "region.h"
@@ -10,6 +11,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <sched.h>
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,15 +38,150 @@ static void pmemstream_init(struct pmemstream *stream)
 
 	allocator_initialize(&stream->data, &stream->header->region_allocator_header, stream->usable_size);
 
+	stream->header->layout_version = PMEMSTREAM_LAYOUT_VERSION;
 	stream->header->stream_size = stream->stream_size;
 	stream->header->block_size = stream->block_size;
-	stream->header->persisted_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	for (size_t i = 0; i < PMEMSTREAM_PERSISTED_TIMESTAMP_LANES; i++) {
+		stream->header->persisted_timestamps[i].timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	}
 	stream->data.persist(stream->header, sizeof(struct pmemstream_header));
 
 	stream->data.memcpy(stream->header->signature, PMEMSTREAM_SIGNATURE, strlen(PMEMSTREAM_SIGNATURE),
 			    PMEM2_F_MEM_NONTEMPORAL);
 }
 
+/* Returns the biggest of persisted timestamps stored in the header. */
+static uint64_t pmemstream_header_persisted_timestamp(const struct pmemstream_header *header)
+{
+	uint64_t persisted_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	for (size_t i = 0; i < PMEMSTREAM_PERSISTED_TIMESTAMP_LANES; i++) {
+		uint64_t timestamp = __atomic_load_n(&header->persisted_timestamps[i].timestamp, __ATOMIC_ACQUIRE);
+		if (timestamp > persisted_timestamp) {
+			persisted_timestamp = timestamp;
+		}
+	}
+
+	return persisted_timestamp;
+}
+
+/*
+ * Stream events. Threads which wait for a commit (or persist) and can't make progress by themselves, sleep until
+ * some other thread publishes an operation (publish_event), commits or persists timestamps (commit_event), instead
+ * of spinning.
+ *
+ * Waiter registers itself (pmemstream_event_prepare_wait), checks its condition once again and sleeps only if
+ * the event hasn't changed since the registration. Notifier changes the state first and then checks for waiters.
+ * Full barriers on both sides guarantee that either the waiter sees the new state or the notifier sees the waiter.
+ */
+static uint32_t pmemstream_event_prepare_wait(struct pmemstream_event *event)
+{
+	__atomic_fetch_add(&event->waiters, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&event->value, __ATOMIC_SEQ_CST);
+}
+
+static void pmemstream_event_cancel_wait(struct pmemstream_event *event)
+{
+	__atomic_fetch_sub(&event->waiters, 1, __ATOMIC_RELAXED);
+}
+
+/* Sleeps until the event happens after 'value' was read in pmemstream_event_prepare_wait. */
+static void pmemstream_event_wait(struct pmemstream_event *event, uint32_t value)
+{
+	futex_wait(&event->value, value);
+	pmemstream_event_cancel_wait(event);
+}
+
+static void pmemstream_event_notify(struct pmemstream_event *event)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&event->waiters, __ATOMIC_RELAXED) == 0) {
+		return;
+	}
+
+	__atomic_fetch_add(&event->value, 1, __ATOMIC_SEQ_CST);
+	futex_wake_all(&event->value);
+}
+
+static void pmemstream_timestamp_leases_revoke_preceding(struct pmemstream *stream, uint64_t timestamp);
+
+/* Sleeps until 'stream_timestamp' (committed or persisted timestamp of the stream) reaches 'timestamp'. Used in
+ * background persist mode, in which timestamps are committed and persisted by the background thread. The background
+ * thread does not revoke leases (see pmemstream_process_committed), so the waiting thread does it. */
+static void pmemstream_background_wait(struct pmemstream *stream, uint64_t *stream_timestamp, uint64_t timestamp)
+{
+	pmemstream_timestamp_leases_revoke_preceding(stream, timestamp);
+
+	while (__atomic_load_n(stream_timestamp, __ATOMIC_ACQUIRE) < timestamp) {
+		uint32_t value = pmemstream_event_prepare_wait(&stream->commit_event);
+		if (__atomic_load_n(stream_timestamp, __ATOMIC_ACQUIRE) < timestamp) {
+			pmemstream_event_wait(&stream->commit_event, value);
+		} else {
+			pmemstream_event_cancel_wait(&stream->commit_event);
+		}
+	}
+}
+
+/* Returns index of the persisted timestamp lane of the calling thread. Lanes are assigned to threads in
+ * round-robin fashion. */
+static size_t pmemstream_persisted_timestamp_lane(void)
+{
+	static uint64_t next_lane = 0;
+	static _Thread_local uint64_t lane = UINT64_MAX;
+
+	if (lane == UINT64_MAX) {
+		lane = __atomic_fetch_add(&next_lane, 1, __ATOMIC_RELAXED) % PMEMSTREAM_PERSISTED_TIMESTAMP_LANES;
+	}
+
+	return lane;
+}
+
+/* Sets persisted timestamp of the calling thread's lane to at least 'timestamp' (without persisting it).
+ * Returns pointer to the lane's timestamp. */
+static uint64_t *pmemstream_store_persisted_timestamp(struct pmemstream *stream, uint64_t timestamp)
+{
+	size_t lane = pmemstream_persisted_timestamp_lane();
+	uint64_t *lane_timestamp = &stream->header->persisted_timestamps[lane].timestamp;
+
+	uint64_t persisted_timestamp = __atomic_load_n(lane_timestamp, __ATOMIC_RELAXED);
+	while (persisted_timestamp < timestamp) {
+		const bool weak = true;
+		if (__atomic_compare_exchange_n(lane_timestamp, &persisted_timestamp, timestamp, weak, __ATOMIC_RELEASE,
+						__ATOMIC_RELAXED))
+			break;
+	}
+
+	return lane_timestamp;
+}
+
+/* Increases DRAM shadow of the persisted timestamp to at least 'timestamp', which must be already durable. */
+static void pmemstream_increase_persisted_timestamp(struct pmemstream *stream, uint64_t timestamp)
+{
+	uint64_t persisted_timestamp = __atomic_load_n(&stream->persisted_timestamp, __ATOMIC_RELAXED);
+	while (persisted_timestamp < timestamp) {
+		const bool weak = true;
+		if (__atomic_compare_exchange_n(&stream->persisted_timestamp, &persisted_timestamp, timestamp, weak,
+						__ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			pmemstream_event_notify(&stream->commit_event);
+			break;
+		}
+	}
+}
+
+/* Sets persisted timestamp of the calling thread's lane to at least 'timestamp', persists it and then updates
+ * the DRAM shadow. All entries with timestamps up to 'timestamp' must be already committed. */
+static void pmemstream_persist_timestamp(struct pmemstream *stream, uint64_t timestamp)
+{
+	/* Timestamp might have been persisted on commit already (see pmemstream_process_async_ops). */
+	if (__atomic_load_n(&stream->persisted_timestamp, __ATOMIC_ACQUIRE) >= timestamp) {
+		return;
+	}
+
+	uint64_t *lane_timestamp = pmemstream_store_persisted_timestamp(stream, timestamp);
+	stream->data.persist(lane_timestamp, sizeof(uint64_t));
+	pmemstream_increase_persisted_timestamp(stream, timestamp);
+}
+
 static size_t pmemstream_header_size_aligned(size_t block_size)
 {
 	return ALIGN_UP(sizeof(struct pmemstream_header), block_size);
@@ -105,6 +242,7 @@ static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
 
 	/* XXX: we could keep list of active regions in stream header/lanes and only iterate over them. */
 	struct pmemstream_region region;
+	uint64_t persisted_timestamp = pmemstream_persisted_timestamp(stream);
 	pmemstream_region_iterator_seek_first(iterator);
 
 	while (pmemstream_region_iterator_is_valid(iterator) == 0) {
@@ -112,7 +250,7 @@ static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
 		struct span_region *span_region =
 			(struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
 		if (span_region->max_valid_timestamp == UINT64_MAX) {
-			span_region->max_valid_timestamp = stream->header->persisted_timestamp;
+			span_region->max_valid_timestamp = persisted_timestamp;
 			stream->data.flush(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
 		} else {
 			/* If max_valid_timestamp is equal to a valid timestamp, this means that these regions
@@ -127,28 +265,126 @@ static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
 	return 0;
 }
 
-static int pmemstream_initialize_async_ops(struct pmemstream *stream)
+static int pmemstream_initialize_async_ops(struct pmemstream *stream, size_t max_concurrency)
 {
+	assert(IS_POW2(max_concurrency));
+
 	// XXX: aligned alloc?
-	stream->async_ops = malloc(PMEMSTREAM_MAX_CONCURRENCY * sizeof(struct async_operation));
+	stream->async_ops = malloc(max_concurrency * sizeof(struct async_operation));
 	if (!stream->async_ops) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < PMEMSTREAM_MAX_CONCURRENCY; i++) {
+	stream->max_concurrency = max_concurrency;
+	stream->async_ops_mask = max_concurrency - 1;
+
+	for (size_t i = 0; i < max_concurrency; i++) {
 		FUTURE_INIT_COMPLETE(&stream->async_ops[i].future);
+		stream->async_ops[i].segments.iovcnt = 0;
 		stream->async_ops[i].timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
 	}
 
 	return 0;
 }
 
+static int pmemstream_initialize_timestamp_leases(struct pmemstream *stream, size_t lease_size)
+{
+	stream->timestamp_lease_size = lease_size;
+	stream->timestamp_leases = NULL;
+	if (lease_size == 0) {
+		return 0;
+	}
+
+	/* Leased block (aligned to its size) along with the skipped timestamps must fit in the async_ops' ring. */
+	if (lease_size > stream->max_concurrency / 2) {
+		return -1;
+	}
+
+	stream->timestamp_leases = aligned_alloc(alignof(struct timestamp_lease),
+						 PMEMSTREAM_TIMESTAMP_LEASE_LANES * sizeof(struct timestamp_lease));
+	if (!stream->timestamp_leases) {
+		return -1;
+	}
+
+	/* Leases are empty - the first append in each lane leases a new block. */
+	for (size_t i = 0; i < PMEMSTREAM_TIMESTAMP_LEASE_LANES; i++) {
+		stream->timestamp_leases[i].next = ALIGN_UP(stream->next_timestamp, lease_size);
+	}
+
+	return 0;
+}
+
+/* Commits and persists published operations until the stream is deleted. Sleeps when there is nothing to do. */
+static void *pmemstream_background_persist(void *arg)
+{
+	struct pmemstream *stream = arg;
+
+	while (!__atomic_load_n(&stream->background_persist_stop, __ATOMIC_ACQUIRE)) {
+		uint64_t persisted_timestamp = pmemstream_persisted_timestamp(stream);
+		if (pmemstream_process_persisted(stream) != persisted_timestamp) {
+			continue;
+		}
+
+		/* Copies of data of released operations (see pmemstream_process_once) complete without any event. */
+		if (__atomic_load_n(&stream->released_timestamp, __ATOMIC_ACQUIRE) != PMEMSTREAM_INVALID_TIMESTAMP) {
+			sched_yield();
+			continue;
+		}
+
+		/* Register as a waiter only when idle, so that appends do not pay for notifications while the thread
+		 * is busy. Operations published (or committed by others) after the registration wake the thread up. */
+		uint32_t value = pmemstream_event_prepare_wait(&stream->publish_event);
+		if (!__atomic_load_n(&stream->background_persist_stop, __ATOMIC_ACQUIRE) &&
+		    pmemstream_process_persisted(stream) == persisted_timestamp) {
+			pmemstream_event_wait(&stream->publish_event, value);
+		} else {
+			pmemstream_event_cancel_wait(&stream->publish_event);
+		}
+	}
+
+	return NULL;
+}
+
+static int pmemstream_start_background_persist(struct pmemstream *stream, bool background_persist)
+{
+	stream->background_persist = background_persist;
+	stream->background_persist_stop = false;
+	if (!background_persist) {
+		return 0;
+	}
+
+	return pthread_create(&stream->background_persist_thread, NULL, pmemstream_background_persist, stream);
+}
+
+static void pmemstream_stop_background_persist(struct pmemstream *stream)
+{
+	if (!stream->background_persist) {
+		return;
+	}
+
+	__atomic_store_n(&stream->background_persist_stop, true, __ATOMIC_RELEASE);
+	pmemstream_event_notify(&stream->publish_event);
+	pthread_join(stream->background_persist_thread, NULL);
+}
+
 int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pmem2_map *map)
+{
+	return pmemstream_from_map_with_config(stream, block_size, map, NULL);
+}
+
+int pmemstream_from_map_with_config(struct pmemstream **stream, size_t block_size, struct pmem2_map *map,
+				    const struct pmemstream_config *config)
 {
 	if (!stream) {
 		return -1;
 	}
 
+	struct pmemstream_config default_config;
+	if (!config) {
+		config_initialize_default(&default_config);
+		config = &default_config;
+	}
+
 	if (pmemstream_validate_sizes(block_size, map)) {
 		return -1;
 	}
@@ -173,11 +409,24 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 
 	if (pmemstream_is_initialized(s) != 0) {
 		pmemstream_init(s);
+	} else if (s->header->layout_version != PMEMSTREAM_LAYOUT_VERSION) {
+		/* Stream was created by a version of the library with an incompatible layout. */
+		free(s);
+		return -1;
 	}
 
-	s->committed_timestamp = s->header->persisted_timestamp;
-	s->processing_timestamp = s->header->persisted_timestamp;
-	s->next_timestamp = s->header->persisted_timestamp + 1;
+	uint64_t persisted_timestamp = pmemstream_header_persisted_timestamp(s->header);
+	s->committed_timestamp = persisted_timestamp;
+	s->processing_timestamp = persisted_timestamp;
+	s->released_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	s->next_timestamp = persisted_timestamp + 1;
+	s->publish_event.value = 0;
+	s->publish_event.waiters = 0;
+	s->commit_event.value = 0;
+	s->commit_event.waiters = 0;
+	s->group_commit_leader = 0;
+	s->persisted_timestamp = persisted_timestamp;
+	s->persisted_on_commit_timestamp = persisted_timestamp;
 
 	allocator_runtime_initialize(&s->data, &s->header->region_allocator_header);
 
@@ -191,27 +440,38 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 		goto err_region_runtimes;
 	}
 
-	ret = pmemstream_initialize_async_ops(s);
+	ret = pmemstream_initialize_async_ops(s, config->max_concurrency);
 	if (ret) {
 		goto err_async_ops;
 	}
 
+	s->nontemporal_copy_threshold = config->nontemporal_copy_threshold;
+	memcpy(s->codecs, config->codecs, sizeof(s->codecs));
+
+	ret = pmemstream_initialize_timestamp_leases(s, config->timestamp_lease_size);
+	if (ret) {
+		goto err_timestamp_leases;
+	}
+
 	s->data_mover_sync = data_mover_sync_new();
 	if (!s->data_mover_sync) {
 		goto err_data_mover;
 	}
+	s->data_mover_sync_vdm = data_mover_sync_get_vdm(s->data_mover_sync);
 
-	ret = sem_init(&s->async_ops_semaphore, 0, PMEMSTREAM_MAX_CONCURRENCY);
+	ret = pmemstream_start_background_persist(s, config->background_persist);
 	if (ret) {
-		goto err_sem_init;
+		goto err_background_persist;
 	}
 
 	*stream = s;
 	return 0;
 
-err_sem_init:
+err_background_persist:
 	data_mover_sync_delete(s->data_mover_sync);
 err_data_mover:
+	free(s->timestamp_leases);
+err_timestamp_leases:
 	free(s->async_ops);
 err_async_ops:
 	region_runtimes_map_destroy(s->region_runtimes_map);
@@ -230,10 +490,11 @@ void pmemstream_delete(struct pmemstream **stream)
 	}
 	struct pmemstream *s = *stream;
 
+	pmemstream_stop_background_persist(s);
 	region_runtimes_map_destroy(s->region_runtimes_map);
 	free(s->async_ops);
+	free(s->timestamp_leases);
 	data_mover_sync_delete(s->data_mover_sync);
-	sem_destroy(&s->async_ops_semaphore);
 
 	free(s);
 	*stream = NULL;
@@ -246,10 +507,7 @@ uint64_t pmemstream_persisted_timestamp(struct pmemstream *stream)
 		return PMEMSTREAM_INVALID_TIMESTAMP;
 	}
 
-	/* Make sure that persisted_timestamp is actually persisted before returning. */
-	uint64_t timestamp = __atomic_load_n(&stream->header->persisted_timestamp, __ATOMIC_ACQUIRE);
-	stream->data.persist(&stream->header->persisted_timestamp, sizeof(uint64_t));
-	return timestamp;
+	return __atomic_load_n(&stream->persisted_timestamp, __ATOMIC_ACQUIRE);
 }
 
 uint64_t pmemstream_committed_timestamp(struct pmemstream *stream)
@@ -270,6 +528,19 @@ static size_t pmemstream_region_total_size_aligned(struct pmemstream *stream, si
 // stream owns the region object - the user gets a reference, but it's not
 // necessary to hold on to it and explicitly delete it.
 int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
+{
+	return pmemstream_region_allocate_with_flags(stream, size, 0, region);
+}
+
+int pmemstream_region_allocate_with_flags(struct pmemstream *stream, size_t size, uint64_t flags,
+					  struct pmemstream_region *region)
+{
+	struct pmemstream_region prev_chained_region = {.offset = PMEMSTREAM_INVALID_OFFSET};
+	return pmemstream_region_allocate_chained(stream, size, flags, prev_chained_region, region);
+}
+
+int pmemstream_region_allocate_chained(struct pmemstream *stream, size_t size, uint64_t flags,
+				       struct pmemstream_region prev_chained_region, struct pmemstream_region *region)
 {
 	// XXX: lock
 
@@ -277,11 +548,40 @@ int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pm
 		return -1;
 	}
 
+	if (flags & ~PMEMSTREAM_REGION_VALID_FLAGS) {
+		return -1;
+	}
+
+	const uint64_t align_flags = PMEMSTREAM_REGION_ENTRY_ALIGN_64 | PMEMSTREAM_REGION_ENTRY_ALIGN_256;
+	if ((flags & align_flags) == align_flags) {
+		return -1;
+	}
+
+	/* Compact entries have no space for a checksum. */
+	const uint64_t format_flags = PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_ENTRY_CHECKSUMS;
+	if ((flags & format_flags) == format_flags) {
+		return -1;
+	}
+
+	/* Entries with codec metadata have neither compact metadata nor a checksum. */
+	const unsigned codec_id = region_codec(flags);
+	if (codec_id != 0 && ((flags & format_flags) != 0 || !stream->codecs[codec_id].compress)) {
+		return -1;
+	}
+
 	size_t total_size = pmemstream_region_total_size_aligned(stream, size);
 	size_t requested_size = total_size - sizeof(struct span_region);
 
-	const uint64_t offset =
-		allocator_region_allocate(&stream->data, &stream->header->region_allocator_header, requested_size);
+	/* Persistent index is placed at the end of the region - there must be space left for entries. */
+	if (region_persistent_index_size(flags, total_size) + sizeof(struct span_entry) > requested_size) {
+		return -1;
+	}
+
+	/* Timestamps of all entries appended to the region will be bigger than the committed timestamp. */
+	const uint64_t timestamp_base = pmemstream_committed_timestamp(stream);
+	struct allocator_header *allocator_header = &stream->header->region_allocator_header;
+	const uint64_t offset = allocator_region_allocate(&stream->data, allocator_header, requested_size, flags,
+							  timestamp_base, prev_chained_region.offset);
 	if (offset == PMEMSTREAM_INVALID_OFFSET) {
 		return -1;
 	}
@@ -321,10 +621,6 @@ size_t pmemstream_region_usable_size(struct pmemstream *stream, struct pmemstrea
 		return 0;
 	}
 
-	const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, region.offset);
-	assert(span_get_type(span_region) == SPAN_REGION);
-	uint64_t region_end_offset = region.offset + span_get_total_size(span_region);
-
 	struct pmemstream_region_runtime *region_runtime;
 	ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
 	if (ret) {
@@ -332,7 +628,7 @@ size_t pmemstream_region_usable_size(struct pmemstream *stream, struct pmemstrea
 	}
 	uint64_t append_offset = region_runtime_get_append_offset_relaxed(region_runtime);
 
-	return region_end_offset - append_offset;
+	return region_end_offset(&stream->data, region) - append_offset;
 }
 
 int pmemstream_region_free(struct pmemstream *stream, struct pmemstream_region region)
@@ -358,8 +654,55 @@ const void *pmemstream_entry_data(struct pmemstream *stream, struct pmemstream_e
 		return NULL;
 	}
 
-	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
-	return span_entry->data;
+	const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, entry.offset);
+	if (span_entry_is_compressed(span_base) &&
+	    span_compressed_entry_get_codec((const struct span_compressed_entry *)span_base) != 0) {
+		/* Compressed data can only be read with pmemstream_entry_read. */
+		return NULL;
+	}
+	return (const uint8_t *)span_base + span_entry_header_size(span_base);
+}
+
+// copies (decompressed) data of the entry to the buffer
+int pmemstream_entry_read(struct pmemstream *stream, struct pmemstream_entry entry, void *buffer, size_t size)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, entry.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!buffer) {
+		return -1;
+	}
+
+	const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, entry.offset);
+	const uint8_t *data = (const uint8_t *)span_base + span_entry_header_size(span_base);
+	size_t stored_size = span_get_size(span_base);
+	if (!span_entry_is_compressed(span_base)) {
+		if (size < stored_size) {
+			return -1;
+		}
+		memcpy(buffer, data, stored_size);
+		return 0;
+	}
+
+	const struct span_compressed_entry *compressed_entry = (const struct span_compressed_entry *)span_base;
+	unsigned codec_id = span_compressed_entry_get_codec(compressed_entry);
+	size_t uncompressed_size = span_compressed_entry_get_uncompressed_size(compressed_entry);
+	if (size < uncompressed_size) {
+		return -1;
+	}
+
+	if (codec_id == 0) {
+		memcpy(buffer, data, stored_size);
+		return 0;
+	}
+
+	if (codec_id >= PMEMSTREAM_MAX_CODECS || !stream->codecs[codec_id].decompress) {
+		return -1;
+	}
+
+	return stream->codecs[codec_id].decompress(data, stored_size, buffer, uncompressed_size) ? -1 : 0;
 }
 
 // returns the size of the entry
@@ -369,8 +712,11 @@ size_t pmemstream_entry_size(struct pmemstream *stream, struct pmemstream_entry
 	if (ret) {
 		return 0;
 	}
-	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
-	return span_get_size(&span_entry->span_base);
+	const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, entry.offset);
+	if (span_entry_is_compressed(span_base)) {
+		return span_compressed_entry_get_uncompressed_size((const struct span_compressed_entry *)span_base);
+	}
+	return span_get_size(span_base);
 }
 
 uint64_t pmemstream_entry_timestamp(struct pmemstream *stream, struct pmemstream_entry entry)
@@ -380,7 +726,17 @@ uint64_t pmemstream_entry_timestamp(struct pmemstream *stream, struct pmemstream
 		return PMEMSTREAM_INVALID_TIMESTAMP;
 	}
 	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
-	return span_entry->timestamp;
+	if (span_get_type(&span_entry->span_base) != SPAN_COMPACT_ENTRY) {
+		return span_entry->timestamp;
+	}
+
+	/* Timestamp of a compact entry is stored relative to the timestamp base of its region. */
+	struct pmemstream_region_runtime *region_runtime =
+		region_runtimes_map_find_containing(stream->region_runtimes_map, entry.offset);
+	if (!region_runtime) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+	return region_runtime_entry_timestamp(region_runtime, span_entry);
 }
 
 int pmemstream_region_runtime_initialize(struct pmemstream *stream, struct pmemstream_region region,
@@ -401,137 +757,490 @@ int pmemstream_region_runtime_initialize(struct pmemstream *stream, struct pmems
 	return region_runtime_iterate_and_initialize_for_write_locked(stream, region, *region_runtime);
 }
 
-static size_t pmemstream_entry_total_size_aligned(size_t size)
+static size_t pmemstream_entry_total_size_aligned(const struct pmemstream_region_runtime *region_runtime, size_t size)
 {
-	struct span_entry span_entry = {.span_base = span_base_create(size, SPAN_ENTRY)};
-	return span_get_total_size(&span_entry.span_base);
+	return region_entry_total_size(region_runtime_get_flags(region_runtime), size);
 }
 
-struct async_operation *pmemstream_async_operation(struct pmemstream *stream, uint64_t timestamp)
+/* Returns pointer to data of an entry placed at 'offset' in the region. */
+static uint8_t *pmemstream_entry_data_ptr(struct pmemstream *stream,
+					  const struct pmemstream_region_runtime *region_runtime, uint64_t offset)
 {
-	// XXX: require MAX_CONCURRENCY to be power of two and use bit ops
-	uint64_t ops_index = timestamp % PMEMSTREAM_MAX_CONCURRENCY;
-	return &stream->async_ops[ops_index];
+	return (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset) +
+		region_entry_header_size(region_runtime_get_flags(region_runtime));
 }
 
-static uint64_t pmemstream_acquire_timestamp(struct pmemstream *stream)
+/* Checks if entries of specified 'sizes' can be stored in the region. In regions with compact entries, entries have
+ * limited size and timestamps of all entries must fit in the delta range. Reservations are rejected (as if the
+ * region was full) once half of that range is used - the other half is left for entries which are already
+ * reserved, but not published yet. */
+static bool pmemstream_region_accepts_entries(struct pmemstream *stream,
+					      const struct pmemstream_region_runtime *region_runtime,
+					      const size_t *sizes, size_t count)
 {
-	while (sem_trywait(&stream->async_ops_semaphore) != 0) {
-		struct pmemstream_async_wait_fut future =
-			pmemstream_async_wait_committed(stream, pmemstream_committed_timestamp(stream) + 1);
-		while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
-			;
+	if (!region_runtime_has_compact_entries(region_runtime)) {
+		return true;
 	}
 
-	uint64_t timestamp = __atomic_fetch_add(&stream->next_timestamp, 1, __ATOMIC_RELAXED);
-	assert(__atomic_load_n(&pmemstream_async_operation(stream, timestamp)->timestamp, __ATOMIC_RELAXED) ==
-	       PMEMSTREAM_INVALID_TIMESTAMP);
-	return timestamp;
+	for (size_t i = 0; i < count; i++) {
+		if (!region_entry_size_fits(region_runtime_get_flags(region_runtime), sizes[i])) {
+			return false;
+		}
+	}
+
+	uint64_t next_timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_RELAXED);
+	return next_timestamp - region_runtime_get_timestamp_base(region_runtime) <= SPAN_COMPACT_ENTRY_MAX_DELTA / 2;
 }
 
-static void pmemstream_publish_timestamp(struct pmemstream *stream, uint64_t timestamp)
+/* Returns size of space occupied by an entry of 'size' bytes in the region, including alignment padding. */
+static size_t pmemstream_entry_slot_size(const struct pmemstream_region_runtime *region_runtime, size_t size)
 {
-	assert(__atomic_load_n(&pmemstream_async_operation(stream, timestamp)->timestamp, __ATOMIC_RELAXED) ==
-	       PMEMSTREAM_INVALID_TIMESTAMP);
-	__atomic_store_n(&pmemstream_async_operation(stream, timestamp)->timestamp, timestamp, __ATOMIC_RELEASE);
+	return region_entry_slot_size(region_runtime_entry_alignment(region_runtime),
+				      pmemstream_entry_total_size_aligned(region_runtime, size));
 }
 
-int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region region,
-		       struct pmemstream_region_runtime *region_runtime, size_t size,
-		       struct pmemstream_entry *reserved_entry, void **data_addr)
+bool pmemstream_region_is_full(struct pmemstream *stream, struct pmemstream_region region,
+			       const struct pmemstream_region_runtime *region_runtime, size_t size)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
-	if (ret) {
-		return ret;
+	if (!pmemstream_region_accepts_entries(stream, region_runtime, &size, 1)) {
+		return true;
 	}
 
-	size_t entry_total_size_span_aligned = pmemstream_entry_total_size_aligned(size);
-	const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, region.offset);
-	assert(span_get_type(span_region) == SPAN_REGION);
-
-	if (!reserved_entry) {
-		return -1;
-	}
+	uint64_t append_offset = region_runtime_get_append_offset_acquire(region_runtime);
+	uint64_t end_offset = region_end_offset(&stream->data, region);
+	return append_offset + pmemstream_entry_slot_size(region_runtime, size) > end_offset;
+}
 
-	if (!region_runtime) {
-		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
-		if (ret) {
-			return ret;
-		}
+/* Returns codec used to compress data of entries appended to the region or NULL if data is stored as is. */
+static const struct pmemstream_codec *pmemstream_region_codec(struct pmemstream *stream,
+							      const struct pmemstream_region_runtime *region_runtime)
+{
+	unsigned codec_id = region_codec(region_runtime_get_flags(region_runtime));
+	if (codec_id == 0 || !stream->codecs[codec_id].compress) {
+		return NULL;
 	}
+	return &stream->codecs[codec_id];
+}
 
-	uint64_t offset = region_runtime_get_append_offset_acquire(region_runtime);
-	uint8_t *destination = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset);
-	assert(offset >= region.offset + offsetof(struct span_region, data));
-	if (offset + entry_total_size_span_aligned > region.offset + span_get_total_size(span_region)) {
-		return -1;
-	}
+struct async_operation *pmemstream_async_operation(struct pmemstream *stream, uint64_t timestamp)
+{
+	uint64_t ops_index = timestamp & stream->async_ops_mask;
+	return &stream->async_ops[ops_index];
+}
 
-	region_runtime_increase_append_offset(region_runtime, entry_total_size_span_aligned);
+static void pmemstream_publish_timestamp(struct pmemstream *stream, uint64_t timestamp);
 
-	reserved_entry->offset = offset;
-	/* data is right after the entry metadata */
-	*data_addr = destination + sizeof(struct span_entry);
+/* Publishes no-op operations for timestamps from range [first_timestamp, end_timestamp), which will not be used
+ * by any entry. Such operations are skipped by commit. */
+static void pmemstream_publish_skipped_timestamps(struct pmemstream *stream, uint64_t first_timestamp,
+						  uint64_t end_timestamp)
+{
+	for (uint64_t timestamp = first_timestamp; timestamp < end_timestamp; timestamp++) {
+		struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+		async_op->segments.iovcnt = 0;
+		async_op->batch_count = 0;
+		pmemstream_publish_timestamp(stream, timestamp);
+	}
+}
 
-	return ret;
+/* Returns event which follows changes of the timestamp monitored by a poller notifier. */
+static struct pmemstream_event *pmemstream_notifier_event(struct pmemstream *stream,
+							  const struct future_notifier *notifier)
+{
+	if (notifier->poller.ptr_to_monitor == &stream->committed_timestamp) {
+		return &stream->commit_event;
+	}
+	return &stream->publish_event;
 }
 
-int pmemstream_publish(struct pmemstream *stream, struct pmemstream_region region,
-		       struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry, size_t size)
+/* Polls 'future' (of this library) until it completes. If the future can't make progress until some other thread
+ * publishes an operation or commits timestamps (poller notifier is set), the calling thread sleeps until the next
+ * such event. Otherwise (e.g. it waits for a data copy) the thread only yields. */
+static void pmemstream_future_wait(struct pmemstream *stream, struct future *future)
 {
-	int ret = pmemstream_async_publish(stream, region, region_runtime, entry, size);
-	if (ret) {
-		return ret;
+	struct future_notifier notifier;
+	if (future_poll(future, &notifier) == FUTURE_STATE_COMPLETE) {
+		return;
 	}
 
-	// XXX: runtime_wait or blocking call
-	uint64_t timestamp = pmemstream_entry_timestamp(stream, entry);
-	struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(stream, timestamp);
-	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
-		;
+	while (true) {
+		if (notifier.notifier_used != FUTURE_NOTIFIER_POLLER) {
+			sched_yield();
+			if (future_poll(future, &notifier) == FUTURE_STATE_COMPLETE) {
+				return;
+			}
+			continue;
+		}
 
-	return 0;
+		/* Register as a waiter before polling again, so that no event is missed before the sleep. */
+		struct pmemstream_event *event = pmemstream_notifier_event(stream, &notifier);
+		uint32_t value = pmemstream_event_prepare_wait(event);
+		if (future_poll(future, &notifier) == FUTURE_STATE_COMPLETE) {
+			pmemstream_event_cancel_wait(event);
+			return;
+		}
+
+		if (notifier.notifier_used == FUTURE_NOTIFIER_POLLER &&
+		    pmemstream_notifier_event(stream, &notifier) == event) {
+			pmemstream_event_wait(event, value);
+			if (future_poll(future, &notifier) == FUTURE_STATE_COMPLETE) {
+				return;
+			}
+		} else {
+			pmemstream_event_cancel_wait(event);
+		}
+	}
 }
 
-// synchronously appends data buffer to the end of the region
-int pmemstream_append(struct pmemstream *stream, struct pmemstream_region region,
-		      struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
-		      struct pmemstream_entry *new_entry)
+/* Acquires 'count' consecutive timestamps (and async_ops slots for them), the first of which is a multiple of
+ * 'alignment' (power of 2). Returns the first acquired timestamp. Timestamps skipped due to the alignment
+ * are published as no-op operations.
+ *
+ * next_timestamp and committed_timestamp work as a ticket counter: slots of all committed timestamps are free, so
+ * timestamps up to committed_timestamp + max_concurrency can be handed out. Slots are released (in bulk)
+ * by increasing committed_timestamp. */
+static uint64_t pmemstream_acquire_timestamps(struct pmemstream *stream, uint64_t count, uint64_t alignment)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
-	if (ret) {
-		return ret;
-	}
+	assert(count > 0 && count <= stream->max_concurrency);
+	assert(IS_POW2(alignment));
+
+	uint64_t timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_RELAXED);
+	uint64_t first_timestamp;
+	while (true) {
+		uint64_t committed_timestamp = pmemstream_committed_timestamp(stream);
+		if (timestamp <= committed_timestamp) {
+			/* Stale value of next_timestamp (it is always bigger than committed_timestamp). */
+			timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_RELAXED);
+			continue;
+		}
 
-	struct pmemstream_entry entry;
-	ret = pmemstream_async_append(stream, data_mover_sync_get_vdm(stream->data_mover_sync), region, region_runtime,
-				      data, size, &entry);
-	if (ret) {
-		return ret;
-	}
+		first_timestamp = ALIGN_UP(timestamp, alignment);
+		if (first_timestamp + count - 1 - committed_timestamp <= stream->max_concurrency) {
+			const bool weak = true;
+			if (__atomic_compare_exchange_n(&stream->next_timestamp, &timestamp, first_timestamp + count,
+							weak, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+			continue;
+		}
 
-	if (new_entry) {
-		*new_entry = entry;
+		/* All slots are in use - help with committing the oldest operation (or wait for the background
+		 * thread to commit it). */
+		if (stream->background_persist) {
+			pmemstream_background_wait(stream, &stream->committed_timestamp, committed_timestamp + 1);
+		} else {
+			struct pmemstream_async_wait_fut future =
+				pmemstream_async_wait_committed(stream, committed_timestamp + 1);
+			pmemstream_future_wait(stream, FUTURE_AS_RUNNABLE(&future));
+		}
+
+		timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_RELAXED);
 	}
 
-	// XXX: runtime_wait or blocking call
-	struct pmemstream_async_wait_fut future =
-		pmemstream_async_wait_persisted(stream, pmemstream_entry_timestamp(stream, entry));
-	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
-		;
+	pmemstream_publish_skipped_timestamps(stream, timestamp, first_timestamp);
 
-	return 0;
+#ifndef NDEBUG
+	for (uint64_t i = 0; i < count; i++) {
+		assert(__atomic_load_n(&pmemstream_async_operation(stream, first_timestamp + i)->timestamp,
+				       __ATOMIC_RELAXED) == PMEMSTREAM_INVALID_TIMESTAMP);
+	}
+#endif
+	return first_timestamp;
 }
 
-static int pmemstream_async_publish_generic(struct pmemstream *stream, struct pmemstream_region region,
-					    struct pmemstream_region_runtime *region_runtime,
-					    struct vdm_operation_future *future, struct pmemstream_entry entry,
-					    size_t size)
+static struct timestamp_lease *pmemstream_timestamp_lease(struct pmemstream *stream, struct pmemstream_region region)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
-	if (ret) {
-		return ret;
-	}
+	/* Fibonacci hashing - regions are placed at multiples of the region size, which would collide otherwise. */
+	uint64_t hash = (region.offset * 11400714819323198485ULL) >> 32;
+	return &stream->timestamp_leases[hash % PMEMSTREAM_TIMESTAMP_LEASE_LANES];
+}
+
+/* Gives up all timestamps left in the 'lease' (whose 'next' was observed to be equal to 'next').
+ * Returns false if the lease has changed in the meantime or there was nothing to revoke. */
+static bool pmemstream_timestamp_lease_revoke(struct pmemstream *stream, struct timestamp_lease *lease,
+					      uint64_t next)
+{
+	uint64_t end = ALIGN_UP(next, stream->timestamp_lease_size);
+	if (next == end) {
+		return false;
+	}
+
+	const bool weak = false;
+	if (!__atomic_compare_exchange_n(&lease->next, &next, end, weak, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	pmemstream_publish_skipped_timestamps(stream, next, end);
+	return true;
+}
+
+/* Revokes lease which holds (not handed out yet) 'timestamp', if any. Called by commit, which can't proceed
+ * until 'timestamp' is published. Returns true if 'timestamp' was published (as a no-op) by this call. */
+static bool pmemstream_timestamp_leases_revoke(struct pmemstream *stream, uint64_t timestamp)
+{
+	if (!stream->timestamp_leases) {
+		return false;
+	}
+
+	for (size_t i = 0; i < PMEMSTREAM_TIMESTAMP_LEASE_LANES; i++) {
+		struct timestamp_lease *lease = &stream->timestamp_leases[i];
+		uint64_t next = __atomic_load_n(&lease->next, __ATOMIC_RELAXED);
+		if (next <= timestamp && timestamp < ALIGN_UP(next, stream->timestamp_lease_size)) {
+			return pmemstream_timestamp_lease_revoke(stream, lease, next);
+		}
+	}
+
+	return false;
+}
+
+/* Revokes all leases which hold (not handed out yet) timestamps up to 'timestamp'. */
+static void pmemstream_timestamp_leases_revoke_preceding(struct pmemstream *stream, uint64_t timestamp)
+{
+	if (!stream->timestamp_leases) {
+		return;
+	}
+
+	for (size_t i = 0; i < PMEMSTREAM_TIMESTAMP_LEASE_LANES; i++) {
+		struct timestamp_lease *lease = &stream->timestamp_leases[i];
+		uint64_t next = __atomic_load_n(&lease->next, __ATOMIC_RELAXED);
+		while (next <= timestamp && !pmemstream_timestamp_lease_revoke(stream, lease, next)) {
+			/* Lease is empty (nothing to revoke) or it has changed in the meantime. */
+			uint64_t current_next = __atomic_load_n(&lease->next, __ATOMIC_RELAXED);
+			if (current_next == next) {
+				break;
+			}
+			next = current_next;
+		}
+	}
+}
+
+/* Acquires 'count' consecutive timestamps from a lease of a lane assigned to the 'region'. If the lease
+ * does not have enough timestamps left, the rest of it is given up (so that timestamps handed out by a lane
+ * always increase) and a new block is leased. */
+static uint64_t pmemstream_acquire_leased_timestamps(struct pmemstream *stream, struct pmemstream_region region,
+						     uint64_t count)
+{
+	const uint64_t lease_size = stream->timestamp_lease_size;
+	struct timestamp_lease *lease = pmemstream_timestamp_lease(stream, region);
+
+	uint64_t next = __atomic_load_n(&lease->next, __ATOMIC_RELAXED);
+	while (true) {
+		const bool weak = true;
+		uint64_t end = ALIGN_UP(next, lease_size);
+		if (next + count <= end) {
+			if (__atomic_compare_exchange_n(&lease->next, &next, next + count, weak, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				return next;
+		} else if (next == end || pmemstream_timestamp_lease_revoke(stream, lease, next)) {
+			next = end;
+			break;
+		} else {
+			next = __atomic_load_n(&lease->next, __ATOMIC_RELAXED);
+		}
+	}
+
+	if (count > lease_size) {
+		return pmemstream_acquire_timestamps(stream, count, 1);
+	}
+
+	uint64_t first_timestamp = pmemstream_acquire_timestamps(stream, lease_size, lease_size);
+
+	/* Lane's lease might have been renewed by some other thread in the meantime - give up rest of the new block
+	 * in such case. Values of 'next' only increase, so there is no ABA problem. */
+	const bool weak = false;
+	if (!__atomic_compare_exchange_n(&lease->next, &next, first_timestamp + count, weak, __ATOMIC_RELAXED,
+					 __ATOMIC_RELAXED)) {
+		pmemstream_publish_skipped_timestamps(stream, first_timestamp + count, first_timestamp + lease_size);
+	}
+
+	return first_timestamp;
+}
+
+/* Acquires 'count' consecutive timestamps for entries appended to the 'region'. */
+static uint64_t pmemstream_acquire_region_timestamps(struct pmemstream *stream, struct pmemstream_region region,
+						     uint64_t count)
+{
+	if (stream->timestamp_leases) {
+		return pmemstream_acquire_leased_timestamps(stream, region, count);
+	}
+
+	return pmemstream_acquire_timestamps(stream, count, 1);
+}
+
+static void pmemstream_publish_timestamp(struct pmemstream *stream, uint64_t timestamp)
+{
+	assert(__atomic_load_n(&pmemstream_async_operation(stream, timestamp)->timestamp, __ATOMIC_RELAXED) ==
+	       PMEMSTREAM_INVALID_TIMESTAMP);
+	__atomic_store_n(&pmemstream_async_operation(stream, timestamp)->timestamp, timestamp, __ATOMIC_RELEASE);
+	pmemstream_event_notify(&stream->publish_event);
+}
+
+/* Polls data future of the 'async_op'. If there are any segments left to be copied, copy of the next segment
+ * is started once the previous one completes. */
+static enum future_state pmemstream_async_operation_poll(struct async_operation *async_op)
+{
+	enum future_state state = future_poll(FUTURE_AS_RUNNABLE(&async_op->future), NULL);
+
+	struct async_operation_segments *segments = &async_op->segments;
+	while (state == FUTURE_STATE_COMPLETE && segments->iovcnt > 0) {
+		async_op->future = vdm_memcpy(segments->vdm, segments->destination, segments->iov->iov_base,
+					      segments->iov->iov_len, 0);
+		segments->destination += segments->iov->iov_len;
+		++segments->iov;
+		--segments->iovcnt;
+
+		state = future_poll(FUTURE_AS_RUNNABLE(&async_op->future), NULL);
+	}
+
+	return state;
+}
+
+/* Copy policy: data of big entries, copied by the stream itself (using its synchronous data mover), is written with
+ * non-temporal stores. Such data is durable after a drain and it is not flushed again on commit. Small entries are
+ * copied with regular stores and flushed on commit (along with other entries placed next to them). */
+static bool pmemstream_copy_nontemporal(struct pmemstream *stream, struct vdm *vdm, size_t size)
+{
+	return size >= stream->nontemporal_copy_threshold && vdm == stream->data_mover_sync_vdm;
+}
+
+/* Starts copy of entry data, according to the copy policy. 'data_persisted' is set to true if data was
+ * copied with non-temporal stores.
+ *
+ * Data copied by the stream itself is copied right away (inline), without creating a vdm future - for small
+ * entries, cost of the future machinery would dominate the cost of the copy. Returned future is complete then. */
+static struct vdm_operation_future pmemstream_copy_data(struct pmemstream *stream, struct vdm *vdm, void *destination,
+							const void *data, size_t size, bool *data_persisted)
+{
+	*data_persisted = false;
+	if (vdm != stream->data_mover_sync_vdm) {
+		return vdm_memcpy(vdm, destination, (void *)data, size, 0);
+	}
+
+	if (pmemstream_copy_nontemporal(stream, vdm, size)) {
+		stream->data.memcpy(destination, data, size, PMEM2_F_MEM_NONTEMPORAL | PMEM2_F_MEM_NODRAIN);
+		*data_persisted = true;
+	} else {
+		memcpy(destination, data, size);
+	}
+
+	struct vdm_operation_future future;
+	FUTURE_INIT_COMPLETE(&future);
+	return future;
+}
+
+/* Stores padding span in the unused space following an entry placed at 'offset' (only in regions with aligned
+ * entries). Returns pointer to the padding or NULL if there is none. */
+static struct span_base *pmemstream_store_entry_padding(struct pmemstream *stream,
+							const struct pmemstream_region_runtime *region_runtime,
+							uint64_t offset, size_t size)
+{
+	size_t entry_total_size = pmemstream_entry_total_size_aligned(region_runtime, size);
+	size_t slot_size = pmemstream_entry_slot_size(region_runtime, size);
+	if (slot_size == entry_total_size) {
+		return NULL;
+	}
+
+	uint8_t *padding_dst = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset + entry_total_size);
+	struct span_base *padding = (struct span_base *)padding_dst;
+	size_t padding_size = slot_size - entry_total_size - sizeof(struct span_empty);
+	span_base_atomic_store(padding, span_base_create(padding_size, SPAN_EMPTY));
+	return padding;
+}
+
+/* In multi-writer regions, entries are claimed right after their space is reserved: span header of each entry is set
+ * to SPAN_ENTRY type and the entry's size, with no timestamp (so it's not valid yet), and padding following it (if
+ * any) is stored. Publishing an entry of the reserved size only completes its metadata, so all spans of the region can
+ * be walked through at any time. Metadata of claimed entries is not persisted here - it's persisted on commit of
+ * entries placed after them (see region_runtime_flush_spans). Header of the first entry is stored as the last one, so
+ * the whole reservation is claimed at once. */
+static void pmemstream_claim_entries(struct pmemstream *stream, const struct pmemstream_region_runtime *region_runtime,
+				     uint64_t offset, const size_t *sizes, size_t count)
+{
+	struct span_base *first_span_base = (struct span_base *)pmemstream_offset_to_ptr(&stream->data, offset);
+	struct span_base first_claim = span_base_create(0, SPAN_EMPTY);
+	for (size_t i = 0; i < count; i++) {
+		pmemstream_store_entry_padding(stream, region_runtime, offset, sizes[i]);
+
+		size_t entry_total_size = pmemstream_entry_total_size_aligned(region_runtime, sizes[i]);
+		struct span_base claim = span_base_create(entry_total_size - sizeof(struct span_entry), SPAN_ENTRY);
+		if (i == 0) {
+			first_claim = claim;
+		} else {
+			struct span_base *span_base =
+				(struct span_base *)pmemstream_offset_to_ptr(&stream->data, offset);
+			span_base_atomic_store(span_base, claim);
+		}
+
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+	span_base_atomic_store(first_span_base, first_claim);
+}
+
+/* Reserves space for 'count' entries, placed contiguously in a region.
+ * Returns offset of the first entry or PMEMSTREAM_INVALID_OFFSET if there is not enough space. */
+static uint64_t pmemstream_reserve_entries(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+					   const size_t *sizes, size_t count)
+{
+	if (!pmemstream_region_accepts_entries(stream, region_runtime, sizes, count)) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	size_t batch_total_size = 0;
+	for (size_t i = 0; i < count; i++) {
+		batch_total_size += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	uint64_t offset = region_runtime_reserve(region_runtime, batch_total_size);
+	if (offset != PMEMSTREAM_INVALID_OFFSET && region_runtime_is_multi_writer(region_runtime)) {
+		pmemstream_claim_entries(stream, region_runtime, offset, sizes, count);
+	}
+
+	return offset;
+}
+
+int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region region,
+		       struct pmemstream_region_runtime *region_runtime, size_t size,
+		       struct pmemstream_entry *reserved_entry, void **data_addr)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!reserved_entry) {
+		return -1;
+	}
+
+	if (!region_runtime) {
+		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	uint64_t offset = pmemstream_reserve_entries(stream, region_runtime, &size, 1);
+	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	reserved_entry->offset = offset;
+	/* data is right after the entry metadata */
+	*data_addr = pmemstream_entry_data_ptr(stream, region_runtime, offset);
+
+	return ret;
+}
+
+int pmemstream_reserve_batch(struct pmemstream *stream, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const size_t *sizes, size_t count,
+			     struct pmemstream_entry *reserved_entries, void **data)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!sizes || !reserved_entries || !data || count == 0 || count > stream->max_concurrency) {
+		return -1;
+	}
 
 	if (!region_runtime) {
 		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
@@ -540,53 +1249,498 @@ static int pmemstream_async_publish_generic(struct pmemstream *stream, struct pm
 		}
 	}
 
-	// XXX: can we move it after future_poll?
-	uint64_t timestamp = pmemstream_acquire_timestamp(stream);
-
-	struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
-	uint8_t *destination = (uint8_t *)span_offset_to_span_ptr(&stream->data, entry.offset);
-	size_t entry_total_size_span_aligned = pmemstream_entry_total_size_aligned(size);
-
-	async_op->future = *future;
-	async_op->entry = entry;
-	async_op->size = entry_total_size_span_aligned;
-	/* Do not set timestamp here, this is done in publish. */
-
-	// XXX: once miniasync supports batch operations, we should not call poll here.
-	// Instead, we can do it on commit for multiple futures at once, or even create
-	// the futures lazily on commit.
-	future_poll(FUTURE_AS_RUNNABLE(&async_op->future), NULL);
+	uint64_t offset = pmemstream_reserve_entries(stream, region_runtime, sizes, count);
+	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		reserved_entries[i].offset = offset;
+		data[i] = pmemstream_entry_data_ptr(stream, region_runtime, offset);
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	return 0;
+}
+
+/* Extends index of a region allocated with PMEMSTREAM_REGION_PERSISTENT_INDEX flag with newly committed entries, so
+ * that they are not examined by seeks and recovery after the stream is reopened. */
+static void pmemstream_extend_region_index(struct pmemstream *stream, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	if (!region_has_persistent_index(span_region->flags)) {
+		return;
+	}
+
+	struct pmemstream_entry_iterator iterator;
+	if (entry_iterator_initialize(&iterator, stream, region, false) == 0) {
+		region_index_extend(&iterator);
+	}
+}
+
+/* Commits and persists all timestamps acquired so far (at least up to 'timestamp'), as a group commit leader. */
+static void pmemstream_group_commit_lead(struct pmemstream *stream, uint64_t timestamp)
+{
+	uint64_t last_timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_ACQUIRE) - 1;
+	assert(last_timestamp >= timestamp);
+
+	/* With leases, most of the acquired timestamps are not handed out yet - committing them would revoke all
+	 * leases. */
+	if (stream->timestamp_leases) {
+		last_timestamp = timestamp;
+	}
+
+	/* Data of all entries is persisted during commit. */
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_committed(stream, last_timestamp);
+	pmemstream_future_wait(stream, FUTURE_AS_RUNNABLE(&future));
+
+	pmemstream_persist_timestamp(stream, last_timestamp);
+}
+
+/* Blocks until entry with the given 'timestamp' is persisted. Concurrent synchronous appenders form a group:
+ * one of them (leader) commits all pending entries and updates persisted timestamp once for the whole group,
+ * while the others (followers) just wait for the leader to finish. */
+static void pmemstream_group_commit(struct pmemstream *stream, uint64_t timestamp)
+{
+	if (stream->background_persist) {
+		pmemstream_background_wait(stream, &stream->persisted_timestamp, timestamp);
+		return;
+	}
+
+	while (__atomic_load_n(&stream->persisted_timestamp, __ATOMIC_ACQUIRE) < timestamp) {
+		uint64_t expected = 0;
+		const bool weak = false;
+		if (__atomic_compare_exchange_n(&stream->group_commit_leader, &expected, 1, weak, __ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED)) {
+			if (__atomic_load_n(&stream->persisted_timestamp, __ATOMIC_ACQUIRE) < timestamp) {
+				pmemstream_group_commit_lead(stream, timestamp);
+			}
+			__atomic_store_n(&stream->group_commit_leader, 0, __ATOMIC_RELEASE);
+			/* Followers, not covered by this group, can become a leader now. */
+			pmemstream_event_notify(&stream->commit_event);
+		} else {
+			/* Wait for the leader to finish. */
+			uint32_t value = pmemstream_event_prepare_wait(&stream->commit_event);
+			if (__atomic_load_n(&stream->persisted_timestamp, __ATOMIC_ACQUIRE) < timestamp &&
+			    __atomic_load_n(&stream->group_commit_leader, __ATOMIC_ACQUIRE) != 0) {
+				pmemstream_event_wait(&stream->commit_event, value);
+			} else {
+				pmemstream_event_cancel_wait(&stream->commit_event);
+			}
+		}
+	}
+}
+
+int pmemstream_publish(struct pmemstream *stream, struct pmemstream_region region,
+		       struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry, size_t size)
+{
+	int ret = pmemstream_async_publish(stream, region, region_runtime, entry, size);
+	if (ret) {
+		return ret;
+	}
+
+	pmemstream_group_commit(stream, pmemstream_entry_timestamp(stream, entry));
+	pmemstream_extend_region_index(stream, region);
+
+	return 0;
+}
+
+// synchronously appends data buffer to the end of the region
+int pmemstream_append(struct pmemstream *stream, struct pmemstream_region region,
+		      struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
+		      struct pmemstream_entry *new_entry)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	struct pmemstream_entry entry;
+	ret = pmemstream_async_append(stream, stream->data_mover_sync_vdm, region, region_runtime, data, size, &entry);
+	if (ret) {
+		return ret;
+	}
+
+	if (new_entry) {
+		*new_entry = entry;
+	}
+
+	pmemstream_group_commit(stream, pmemstream_entry_timestamp(stream, entry));
+	pmemstream_extend_region_index(stream, region);
+
+	return 0;
+}
+
+// synchronously appends data from multiple buffers (as a single entry) to the end of the region
+int pmemstream_appendv(struct pmemstream *stream, struct pmemstream_region region,
+		       struct pmemstream_region_runtime *region_runtime, const struct iovec *iov, size_t iovcnt,
+		       struct pmemstream_entry *new_entry)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	struct pmemstream_entry entry;
+	ret = pmemstream_async_appendv(stream, stream->data_mover_sync_vdm, region, region_runtime, iov, iovcnt,
+				       &entry);
+	if (ret) {
+		return ret;
+	}
+
+	if (new_entry) {
+		*new_entry = entry;
+	}
+
+	pmemstream_group_commit(stream, pmemstream_entry_timestamp(stream, entry));
+	pmemstream_extend_region_index(stream, region);
+
+	return 0;
+}
+
+static int pmemstream_append_batch_impl(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+					struct pmemstream_region_runtime *region_runtime, const void *const *data,
+					const size_t *sizes, size_t count, struct pmemstream_entry *new_entries,
+					uint64_t *last_timestamp);
+
+// synchronously appends multiple data buffers (as separate entries) to the end of the region
+int pmemstream_append_batch(struct pmemstream *stream, struct pmemstream_region region,
+			    struct pmemstream_region_runtime *region_runtime, const void *const *data,
+			    const size_t *sizes, size_t count, struct pmemstream_entry *new_entries)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	uint64_t last_timestamp;
+	ret = pmemstream_append_batch_impl(stream, stream->data_mover_sync_vdm, region, region_runtime, data, sizes,
+					   count, new_entries, &last_timestamp);
+	if (ret) {
+		return ret;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	/* The whole batch is persisted at once, so it's enough to wait for its last entry. */
+	pmemstream_group_commit(stream, last_timestamp);
+	pmemstream_extend_region_index(stream, region);
+
+	return 0;
+}
+
+/* In multi-writer regions, entries are claimed with the size they were reserved with (see pmemstream_claim_entries).
+ * If an entry is published with a different size (placing it in the same slot), padding following it moves. New
+ * padding must be persistent before the entry's metadata (with the actual size) is stored - metadata of the claim
+ * might be persistent already and, after a crash, recovery would not be able to walk past this entry. */
+static void pmemstream_reclaim_entries(struct pmemstream *stream,
+				       const struct pmemstream_region_runtime *region_runtime,
+				       struct pmemstream_entry first_entry, const size_t *sizes, size_t count)
+{
+	bool flushed = false;
+	uint64_t offset = first_entry.offset;
+	for (size_t i = 0; i < count; i++) {
+		const struct span_base *claim = span_offset_to_span_ptr(&stream->data, offset);
+		if (span_get_total_size(claim) != pmemstream_entry_total_size_aligned(region_runtime, sizes[i])) {
+			struct span_base *padding =
+				pmemstream_store_entry_padding(stream, region_runtime, offset, sizes[i]);
+			if (padding) {
+				stream->data.flush(padding, sizeof(*padding));
+				flushed = true;
+			}
+		}
+
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	if (flushed) {
+		stream->data.drain();
+	}
+}
+
+/* Publishes 'count' entries, placed contiguously in a region, starting at 'first_entry'. Operations for all
+ * timestamps (starting from 'first_timestamp') must have their futures already set. In regions with a codec,
+ * 'codec_and_sizes' describe (compressed) data of the entries - if it's NULL, data of all entries is stored as is. */
+static void pmemstream_publish_entries(struct pmemstream *stream, struct pmemstream_region region,
+				       struct pmemstream_region_runtime *region_runtime, uint64_t first_timestamp,
+				       struct pmemstream_entry first_entry, const size_t *sizes,
+				       const uint64_t *codec_and_sizes, size_t count)
+{
+	uint64_t offset = first_entry.offset;
+	for (size_t i = 0; i < count; i++) {
+		struct async_operation *async_op = pmemstream_async_operation(stream, first_timestamp + i);
+		async_op->region_runtime = region_runtime;
+		async_op->entry.offset = offset;
+		async_op->size = pmemstream_entry_total_size_aligned(region_runtime, sizes[i]);
+		async_op->batch_count = (i == 0) ? count : 0;
+		async_op->batch_size = 0;
+		/* Do not set timestamp here, this is done in publish. */
+
+		// XXX: once miniasync supports batch operations, we should not call poll here.
+		// Instead, we can do it on commit for multiple futures at once, or even create
+		// the futures lazily on commit.
+		pmemstream_async_operation_poll(async_op);
+
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	/* First operation persists the whole batch. */
+	pmemstream_async_operation(stream, first_timestamp)->batch_size = offset - first_entry.offset;
+
+	if (region_runtime_is_multi_writer(region_runtime)) {
+		/* Entries are already claimed and next entry metadata is already cleared (and might be concurrently
+		 * claimed by other thread). */
+		pmemstream_reclaim_entries(stream, region_runtime, first_entry, sizes, count);
+	} else {
+		/* Padding is persisted along with the batch. */
+		uint64_t entry_offset = first_entry.offset;
+		for (size_t i = 0; i < count; i++) {
+			pmemstream_store_entry_padding(stream, region_runtime, entry_offset, sizes[i]);
+			entry_offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+		}
+
+		if (offset + sizeof(struct span_entry) <= region_end_offset(&stream->data, region)) {
+			/* Clear next entry metadata (unless the entry ends exactly at the region's end). It is
+			 * persisted along with the batch. */
+			struct span_empty span_empty = {.span_base = span_base_create(0, SPAN_EMPTY)};
+			span_base_atomic_store((struct span_base *)pmemstream_offset_to_ptr(&stream->data, offset),
+					       span_empty.span_base);
+			pmemstream_async_operation(stream, first_timestamp)->batch_size += sizeof(struct span_entry);
+		}
+	}
+
+	/* Store entries metadata. They are not visible for iterators until the whole batch is committed. */
+	offset = first_entry.offset;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *destination = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset);
+		if (region_runtime_has_compact_entries(region_runtime)) {
+			struct span_base span_base =
+				region_runtime_compact_entry_create(region_runtime, sizes[i], first_timestamp + i);
+			span_base_atomic_store((struct span_base *)destination, span_base);
+		} else {
+			uint64_t flags = region_runtime_get_flags(region_runtime);
+			struct span_entry span_entry = {.span_base = region_entry_span_base_create(flags, sizes[i]),
+							.timestamp = first_timestamp + i};
+			if (span_entry_is_compressed(&span_entry.span_base)) {
+				struct span_compressed_entry *compressed_entry =
+					(struct span_compressed_entry *)destination;
+				compressed_entry->codec_and_size = codec_and_sizes ? codec_and_sizes[i] : 0;
+			}
+			span_entry_atomic_store((struct span_entry *)destination, span_entry);
+		}
+
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	/* The first operation is published as the last one - it's processed only when the whole batch is published. */
+	for (size_t i = count; i > 0; i--) {
+		pmemstream_publish_timestamp(stream, first_timestamp + i - 1);
+	}
+}
+
+static int pmemstream_async_publish_generic(struct pmemstream *stream, struct pmemstream_region region,
+					    struct pmemstream_region_runtime *region_runtime,
+					    struct vdm_operation_future *future,
+					    const struct async_operation_segments *segments, bool data_persisted,
+					    struct pmemstream_entry entry, size_t size, uint64_t codec_and_size)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!region_runtime) {
+		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	/* Reservation which can't be published is released, so that it does not block the region. */
+	if (!region_entry_size_fits(region_runtime_get_flags(region_runtime), size)) {
+		region_runtime_cancel_reservation(region_runtime, entry.offset);
+		return -1;
+	}
+
+	/* Entry might be smaller than its reservation - the unused tail is given back to the region. */
+	ret = region_runtime_shrink_reservation(region_runtime, entry.offset,
+						pmemstream_entry_slot_size(region_runtime, size));
+	if (ret) {
+		return ret;
+	}
+
+	// XXX: can we move it after future_poll?
+	uint64_t timestamp = pmemstream_acquire_region_timestamps(stream, region, 1);
+	struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+	async_op->future = *future;
+	async_op->data_persisted = data_persisted;
+	if (segments) {
+		async_op->segments = *segments;
+	} else {
+		async_op->segments.iovcnt = 0;
+	}
+	pmemstream_publish_entries(stream, region, region_runtime, timestamp, entry, &size, &codec_and_size, 1);
+
+	return 0;
+}
+
+int pmemstream_async_publish(struct pmemstream *stream, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry,
+			     size_t size)
+{
+	struct vdm_operation_future future;
+	FUTURE_INIT_COMPLETE(&future);
+
+	return pmemstream_async_publish_generic(stream, region, region_runtime, &future, NULL, false, entry, size, 0);
+}
+
+/* Publishes 'count' custom-written entries, reserved by pmemstream_reserve_batch. Sets 'last_timestamp' to
+ * the timestamp of the last entry. */
+static int pmemstream_publish_batch_impl(struct pmemstream *stream, struct pmemstream_region region,
+					 struct pmemstream_region_runtime *region_runtime,
+					 const struct pmemstream_entry *entries, const size_t *sizes, size_t count,
+					 uint64_t *last_timestamp)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!entries || !sizes || count == 0 || count > stream->max_concurrency) {
+		return -1;
+	}
+
+	if (!region_runtime) {
+		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	/* Entries of a batch are persisted at once, so they must be placed contiguously. */
+	uint64_t offset = entries[0].offset;
+	const uint64_t region_flags = region_runtime_get_flags(region_runtime);
+	for (size_t i = 0; i < count; i++) {
+		if (entries[i].offset != offset || !region_entry_size_fits(region_flags, sizes[i])) {
+			return -1;
+		}
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	uint64_t first_timestamp = pmemstream_acquire_region_timestamps(stream, region, count);
+	for (size_t i = 0; i < count; i++) {
+		struct async_operation *async_op = pmemstream_async_operation(stream, first_timestamp + i);
+		FUTURE_INIT_COMPLETE(&async_op->future);
+		async_op->segments.iovcnt = 0;
+		async_op->data_persisted = false;
+	}
+
+	pmemstream_publish_entries(stream, region, region_runtime, first_timestamp, entries[0], sizes, NULL, count);
+	*last_timestamp = first_timestamp + count - 1;
+
+	return 0;
+}
+
+int pmemstream_async_publish_batch(struct pmemstream *stream, struct pmemstream_region region,
+				   struct pmemstream_region_runtime *region_runtime,
+				   const struct pmemstream_entry *entries, const size_t *sizes, size_t count)
+{
+	uint64_t last_timestamp;
+	return pmemstream_publish_batch_impl(stream, region, region_runtime, entries, sizes, count, &last_timestamp);
+}
+
+int pmemstream_publish_batch(struct pmemstream *stream, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const struct pmemstream_entry *entries,
+			     const size_t *sizes, size_t count)
+{
+	uint64_t last_timestamp;
+	int ret = pmemstream_publish_batch_impl(stream, region, region_runtime, entries, sizes, count, &last_timestamp);
+	if (ret) {
+		return ret;
+	}
+
+	/* The whole batch is persisted at once, so it's enough to wait for its last entry. */
+	pmemstream_group_commit(stream, last_timestamp);
+	pmemstream_extend_region_index(stream, region);
+
+	return 0;
+}
+
+// asynchronously appends data buffer to the end of the region
+// To make sure that the entry is actually stored/committed one must call
+// pmemstream_async_wait_committed and poll returned future to completion.
+int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+			    struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
+			    struct pmemstream_entry *new_entry)
+{
+	if (!region_runtime) {
+		int ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	struct pmemstream_entry reserved_entry;
+	void *reserved_dest;
+	int ret = pmemstream_reserve(stream, region, region_runtime, size, &reserved_entry, &reserved_dest);
+	if (ret) {
+		return ret;
+	}
+
+	/* Data is compressed straight into the reserved space. It's kept compressed only if that saves space - the
+	 * unused tail of the reservation is given back to the region on publish. */
+	const struct pmemstream_codec *codec = pmemstream_region_codec(stream, region_runtime);
+	size_t compressed_size = (codec && size > 0) ? codec->compress(data, size, reserved_dest, size - 1) : 0;
 
-	/* Clear next entry metadata. */
-	struct span_empty span_empty = {.span_base = span_base_create(0, SPAN_EMPTY)};
-	span_base_atomic_store((struct span_base *)(destination + entry_total_size_span_aligned), span_empty.span_base);
+	/* In multi-writer regions, the unused tail becomes padding, which can't be exactly 8 bytes long (see
+	 * region_runtime_shrink_reservation) - data is stored as is in such a case. */
+	if (compressed_size != 0 && region_runtime_is_multi_writer(region_runtime)) {
+		size_t unused_size = pmemstream_entry_slot_size(region_runtime, size) -
+			pmemstream_entry_slot_size(region_runtime, compressed_size);
+		if (unused_size == sizeof(struct span_empty)) {
+			compressed_size = 0;
+		}
+	}
 
-	/* Store this entry metadata. */
-	struct span_entry span_entry = {.span_base = span_base_create(size, SPAN_ENTRY), .timestamp = timestamp};
-	span_entry_atomic_store((struct span_entry *)destination, span_entry);
+	struct vdm_operation_future future;
+	bool data_persisted = false;
+	size_t stored_size = size;
+	uint64_t codec_and_size = 0;
+	if (compressed_size != 0) {
+		FUTURE_INIT_COMPLETE(&future);
+		stored_size = compressed_size;
+		codec_and_size = span_compressed_entry_codec_and_size(
+			region_codec(region_runtime_get_flags(region_runtime)), size);
+	} else {
+		future = pmemstream_copy_data(stream, vdm, reserved_dest, data, size, &data_persisted);
+	}
+
+	ret = pmemstream_async_publish_generic(stream, region, region_runtime, &future, NULL, data_persisted,
+					       reserved_entry, stored_size, codec_and_size);
+	if (ret) {
+		return ret;
+	}
 
-	pmemstream_publish_timestamp(stream, timestamp);
+	if (new_entry) {
+		*new_entry = reserved_entry;
+	}
 
 	return 0;
 }
 
-int pmemstream_async_publish(struct pmemstream *stream, struct pmemstream_region region,
-			     struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry,
-			     size_t size)
+// asynchronously appends data from multiple buffers (as a single entry) to the end of the region
+// Segments are copied one after another, each by a separate vdm operation.
+int pmemstream_async_appendv(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+			     struct pmemstream_region_runtime *region_runtime, const struct iovec *iov, size_t iovcnt,
+			     struct pmemstream_entry *new_entry)
 {
-	struct vdm_operation_future future;
-	FUTURE_INIT_COMPLETE(&future);
-
-	return pmemstream_async_publish_generic(stream, region, region_runtime, &future, entry, size);
-}
+	if (!iov && iovcnt > 0) {
+		return -1;
+	}
 
-// asynchronously appends data buffer to the end of the region
-// To make sure that the entry is actually stored/committed one must call
-// pmemstream_async_wait_committed and poll returned future to completion.
-int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
-			    struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
-			    struct pmemstream_entry *new_entry)
-{
 	if (!region_runtime) {
 		int ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
 		if (ret) {
@@ -594,6 +1748,11 @@ int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct p
 		}
 	}
 
+	size_t size = 0;
+	for (size_t i = 0; i < iovcnt; i++) {
+		size += iov[i].iov_len;
+	}
+
 	struct pmemstream_entry reserved_entry;
 	void *reserved_dest;
 	int ret = pmemstream_reserve(stream, region, region_runtime, size, &reserved_entry, &reserved_dest);
@@ -601,8 +1760,30 @@ int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct p
 		return ret;
 	}
 
-	struct vdm_operation_future future = vdm_memcpy(vdm, reserved_dest, (void *)data, size, 0);
-	ret = pmemstream_async_publish_generic(stream, region, region_runtime, &future, reserved_entry, size);
+	struct vdm_operation_future future;
+	FUTURE_INIT_COMPLETE(&future);
+	struct async_operation_segments segments = {
+		.vdm = vdm, .iov = iov, .iovcnt = iovcnt, .destination = (uint8_t *)reserved_dest};
+
+	/* Segments copied by the stream itself are copied right away (see pmemstream_copy_data); copy policy
+	 * is chosen based on size of the whole entry. */
+	bool data_persisted = false;
+	if (vdm == stream->data_mover_sync_vdm) {
+		data_persisted = pmemstream_copy_nontemporal(stream, vdm, size);
+		for (size_t i = 0; i < iovcnt; i++) {
+			if (data_persisted) {
+				stream->data.memcpy(segments.destination, iov[i].iov_base, iov[i].iov_len,
+						    PMEM2_F_MEM_NONTEMPORAL | PMEM2_F_MEM_NODRAIN);
+			} else {
+				memcpy(segments.destination, iov[i].iov_base, iov[i].iov_len);
+			}
+			segments.destination += iov[i].iov_len;
+		}
+		segments.iovcnt = 0;
+	}
+
+	ret = pmemstream_async_publish_generic(stream, region, region_runtime, &future, &segments, data_persisted,
+					       reserved_entry, size, 0);
 	if (ret) {
 		return ret;
 	}
@@ -614,6 +1795,124 @@ int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct p
 	return 0;
 }
 
+static int pmemstream_append_batch_impl(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+					struct pmemstream_region_runtime *region_runtime, const void *const *data,
+					const size_t *sizes, size_t count, struct pmemstream_entry *new_entries,
+					uint64_t *last_timestamp)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	if (!data || !sizes || count > stream->max_concurrency) {
+		return -1;
+	}
+
+	if (!region_runtime) {
+		ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	struct pmemstream_entry first_entry;
+	first_entry.offset = pmemstream_reserve_entries(stream, region_runtime, sizes, count);
+	if (first_entry.offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	uint64_t first_timestamp = pmemstream_acquire_region_timestamps(stream, region, count);
+
+	uint64_t offset = first_entry.offset;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *destination = pmemstream_entry_data_ptr(stream, region_runtime, offset);
+		struct async_operation *async_op = pmemstream_async_operation(stream, first_timestamp + i);
+		async_op->future =
+			pmemstream_copy_data(stream, vdm, destination, data[i], sizes[i], &async_op->data_persisted);
+		async_op->segments.iovcnt = 0;
+
+		if (new_entries) {
+			new_entries[i].offset = offset;
+		}
+		offset += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+	}
+
+	pmemstream_publish_entries(stream, region, region_runtime, first_timestamp, first_entry, sizes, NULL, count);
+	*last_timestamp = first_timestamp + count - 1;
+
+	return 0;
+}
+
+// asynchronously appends multiple data buffers (as separate entries) to the end of the region
+int pmemstream_async_append_batch(struct pmemstream *stream, struct vdm *vdm, struct pmemstream_region region,
+				  struct pmemstream_region_runtime *region_runtime, const void *const *data,
+				  const size_t *sizes, size_t count, struct pmemstream_entry *new_entries)
+{
+	uint64_t last_timestamp;
+	return pmemstream_append_batch_impl(stream, vdm, region, region_runtime, data, sizes, count, new_entries,
+					    &last_timestamp);
+}
+
+int pmemstream_append_staged_batch(struct pmemstream *stream, struct pmemstream_region region,
+				   struct pmemstream_region_runtime *region_runtime, const uint8_t *staged,
+				   const size_t *sizes, size_t count, uint64_t *last_timestamp)
+{
+	if (count == 0 || count > stream->max_concurrency) {
+		return -1;
+	}
+
+	size_t staged_size = 0;
+	for (size_t i = 0; i < count; i++) {
+		staged_size += pmemstream_entry_total_size_aligned(region_runtime, sizes[i]);
+	}
+	size_t skipped_size = sizeof(struct span_base);
+	if (staged_size <= skipped_size) {
+		return -1;
+	}
+
+	struct pmemstream_entry first_entry;
+	first_entry.offset = pmemstream_reserve_entries(stream, region_runtime, sizes, count);
+	if (first_entry.offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	/* The whole batch is written at once (in regions with aligned entries - entry by entry, as each of them is
+	 * followed by padding). In multi-writer regions, span headers of all entries hold their claims, which must stay
+	 * intact until the batch is published - they are skipped (only the first one is skipped in other regions). All
+	 * entries are flushed together, on commit. */
+	uint8_t *destination = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, first_entry.offset);
+	bool multi_writer = region_runtime_is_multi_writer(region_runtime);
+	if (region_runtime_entry_alignment(region_runtime) == sizeof(span_bytes) && !multi_writer) {
+		memcpy(destination + skipped_size, staged + skipped_size, staged_size - skipped_size);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			size_t entry_total_size = pmemstream_entry_total_size_aligned(region_runtime, sizes[i]);
+			memcpy(destination + skipped_size, staged + skipped_size, entry_total_size - skipped_size);
+			destination += pmemstream_entry_slot_size(region_runtime, sizes[i]);
+			staged += entry_total_size;
+			skipped_size = multi_writer ? sizeof(struct span_base) : 0;
+		}
+	}
+
+	uint64_t first_timestamp = pmemstream_acquire_region_timestamps(stream, region, count);
+	for (size_t i = 0; i < count; i++) {
+		struct async_operation *async_op = pmemstream_async_operation(stream, first_timestamp + i);
+		FUTURE_INIT_COMPLETE(&async_op->future);
+		async_op->segments.iovcnt = 0;
+		async_op->data_persisted = false;
+	}
+
+	pmemstream_publish_entries(stream, region, region_runtime, first_timestamp, first_entry, sizes, NULL, count);
+	*last_timestamp = first_timestamp + count - 1;
+
+	return 0;
+}
+
 static bool pmemstream_acquire_processing_timestamp(struct pmemstream_async_wait_data *data)
 {
 	assert(data->last_timestamp == PMEMSTREAM_INVALID_TIMESTAMP);
@@ -637,26 +1936,213 @@ static bool pmemstream_acquire_processing_timestamp(struct pmemstream_async_wait
 	return true;
 }
 
-static bool pmemstream_process_async_ops(struct pmemstream_async_wait_data *data)
+/* Range of a stream which is yet to be flushed. Persists of spans placed contiguously in a region are combined. */
+struct pmemstream_flush_range {
+	const uint8_t *begin;
+	const uint8_t *end;
+};
+
+static void pmemstream_flush_range_flush(struct pmemstream *stream, struct pmemstream_flush_range *range)
+{
+	if (range->begin != range->end) {
+		stream->data.flush(range->begin, (size_t)(range->end - range->begin));
+	}
+	range->begin = range->end = NULL;
+}
+
+static void pmemstream_flush_range_add(struct pmemstream *stream, struct pmemstream_flush_range *range,
+				       const uint8_t *begin, size_t size)
+{
+	/* New range may overlap with the previous one (previous range covers next entry metadata). */
+	if (range->begin != range->end && begin >= range->begin && begin <= range->end) {
+		if (begin + size > range->end) {
+			range->end = begin + size;
+		}
+		return;
+	}
+
+	pmemstream_flush_range_flush(stream, range);
+	range->begin = begin;
+	range->end = begin + size;
+}
+
+/* Adds the whole batch (starting with 'timestamp') to the flush range. Data of entries copied with non-temporal
+ * stores is skipped - only metadata of such entries is flushed. */
+static void pmemstream_flush_range_add_batch(struct pmemstream *stream, struct pmemstream_flush_range *range,
+					     uint64_t timestamp)
+{
+	struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+	const uint8_t *begin = (const uint8_t *)pmemstream_offset_to_ptr(&stream->data, async_op->entry.offset);
+	const uint8_t *end = begin + async_op->batch_size;
+
+	for (uint64_t i = 0; i < async_op->batch_count; i++) {
+		struct async_operation *batch_op = pmemstream_async_operation(stream, timestamp + i);
+		if (!batch_op->data_persisted) {
+			continue;
+		}
+
+		const uint8_t *entry = (const uint8_t *)pmemstream_offset_to_ptr(&stream->data, batch_op->entry.offset);
+		size_t header_size = span_entry_header_size((const struct span_base *)entry);
+		pmemstream_flush_range_add(stream, range, begin, (size_t)(entry - begin) + header_size);
+		begin = entry + batch_op->size;
+	}
+
+	if (begin < end) {
+		pmemstream_flush_range_add(stream, range, begin, (size_t)(end - begin));
+	}
+}
+
+/* Stores checksums of all entries of the batch starting with 'timestamp' (only entries of regions with entry
+ * checksums have them). It's done on commit, when data of all entries is already copied.
+ * Returns true if all entries of the batch have checksums. */
+static bool pmemstream_store_batch_checksums(struct pmemstream *stream, uint64_t timestamp)
+{
+	struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+	bool checksummed = true;
+	for (uint64_t i = 0; i < async_op->batch_count; i++) {
+		struct async_operation *batch_op = pmemstream_async_operation(stream, timestamp + i);
+		struct span_checksummed_entry *entry = (struct span_checksummed_entry *)pmemstream_offset_to_ptr(
+			&stream->data, batch_op->entry.offset);
+		if (!span_entry_has_checksum(&entry->span_base)) {
+			checksummed = false;
+			continue;
+		}
+		entry->checksum = span_checksummed_entry_checksum(entry);
+	}
+	return checksummed;
+}
+
+/* Returns true if operation with 'timestamp' is published (or it was leased, but not handed out). */
+static bool pmemstream_async_operation_published(struct pmemstream *stream, uint64_t timestamp)
+{
+	return __atomic_load_n(&pmemstream_async_operation(stream, timestamp)->timestamp, __ATOMIC_ACQUIRE) ==
+		       timestamp ||
+	       pmemstream_timestamp_leases_revoke(stream, timestamp);
+}
+
+/* Returns true if operation with 'timestamp' is published and data of its whole batch is copied.
+ * Must be called only by the thread which processes 'timestamp'. */
+static bool pmemstream_async_operation_ready(struct pmemstream *stream, uint64_t timestamp)
+{
+	if (!pmemstream_async_operation_published(stream, timestamp)) {
+		return false;
+	}
+
+	struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+
+	/* Operations within a batch (except the first one) are already persisted along with the first operation,
+	 * which has to be committed before them. Their futures are polled only while processing the first one. */
+	for (uint64_t i = 0; i < async_op->batch_count; i++) {
+		struct async_operation *batch_op = pmemstream_async_operation(stream, timestamp + i);
+		if (pmemstream_async_operation_poll(batch_op) != FUTURE_STATE_COMPLETE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Processes the next operation, if it's ready. 'checksummed' is cleared if the operation has entries without
+ * checksums (or if metadata of spans preceding them had to be flushed). */
+static bool pmemstream_process_async_op(struct pmemstream_async_wait_data *data, struct pmemstream_flush_range *range,
+					bool *checksummed)
 {
 	assert(data->processing_timestamp < data->timestamp);
 	assert(data->processing_timestamp < data->last_timestamp);
 
-	struct async_operation *async_op = pmemstream_async_operation(data->stream, data->processing_timestamp + 1);
+	uint64_t timestamp = data->processing_timestamp + 1;
+	if (!pmemstream_async_operation_ready(data->stream, timestamp)) {
+		return false;
+	}
+
+	struct async_operation *async_op = pmemstream_async_operation(data->stream, timestamp);
+	if (async_op->batch_count != 0) {
+		/* In multi-writer regions, metadata of spans preceding the batch (entries reserved before it, which
+		 * might be not committed yet) is persisted by the same drain as the batch. It's not protected by
+		 * checksums, so it must be persistent before the persisted timestamp is stored. */
+		bool spans_flushed = false;
+		if (region_runtime_is_multi_writer(async_op->region_runtime) &&
+		    !region_runtime_flush_spans(async_op->region_runtime, async_op->entry.offset, &spans_flushed)) {
+			return false;
+		}
 
-	if (__atomic_load_n(&async_op->timestamp, __ATOMIC_ACQUIRE) == data->processing_timestamp + 1 &&
-	    future_poll(FUTURE_AS_RUNNABLE(&async_op->future), NULL) == FUTURE_STATE_COMPLETE) {
-		/* XXX: we can combine multiple persist into one. */
-		const uint8_t *destination =
-			(const uint8_t *)pmemstream_offset_to_ptr(&data->stream->data, async_op->entry.offset);
-		data->stream->data.persist(destination, async_op->size + sizeof(struct span_entry));
+		*checksummed =
+			pmemstream_store_batch_checksums(data->stream, timestamp) && !spans_flushed && *checksummed;
+		pmemstream_flush_range_add_batch(data->stream, range, timestamp);
+	}
 
-		++data->processing_timestamp;
+	++data->processing_timestamp;
 
-		return true;
+	return true;
+}
+
+/* Records that metadata of all spans preceding batches of operations (first_timestamp, last_timestamp] (and metadata
+ * of those batches) is persistent, for batches placed in multi-writer regions. */
+static void pmemstream_set_spans_persistent(struct pmemstream *stream, uint64_t first_timestamp,
+					    uint64_t last_timestamp)
+{
+	for (uint64_t timestamp = first_timestamp + 1; timestamp <= last_timestamp; timestamp++) {
+		struct async_operation *async_op = pmemstream_async_operation(stream, timestamp);
+		if (async_op->batch_count != 0 && region_runtime_is_multi_writer(async_op->region_runtime)) {
+			region_runtime_set_spans_persistent(async_op->region_runtime,
+							    async_op->entry.offset + async_op->batch_size);
+		}
 	}
+}
 
-	return false;
+/* Processes all (consecutive) operations which are ready. Data of all processed operations is flushed
+ * (with flushes of contiguous spans combined) and followed by a single drain.
+ *
+ * If all processed entries have checksums and all preceding timestamps are already committed, the processed
+ * timestamps are persisted by the same drain: persisted timestamp is stored before the entries are durable, but
+ * recovery detects entries which were not written completely using their checksums. Space following the entries
+ * (and their padding) is already zeroed and persisted (see region_runtime_reserve), so recovery can't find any stale
+ * entry after them.
+ * Returns false if no operation could be processed. */
+static bool pmemstream_process_async_ops(struct pmemstream_async_wait_data *data)
+{
+	struct pmemstream *stream = data->stream;
+	struct pmemstream_flush_range range = {.begin = NULL, .end = NULL};
+
+	uint64_t first_processing_timestamp = data->processing_timestamp;
+	bool checksummed = true;
+	while (data->processing_timestamp < data->last_timestamp &&
+	       pmemstream_process_async_op(data, &range, &checksummed))
+		;
+
+	if (data->processing_timestamp == first_processing_timestamp) {
+		return false;
+	}
+
+	bool flush_pending = range.begin != range.end;
+	pmemstream_flush_range_flush(stream, &range);
+
+	bool preceding_committed =
+		__atomic_load_n(&stream->committed_timestamp, __ATOMIC_ACQUIRE) == data->first_timestamp;
+	if (checksummed && flush_pending && preceding_committed) {
+		uint64_t *lane_timestamp = pmemstream_store_persisted_timestamp(stream, data->processing_timestamp);
+		stream->data.flush(lane_timestamp, sizeof(uint64_t));
+		stream->data.drain();
+
+		/* Persisted timestamp can't exceed the committed one - it's increased once processed timestamps are
+		 * committed (see pmemstream_increase_committed_timestamp). */
+		uint64_t persisted_on_commit_timestamp =
+			__atomic_load_n(&stream->persisted_on_commit_timestamp, __ATOMIC_RELAXED);
+		uint64_t processed_timestamp = data->processing_timestamp;
+		while (persisted_on_commit_timestamp < processed_timestamp) {
+			const bool weak = true;
+			if (__atomic_compare_exchange_n(&stream->persisted_on_commit_timestamp,
+							&persisted_on_commit_timestamp, processed_timestamp, weak,
+							__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+				break;
+		}
+	} else if (flush_pending) {
+		stream->data.drain();
+	}
+
+	pmemstream_set_spans_persistent(stream, first_processing_timestamp, data->processing_timestamp);
+
+	return true;
 }
 
 static void pmemstream_increase_committed_timestamp(struct pmemstream_async_wait_data *data)
@@ -673,21 +2159,83 @@ static void pmemstream_increase_committed_timestamp(struct pmemstream_async_wait
 	}
 #endif
 
+	/* This also releases async_ops slots of all committed timestamps (see pmemstream_acquire_timestamps). */
 	__atomic_fetch_add(&data->stream->committed_timestamp, num_committed_timestamps, __ATOMIC_RELEASE);
-
-	for (uint64_t i = 0; i < num_committed_timestamps; i++) {
-		sem_post(&data->stream->async_ops_semaphore);
+	pmemstream_event_notify(&data->stream->commit_event);
+	if (data->stream->background_persist) {
+		/* Background thread persists timestamps committed by others. */
+		pmemstream_event_notify(&data->stream->publish_event);
 	}
 
 	data->first_timestamp += num_committed_timestamps;
 
+	uint64_t persisted_on_commit_timestamp =
+		__atomic_load_n(&data->stream->persisted_on_commit_timestamp, __ATOMIC_ACQUIRE);
+	if (persisted_on_commit_timestamp >= data->first_timestamp) {
+		pmemstream_increase_persisted_timestamp(data->stream, data->first_timestamp);
+	}
+
 	assert(__atomic_load_n(&data->stream->committed_timestamp, __ATOMIC_RELAXED) >= data->processing_timestamp);
 }
 
+/* Processes operations acquired by 'data' once, without waiting for copies of their data. Processed operations are
+ * committed (all preceding ones must be committed already) and the remaining ones are released, so that any thread
+ * can take them over. */
+static void pmemstream_process_once(struct pmemstream_async_wait_data *data)
+{
+	assert(__atomic_load_n(&data->stream->committed_timestamp, __ATOMIC_RELAXED) == data->first_timestamp);
+
+	if (pmemstream_process_async_ops(data)) {
+		pmemstream_increase_committed_timestamp(data);
+	}
+
+	if (data->processing_timestamp < data->last_timestamp) {
+		__atomic_store_n(&data->stream->released_timestamp, data->last_timestamp, __ATOMIC_RELEASE);
+		pmemstream_event_notify(&data->stream->commit_event);
+	}
+}
+
+/* Takes over operations released by pmemstream_process_once (if there are any) and processes them once.
+ * Returns false if there were no such operations. */
+static bool pmemstream_process_released(struct pmemstream *stream)
+{
+	uint64_t released_timestamp = __atomic_load_n(&stream->released_timestamp, __ATOMIC_RELAXED);
+	if (released_timestamp == PMEMSTREAM_INVALID_TIMESTAMP) {
+		return false;
+	}
+
+	const bool weak = false;
+	if (!__atomic_compare_exchange_n(&stream->released_timestamp, &released_timestamp,
+					 PMEMSTREAM_INVALID_TIMESTAMP, weak, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	/* Released operations always follow the committed ones - no other thread can commit until they are. */
+	struct pmemstream_async_wait_data data;
+	data.stream = stream;
+	data.timestamp = released_timestamp;
+	data.first_timestamp = __atomic_load_n(&stream->committed_timestamp, __ATOMIC_ACQUIRE);
+	data.processing_timestamp = data.first_timestamp;
+	data.last_timestamp = released_timestamp;
+	pmemstream_process_once(&data);
+
+	return true;
+}
+
+/* Tells the poller that the future can't make progress until 'address' changes. All such changes are followed by
+ * a stream event (see pmemstream_notifier_event). */
+static void pmemstream_notifier_set_poller(struct future_notifier *notifier, uint64_t *address)
+{
+	if (notifier != NULL) {
+		notifier->notifier_used = FUTURE_NOTIFIER_POLLER;
+		notifier->poller.ptr_to_monitor = address;
+	}
+}
+
 static enum future_state pmemstream_async_wait_committed_impl(struct future_context *ctx,
 							      struct future_notifier *notifier)
 {
-	/* XXX: properly use/fix notifier. We can probably use the same as the async_op which we are polling. */
+	/* Notifier is left unused if the future made progress or waits for a data copy (vdm future). */
 	if (notifier != NULL) {
 		notifier->notifier_used = FUTURE_NOTIFIER_NONE;
 	}
@@ -704,6 +2252,10 @@ static enum future_state pmemstream_async_wait_committed_impl(struct future_cont
 	/* first poll */
 	if (data->last_timestamp == PMEMSTREAM_INVALID_TIMESTAMP) {
 		if (!pmemstream_acquire_processing_timestamp(data)) {
+			/* Other thread processes this timestamp (unless it was released). */
+			if (!pmemstream_process_released(data->stream)) {
+				pmemstream_notifier_set_poller(notifier, &data->stream->committed_timestamp);
+			}
 			return FUTURE_STATE_RUNNING;
 		}
 	}
@@ -711,12 +2263,21 @@ static enum future_state pmemstream_async_wait_committed_impl(struct future_cont
 	assert(data->last_timestamp != PMEMSTREAM_INVALID_TIMESTAMP);
 	if (data->processing_timestamp < data->last_timestamp) {
 		if (!pmemstream_process_async_ops(data)) {
+			uint64_t timestamp = data->processing_timestamp + 1;
+			struct async_operation *async_op = pmemstream_async_operation(data->stream, timestamp);
+			if (__atomic_load_n(&async_op->timestamp, __ATOMIC_ACQUIRE) != timestamp) {
+				/* Operation is not published yet. */
+				pmemstream_notifier_set_poller(notifier, &async_op->timestamp);
+			}
 			return FUTURE_STATE_RUNNING;
 		}
 	}
 
 	if (committed_timestamp == data->first_timestamp) {
 		pmemstream_increase_committed_timestamp(data);
+	} else if (!pmemstream_process_released(data->stream) && data->processing_timestamp == data->last_timestamp) {
+		/* Earlier timestamps are committed by other thread. */
+		pmemstream_notifier_set_poller(notifier, &data->stream->committed_timestamp);
 	}
 
 	return FUTURE_STATE_RUNNING;
@@ -725,7 +2286,6 @@ static enum future_state pmemstream_async_wait_committed_impl(struct future_cont
 static enum future_state pmemstream_async_wait_persisted_impl(struct future_context *ctx,
 							      struct future_notifier *notifier)
 {
-	/* XXX: properly use/fix notifier. We can probably use the same as the async_op which we are polling. */
 	if (notifier != NULL) {
 		notifier->notifier_used = FUTURE_NOTIFIER_NONE;
 	}
@@ -742,28 +2302,18 @@ static enum future_state pmemstream_async_wait_persisted_impl(struct future_cont
 
 	/* Resume from previous state. */
 	future.data = *data;
-	bool completed = future_poll(FUTURE_AS_RUNNABLE(&future), NULL) == FUTURE_STATE_COMPLETE;
+	bool completed = future_poll(FUTURE_AS_RUNNABLE(&future), notifier) == FUTURE_STATE_COMPLETE;
 	*data = future.data;
 
 	if (!completed) {
 		return FUTURE_STATE_RUNNING;
 	}
 
-	bool weak = false;
-	bool success = __atomic_compare_exchange_n(&data->stream->header->persisted_timestamp, &persisted_timestamp,
-						   data->timestamp, weak, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
-	if (success) {
-		data->stream->data.persist(&data->stream->header->persisted_timestamp, sizeof(uint64_t));
-		return FUTURE_STATE_COMPLETE;
-	}
+	pmemstream_persist_timestamp(data->stream, data->timestamp);
 
-	return FUTURE_STATE_RUNNING;
+	return FUTURE_STATE_COMPLETE;
 }
 
-/* XXX: possible extra variants
- * - pmemstream_wait_committed/persisted (blocking)
- * - pmemstream_process_committed/persisted (process as many committed/persisted ops as possible without blocking)
- */
 struct pmemstream_async_wait_fut pmemstream_async_wait_committed(struct pmemstream *stream, uint64_t timestamp)
 {
 	struct pmemstream_async_wait_fut future;
@@ -791,3 +2341,116 @@ struct pmemstream_async_wait_fut pmemstream_async_wait_persisted(struct pmemstre
 
 	return future;
 }
+
+uint64_t pmemstream_process_committed(struct pmemstream *stream)
+{
+	if (!stream) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	/* Processing timestamp can be acquired only if no other thread processes operations: otherwise committing would
+	 * have to wait for that thread. Operations released by a previous call are taken over, though. */
+	uint64_t committed_timestamp = __atomic_load_n(&stream->committed_timestamp, __ATOMIC_ACQUIRE);
+	uint64_t processing_timestamp = __atomic_load_n(&stream->processing_timestamp, __ATOMIC_ACQUIRE);
+	if (committed_timestamp != processing_timestamp) {
+		pmemstream_process_released(stream);
+		return pmemstream_committed_timestamp(stream);
+	}
+
+	/* Find all consecutive operations which are published. Futures of operations can be polled only after acquiring
+	 * processing timestamp, so copies of their data might be still in progress. Leases are not revoked here
+	 * (unlike in pmemstream_async_operation_published) - it would revoke all of them on each call. Timestamps held
+	 * by leases are published when handed out, given up or revoked by a thread waiting for them. */
+	uint64_t acquired_timestamp = __atomic_load_n(&stream->next_timestamp, __ATOMIC_ACQUIRE) - 1;
+	uint64_t last_timestamp = processing_timestamp;
+	while (last_timestamp < acquired_timestamp &&
+	       __atomic_load_n(&pmemstream_async_operation(stream, last_timestamp + 1)->timestamp, __ATOMIC_ACQUIRE) ==
+		       last_timestamp + 1) {
+		++last_timestamp;
+	}
+
+	if (last_timestamp == processing_timestamp) {
+		return committed_timestamp;
+	}
+
+	const bool weak = false;
+	if (!__atomic_compare_exchange_n(&stream->processing_timestamp, &processing_timestamp, last_timestamp, weak,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return pmemstream_committed_timestamp(stream);
+	}
+
+	struct pmemstream_async_wait_data data;
+	data.stream = stream;
+	data.timestamp = last_timestamp;
+	data.first_timestamp = processing_timestamp;
+	data.processing_timestamp = processing_timestamp;
+	data.last_timestamp = last_timestamp;
+
+	/* Operations which are not copied yet are released, instead of waiting for them. */
+	pmemstream_process_once(&data);
+
+	return data.processing_timestamp;
+}
+
+uint64_t pmemstream_process_persisted(struct pmemstream *stream)
+{
+	if (!stream) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	/* Data of all committed entries is already flushed (see pmemstream_process_async_ops). */
+	uint64_t committed_timestamp = pmemstream_process_committed(stream);
+	if (pmemstream_persisted_timestamp(stream) < committed_timestamp) {
+		pmemstream_persist_timestamp(stream, committed_timestamp);
+	}
+
+	return pmemstream_persisted_timestamp(stream);
+}
+
+/* Timestamps which were never acquired can't be waited for (it would block forever). */
+static int pmemstream_validate_wait(struct pmemstream *stream, uint64_t timestamp)
+{
+	if (!stream) {
+		return -1;
+	}
+	if (timestamp >= __atomic_load_n(&stream->next_timestamp, __ATOMIC_ACQUIRE)) {
+		return -1;
+	}
+	return 0;
+}
+
+int pmemstream_wait_committed(struct pmemstream *stream, uint64_t timestamp)
+{
+	int ret = pmemstream_validate_wait(stream, timestamp);
+	if (ret) {
+		return ret;
+	}
+
+	if (stream->background_persist) {
+		pmemstream_background_wait(stream, &stream->committed_timestamp, timestamp);
+		return 0;
+	}
+
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_committed(stream, timestamp);
+	pmemstream_future_wait(stream, FUTURE_AS_RUNNABLE(&future));
+
+	return future.output.error_code;
+}
+
+int pmemstream_wait_persisted(struct pmemstream *stream, uint64_t timestamp)
+{
+	int ret = pmemstream_validate_wait(stream, timestamp);
+	if (ret) {
+		return ret;
+	}
+
+	if (stream->background_persist) {
+		pmemstream_background_wait(stream, &stream->persisted_timestamp, timestamp);
+		return 0;
+	}
+
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(stream, timestamp);
+	pmemstream_future_wait(stream, FUTURE_AS_RUNNABLE(&future));
+
+	return future.output.error_code;
+}
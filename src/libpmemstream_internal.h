@@ -7,10 +7,11 @@
 #define LIBPMEMSTREAM_INTERNAL_H
 
 #include <assert.h>
-#include <semaphore.h>
+#include <pthread.h>
 
 #include <libminiasync.h>
 
+#include "config.h"
 #include "iterator.h"
 #include "libpmemstream.h"
 #include "pmemstream_runtime.h"
@@ -23,7 +24,14 @@ extern "C" {
 #endif
 
 #define PMEMSTREAM_SIGNATURE ("PMEMSTREAM")
-#define PMEMSTREAM_SIGNATURE_SIZE (64)
+#define PMEMSTREAM_SIGNATURE_SIZE (56)
+
+/* Version of the persistent layout (stream header and spans). It has to be bumped on each incompatible change -
+ * streams with a different layout version are rejected by pmemstream_from_map instead of being misinterpreted.
+ * Streams created before the version was introduced have it set to 0 (it's stored in what used to be zeroed tail
+ * of the signature). Version 1 introduced persisted timestamp lanes, span_region flags, chaining and timestamp base,
+ * and compact, checksummed and compressed entries. */
+#define PMEMSTREAM_LAYOUT_VERSION (1ULL)
 
 /* In some cases we relay on incrementing timestamp by 1.
  * Because of that we require FIRST timestamp to be exactly "1 away" from INVALID. */
@@ -31,22 +39,43 @@ extern "C" {
 #define PMEMSTREAM_FIRST_TIMESTAMP (PMEMSTREAM_INVALID_TIMESTAMP + 1ULL)
 static_assert(PMEMSTREAM_INVALID_TIMESTAMP + 1 == PMEMSTREAM_FIRST_TIMESTAMP, "wrong timestamp's macros values");
 
-/* XXX: make this a parameter */
-/* It has to be power of two */
-#define PMEMSTREAM_MAX_CONCURRENCY 1024ULL
+/* Number of persisted timestamps (lanes) stored in the stream header. */
+#define PMEMSTREAM_PERSISTED_TIMESTAMP_LANES 8
+
+/* Number of lanes leasing timestamps (see pmemstream_config_set_timestamp_lease_size). */
+#define PMEMSTREAM_TIMESTAMP_LEASE_LANES 64
+
+/* All flags which can be passed to pmemstream_region_allocate_with_flags. */
+#define PMEMSTREAM_REGION_VALID_FLAGS                                                                                  \
+	(PMEMSTREAM_REGION_MULTI_WRITER | PMEMSTREAM_REGION_ENTRY_ALIGN_64 | PMEMSTREAM_REGION_ENTRY_ALIGN_256 |       \
+	 PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_PERSISTENT_INDEX |  \
+	 PMEMSTREAM_REGION_CODEC(PMEMSTREAM_MAX_CODECS - 1))
+
+/* Persisted timestamp, updated by a subset of threads. Placed in a separate cacheline. */
+struct pmemstream_persisted_timestamp_lane {
+	alignas(CACHELINE_SIZE) uint64_t timestamp;
+};
 
 struct pmemstream_header {
 	char signature[PMEMSTREAM_SIGNATURE_SIZE];
+	uint64_t layout_version;
 	uint64_t stream_size;
 	uint64_t block_size;
 
-	/* XXX: investigate if it makes sense to store 'shadow' value in DRAM (for reads) */
-	/* XXX: we can 'distribute' persisted_timestamp and store multiple variables (one per thread) to speed up writes
-	 */
-	/* All entries with timestamps less than or equal to 'persisted_timestamp' can be treated as persisted. */
-	uint64_t persisted_timestamp;
-
 	struct allocator_header region_allocator_header;
+
+	/* All entries with timestamps less than or equal to the biggest of 'persisted_timestamps' can be treated as
+	 * persisted. Each thread updates timestamp in its own lane, so that concurrent persisters do not write back
+	 * the same cacheline. */
+	struct pmemstream_persisted_timestamp_lane persisted_timestamps[PMEMSTREAM_PERSISTED_TIMESTAMP_LANES];
+};
+
+/* Describes data segments which are yet to be copied by an async operation (used by vectored appends). */
+struct async_operation_segments {
+	struct vdm *vdm;
+	const struct iovec *iov;
+	size_t iovcnt;
+	uint8_t *destination;
 };
 
 /* Description of an async operation. */
@@ -54,10 +83,41 @@ struct async_operation {
 	/* Data memcpy future */
 	struct vdm_operation_future future;
 
+	/* Copy of next segment is started after the current 'future' completes. */
+	struct async_operation_segments segments;
+
 	/* Description of append operation. */
 	uint64_t timestamp;
+	struct pmemstream_region_runtime *region_runtime;
 	struct pmemstream_entry entry;
+	/* Total (span aligned) size of the entry. */
 	uint64_t size;
+
+	/* Entry data was copied with non-temporal stores - it's durable after a drain and does not need a flush. */
+	bool data_persisted;
+
+	/* Number of operations (starting with this one) which are committed together. Entries of such a batch are
+	 * placed contiguously in a region, so the first operation describes the whole batch and persists it at once.
+	 * All following operations within a batch have batch_count set to 0. */
+	uint64_t batch_count;
+
+	/* Size of the whole batch: all entries, along with cleared metadata of the next entry, if any (set only for
+	 * the first operation of a batch). */
+	uint64_t batch_size;
+};
+
+/* Threads sleep (futex) on 'value', which is incremented on each event, if anyone waits for it. */
+struct pmemstream_event {
+	uint32_t value;
+	/* Number of threads which (are about to) sleep on 'value'. */
+	uint32_t waiters;
+};
+
+/* Block of timestamps leased by a lane. Leased blocks are aligned to the lease size, so the end of a block is
+ * known from 'next' alone - lease is exhausted (or revoked) if 'next' is a multiple of the lease size. */
+struct timestamp_lease {
+	/* Next timestamp to be handed out. */
+	alignas(CACHELINE_SIZE) uint64_t next;
 };
 
 struct pmemstream {
@@ -82,16 +142,74 @@ struct pmemstream {
 	/* This timestamp is used to synchronize commits. */
 	alignas(CACHELINE_SIZE) uint64_t processing_timestamp;
 
-	/* Stores in-progress operations, indexed by timestamp mod array size. */
+	/* Operations (committed_timestamp, released_timestamp] are acquired for processing, but no thread processes
+	 * them: pmemstream_process_committed gave them up instead of waiting for copies of their data. Any thread can
+	 * take them over (see pmemstream_process_released). PMEMSTREAM_INVALID_TIMESTAMP if there are none. */
+	uint64_t released_timestamp;
+
+	/* Threads which can't make progress sleep until an operation is published (publish_event) or timestamps are
+	 * committed or persisted (commit_event), see pmemstream_event_wait. */
+	alignas(CACHELINE_SIZE) struct pmemstream_event publish_event;
+	alignas(CACHELINE_SIZE) struct pmemstream_event commit_event;
+
+	/* Set to 1 by a thread which performs group commit on behalf of all synchronous appenders. */
+	alignas(CACHELINE_SIZE) uint64_t group_commit_leader;
+
+	/* DRAM shadow of the persisted timestamp (header's persisted_timestamps). It is increased only after the
+	 * persisted timestamp is durable, so reads do not need to flush anything. */
+	alignas(CACHELINE_SIZE) uint64_t persisted_timestamp;
+
+	/* The biggest timestamp which was made durable together with its entries, before being committed (see
+	 * pmemstream_process_async_ops). Persisted timestamp is increased up to it once it's committed. */
+	uint64_t persisted_on_commit_timestamp;
+
+	/* Stores in-progress operations, indexed by timestamp mod array size (max_concurrency). */
 	struct async_operation *async_ops;
 
+	/* Number of async_ops (power of 2) and a mask used for indexing them. */
+	size_t max_concurrency;
+	uint64_t async_ops_mask;
+
+	/* Lanes leasing timestamps (NULL if leasing is disabled) and number of timestamps in a single lease. */
+	struct timestamp_lease *timestamp_leases;
+	size_t timestamp_lease_size;
+
+	/* Data of entries of at least this size is copied (by synchronous appends) with non-temporal stores. */
+	size_t nontemporal_copy_threshold;
+
+	/* Codecs registered in the stream's config (see pmemstream_config_set_codec). */
+	struct pmemstream_codec codecs[PMEMSTREAM_MAX_CODECS];
+
+	/* Thread which commits and persists all published operations, if background_persist is set. */
+	bool background_persist;
+	bool background_persist_stop;
+	pthread_t background_persist_thread;
+
 	/* Used to perform synchronous memcpy. */
 	struct data_mover_sync *data_mover_sync;
-
-	/* Protects against exceeding PMEMSTREAM_MAX_CONCURRENCY. */
-	sem_t async_ops_semaphore;
+	/* Cached vdm of data_mover_sync - copies requested with it are performed by the stream itself. */
+	struct vdm *data_mover_sync_vdm;
 };
 
+/* Works as pmemstream_region_allocate_with_flags, but the new region records (persistently, along with its flags)
+ * that it's to be linked after 'prev_chained_region' in a region chain - so that the link can be completed after a
+ * crash (see pmemstream_region_chain_new). */
+int pmemstream_region_allocate_chained(struct pmemstream *stream, size_t size, uint64_t flags,
+				       struct pmemstream_region prev_chained_region, struct pmemstream_region *region);
+
+/* Checks if an entry of 'size' bytes can't be appended to the region, because there is not enough space left in it
+ * (or, in regions with compact entries, because timestamps of new entries no longer fit in its delta range). */
+bool pmemstream_region_is_full(struct pmemstream *stream, struct pmemstream_region region,
+			       const struct pmemstream_region_runtime *region_runtime, size_t size);
+
+/* Appends 'count' entries of the given 'sizes', staged in DRAM with exactly the same layout as they have in the
+ * region (each entry's data is preceded by space for its span_entry). Entries are published as a single batch
+ * (not waiting for commit) and 'last_timestamp' is set to the timestamp of the last one.
+ * Returns -1 if 'count' is 0 or there is not enough space in the region. */
+int pmemstream_append_staged_batch(struct pmemstream *stream, struct pmemstream_region region,
+				   struct pmemstream_region_runtime *region_runtime, const uint8_t *staged,
+				   const size_t *sizes, size_t count, uint64_t *last_timestamp);
+
 static inline int pmemstream_validate_stream_and_offset(struct pmemstream *stream, uint64_t offset)
 {
 	if (!stream) {
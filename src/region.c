@@ -7,6 +7,19 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <string.h>
+
+/* In multi-writer regions (and regions with entry checksums), the part of a region ahead of the append offset is
+ * zeroed (and persisted) in chunks of this size. Zeroed memory guarantees that the span following the last claimed
+ * (or reserved) one is always empty. */
+#define REGION_RUNTIME_ZEROED_CHUNK_SIZE (64ULL * 1024)
+
+/* Every REGION_INDEX_INTERVAL-th entry of a region is sampled by the region index. Every
+ * REGION_PERSISTENT_INDEX_INTERVAL-th one (which must be a multiple of the former) is also recorded in the persistent
+ * index (in regions allocated with PMEMSTREAM_REGION_PERSISTENT_INDEX flag). */
+#define REGION_INDEX_INTERVAL 64
+#define REGION_PERSISTENT_INDEX_INTERVAL 256
+#define REGION_INDEX_INITIAL_CAPACITY 16
 
 /* After opening pmemstream, each region_runtime is in one of those 2 states.
  * The only possible state transition is: REGION_RUNTIME_STATE_READ_READY -> REGION_RUNTIME_STATE_WRITE_READY
@@ -16,6 +29,32 @@ enum region_runtime_state {
 	REGION_RUNTIME_STATE_WRITE_READY /* reading and writing to the region is safe */
 };
 
+/*
+ * Sampled index of entries of a region, used to seek by timestamp. It's built lazily, by seeks (and synchronous
+ * appends to regions with a persistent index), and covers all entries placed before end_offset. Samples have the
+ * same format as records of the persistent index: max_timestamp (the biggest timestamp of entries preceding the
+ * sampled one) never decreases along the region, even if timestamps of entries do.
+ */
+struct region_index {
+	struct span_region_index_record *samples;
+	size_t samples_count;
+	size_t samples_capacity;
+
+	/* Whether records of the persistent index were loaded (it's done on the first use of the index). */
+	bool loaded;
+	/* Number of samples already checked for being recorded in the persistent index. */
+	size_t persisted_samples;
+
+	/* Offset right past the last indexed entry. */
+	uint64_t end_offset;
+	/* Number of indexed entries and the biggest of their timestamps. */
+	uint64_t entries_count;
+	uint64_t max_timestamp;
+
+	/* Protects the whole index. */
+	pthread_mutex_t lock;
+};
+
 /*
  * It contains all runtime data specific to a region.
  * It is always managed by the pmemstream (user can only obtain a non-owning pointer) and can be created
@@ -39,13 +78,37 @@ struct pmemstream_region_runtime {
 	 */
 	struct pmemstream_region region;
 
+	/*
+	 * PMEMSTREAM_REGION_* flags of the underlying region (read-only copy of persistent value).
+	 */
+	uint64_t flags;
+
+	/*
+	 * Timestamp base of compact entries in the underlying region (read-only copy of persistent value).
+	 */
+	uint64_t timestamp_base;
+
 	/*
 	 * Offset at which new entries will be appended.
 	 */
 	uint64_t append_offset;
 
+	/*
+	 * All bytes between append_offset and zeroed_offset are known to be zeroed and persisted.
+	 * Only used in multi-writer regions, extended under region_lock.
+	 */
+	uint64_t zeroed_offset;
+
+	/*
+	 * Metadata of all spans placed before persistent_spans_offset is known to be persistent.
+	 * Only used in multi-writer regions (see region_runtime_flush_spans).
+	 */
+	uint64_t persistent_spans_offset;
+
 	/* Protects region initialization step. */
 	pthread_mutex_t region_lock;
+
+	struct region_index index;
 };
 
 /*
@@ -83,7 +146,9 @@ static int free_region_runtime_cb(uintptr_t key, void *value, void *privdata)
 
 	/* XXX: Handle error */
 	pthread_mutex_destroy(&region_runtime->region_lock);
+	pthread_mutex_destroy(&region_runtime->index.lock);
 
+	free(region_runtime->index.samples);
 	free(value);
 	return 0;
 }
@@ -105,16 +170,29 @@ static int region_runtimes_map_create_or_fail(struct region_runtimes_map *map, s
 		return -1;
 	}
 
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(map->data, region.offset);
+
 	runtime->data = map->data;
 	runtime->region = region;
 	runtime->state = REGION_RUNTIME_STATE_READ_READY;
+	runtime->flags = span_region->flags;
+	runtime->timestamp_base = span_region->timestamp_base;
 	runtime->append_offset = PMEMSTREAM_INVALID_OFFSET;
+	runtime->zeroed_offset = PMEMSTREAM_INVALID_OFFSET;
+	runtime->persistent_spans_offset = PMEMSTREAM_INVALID_OFFSET;
+	runtime->index.end_offset = region_first_entry_offset(region);
 
 	int ret = pthread_mutex_init(&runtime->region_lock, NULL);
 	if (ret) {
 		goto err_region_lock;
 	}
 
+	ret = pthread_mutex_init(&runtime->index.lock, NULL);
+	if (ret) {
+		goto err_index_lock;
+	}
+
 	ret = critnib_insert(map->container, region.offset, runtime, 0 /* no update */);
 	if (ret) {
 		goto err_critnib_insert;
@@ -124,6 +202,9 @@ static int region_runtimes_map_create_or_fail(struct region_runtimes_map *map, s
 	return ret;
 
 err_critnib_insert:
+	/* XXX: Handle error */
+	pthread_mutex_destroy(&runtime->index.lock);
+err_index_lock:
 	/* XXX: Handle error */
 	pthread_mutex_destroy(&runtime->region_lock);
 err_region_lock:
@@ -147,6 +228,12 @@ static int region_runtimes_map_create(struct region_runtimes_map *map, struct pm
 	return ret;
 }
 
+struct pmemstream_region_runtime *region_runtimes_map_find_containing(struct region_runtimes_map *map, uint64_t offset)
+{
+	/* Regions do not overlap, so the region with the biggest offset not exceeding 'offset' contains it. */
+	return critnib_find_le(map->container, offset);
+}
+
 int region_runtimes_map_get_or_create(struct region_runtimes_map *map, struct pmemstream_region region,
 				      struct pmemstream_region_runtime **container_handle)
 {
@@ -182,6 +269,9 @@ uint64_t region_runtime_get_append_offset_acquire(const struct pmemstream_region
 void region_runtimes_map_remove(struct region_runtimes_map *map, struct pmemstream_region region)
 {
 	struct pmemstream_region_runtime *runtime = critnib_remove(map->container, region.offset);
+	if (runtime) {
+		free(runtime->index.samples);
+	}
 	free(runtime);
 }
 
@@ -191,6 +281,488 @@ void region_runtime_increase_append_offset(struct pmemstream_region_runtime *reg
 	__atomic_fetch_add(&region_runtime->append_offset, diff, __ATOMIC_RELAXED);
 }
 
+bool region_runtime_is_multi_writer(const struct pmemstream_region_runtime *region_runtime)
+{
+	return (region_runtime->flags & PMEMSTREAM_REGION_MULTI_WRITER) != 0;
+}
+
+size_t region_entry_alignment(uint64_t flags)
+{
+	if (flags & PMEMSTREAM_REGION_ENTRY_ALIGN_64) {
+		return 64;
+	}
+	if (flags & PMEMSTREAM_REGION_ENTRY_ALIGN_256) {
+		return 256;
+	}
+	return sizeof(span_bytes);
+}
+
+size_t region_runtime_entry_alignment(const struct pmemstream_region_runtime *region_runtime)
+{
+	return region_entry_alignment(region_runtime->flags);
+}
+
+size_t region_entry_slot_size(size_t alignment, size_t entry_total_size)
+{
+	size_t slot_size = ALIGN_UP(entry_total_size, alignment);
+	/* Padding must have a non-zero size - empty span of zero size marks the end of data. */
+	if (slot_size - entry_total_size == sizeof(struct span_empty)) {
+		slot_size += alignment;
+	}
+	return slot_size;
+}
+
+bool region_has_compact_entries(uint64_t flags)
+{
+	return (flags & PMEMSTREAM_REGION_COMPACT_ENTRIES) != 0;
+}
+
+bool region_entry_size_fits(uint64_t flags, size_t size)
+{
+	return !region_has_compact_entries(flags) || size <= SPAN_COMPACT_ENTRY_MAX_SIZE;
+}
+
+bool region_has_entry_checksums(uint64_t flags)
+{
+	return (flags & PMEMSTREAM_REGION_ENTRY_CHECKSUMS) != 0;
+}
+
+unsigned region_codec(uint64_t flags)
+{
+	return (unsigned)((flags / PMEMSTREAM_REGION_CODEC(1)) & (PMEMSTREAM_MAX_CODECS - 1));
+}
+
+bool region_has_persistent_index(uint64_t flags)
+{
+	return (flags & PMEMSTREAM_REGION_PERSISTENT_INDEX) != 0;
+}
+
+/* Returns number of records which fit in the persistent index of a region. Entries might occupy the whole region,
+ * so there is a record for every REGION_PERSISTENT_INDEX_INTERVAL entries of the smallest size possible. */
+static size_t region_persistent_index_capacity(uint64_t flags, size_t region_total_size)
+{
+	size_t min_entry_size =
+		region_entry_slot_size(region_entry_alignment(flags), region_entry_total_size(flags, 0));
+	size_t min_interval_size = REGION_PERSISTENT_INDEX_INTERVAL * min_entry_size;
+	return (region_total_size - sizeof(struct span_region)) / min_interval_size + 1;
+}
+
+size_t region_persistent_index_size(uint64_t flags, size_t region_total_size)
+{
+	if (!region_has_persistent_index(flags)) {
+		return 0;
+	}
+
+	size_t capacity = region_persistent_index_capacity(flags, region_total_size);
+	return ALIGN_UP(sizeof(struct span_region_index) + capacity * sizeof(struct span_region_index_record),
+			CACHELINE_SIZE);
+}
+
+struct span_region_index *region_persistent_index(const struct pmemstream_runtime *data,
+						  struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	size_t total_size = span_get_total_size(&span_region->span_base);
+	size_t index_size = region_persistent_index_size(span_region->flags, total_size);
+	if (index_size == 0) {
+		return NULL;
+	}
+
+	return (struct span_region_index *)pmemstream_offset_to_ptr(data, region.offset + total_size - index_size);
+}
+
+size_t region_entry_header_size(uint64_t flags)
+{
+	if (region_has_compact_entries(flags)) {
+		return sizeof(struct span_compact_entry);
+	}
+	if (region_has_entry_checksums(flags)) {
+		return sizeof(struct span_checksummed_entry);
+	}
+	return region_codec(flags) != 0 ? sizeof(struct span_compressed_entry) : sizeof(struct span_entry);
+}
+
+struct span_base region_entry_span_base_create(uint64_t flags, size_t size)
+{
+	assert(!region_has_compact_entries(flags));
+	if (region_has_entry_checksums(flags)) {
+		return span_checksummed_entry_create(size);
+	}
+	return region_codec(flags) != 0 ? span_compressed_entry_create(size) : span_base_create(size, SPAN_ENTRY);
+}
+
+size_t region_entry_total_size(uint64_t flags, size_t size)
+{
+	assert(region_entry_size_fits(flags, size));
+	struct span_base span = region_has_compact_entries(flags) ? span_compact_entry_create(size, 0)
+								   : region_entry_span_base_create(flags, size);
+	return span_get_total_size(&span);
+}
+
+uint64_t region_runtime_get_flags(const struct pmemstream_region_runtime *region_runtime)
+{
+	return region_runtime->flags;
+}
+
+bool region_runtime_has_compact_entries(const struct pmemstream_region_runtime *region_runtime)
+{
+	return region_has_compact_entries(region_runtime->flags);
+}
+
+uint64_t region_runtime_get_timestamp_base(const struct pmemstream_region_runtime *region_runtime)
+{
+	return region_runtime->timestamp_base;
+}
+
+struct span_base region_runtime_compact_entry_create(const struct pmemstream_region_runtime *region_runtime,
+						     size_t size, uint64_t timestamp)
+{
+	assert(timestamp > region_runtime->timestamp_base);
+	assert(timestamp - region_runtime->timestamp_base <= SPAN_COMPACT_ENTRY_MAX_DELTA);
+	return span_compact_entry_create(size, timestamp - region_runtime->timestamp_base);
+}
+
+uint64_t region_runtime_entry_timestamp(const struct pmemstream_region_runtime *region_runtime,
+					const struct span_entry *span_entry)
+{
+	if (span_get_type(&span_entry->span_base) != SPAN_COMPACT_ENTRY) {
+		return span_entry->timestamp;
+	}
+
+	uint64_t timestamp_delta = span_compact_entry_get_timestamp_delta(&span_entry->span_base);
+	if (timestamp_delta == 0) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+	return region_runtime->timestamp_base + timestamp_delta;
+}
+
+static bool region_runtime_may_contain_padding(const struct pmemstream_region_runtime *region_runtime)
+{
+	return region_runtime_is_multi_writer(region_runtime) ||
+	       region_runtime_entry_alignment(region_runtime) != sizeof(span_bytes);
+}
+
+uint64_t region_end_offset(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	assert(span_get_type(&span_region->span_base) == SPAN_REGION);
+	size_t total_size = span_get_total_size(&span_region->span_base);
+	return region.offset + total_size - region_persistent_index_size(span_region->flags, total_size);
+}
+
+/* Returns true if the record of the persistent index describes an entry which (along with all entries preceding it)
+ * is valid: it's placed before 'end_offset' and its timestamp (and timestamps of entries preceding it) does not
+ * exceed 'max_timestamp'. Records are only written for committed entries, but entries which were not persisted
+ * might be lost (or turned into padding) after a crash. */
+static bool region_index_record_is_valid(const struct pmemstream_region_runtime *region_runtime,
+					 const struct span_region_index_record *record, uint64_t ordinal,
+					 uint64_t end_offset, uint64_t max_timestamp)
+{
+	if (record->ordinal != ordinal || record->offset < region_first_entry_offset(region_runtime->region) ||
+	    record->offset + sizeof(struct span_base) > end_offset || record->max_timestamp > max_timestamp) {
+		return false;
+	}
+
+	const struct span_entry *span_entry =
+		(const struct span_entry *)span_offset_to_span_ptr(region_runtime->data, record->offset);
+	enum span_type entry_type =
+		region_runtime_has_compact_entries(region_runtime) ? SPAN_COMPACT_ENTRY : SPAN_ENTRY;
+	if (span_get_type(&span_entry->span_base) != entry_type) {
+		return false;
+	}
+
+	uint64_t timestamp = region_runtime_entry_timestamp(region_runtime, span_entry);
+	return timestamp != PMEMSTREAM_INVALID_TIMESTAMP && timestamp <= max_timestamp;
+}
+
+/* Returns number of leading records of the persistent index which are valid (see region_index_record_is_valid).
+ * Once a record is invalid, all the following ones are invalid as well, so it's found by a binary search. */
+static size_t region_persistent_index_valid_records(const struct pmemstream_region_runtime *region_runtime,
+						    const struct span_region_index *persistent_index,
+						    uint64_t end_offset, uint64_t max_timestamp)
+{
+	const struct span_region *span_region = (const struct span_region *)span_offset_to_span_ptr(
+		region_runtime->data, region_runtime->region.offset);
+	size_t capacity =
+		region_persistent_index_capacity(region_runtime->flags, span_get_total_size(&span_region->span_base));
+
+	size_t begin = 0;
+	size_t end = persistent_index->records_count < capacity ? persistent_index->records_count : capacity;
+	while (begin < end) {
+		size_t mid = begin + (end - begin) / 2;
+		if (region_index_record_is_valid(region_runtime, &persistent_index->records[mid],
+						 mid * REGION_PERSISTENT_INDEX_INTERVAL, end_offset, max_timestamp)) {
+			begin = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+	return begin;
+}
+
+/* Drops records of the persistent index which describe entries lost in a crash (placed at or past 'tail_offset'),
+ * before new entries are appended in their place. */
+static void region_persistent_index_truncate(struct pmemstream_region_runtime *region_runtime, uint64_t tail_offset,
+					     uint64_t max_timestamp)
+{
+	struct span_region_index *persistent_index =
+		region_persistent_index(region_runtime->data, region_runtime->region);
+	if (!persistent_index) {
+		return;
+	}
+
+	size_t records_count =
+		region_persistent_index_valid_records(region_runtime, persistent_index, tail_offset, max_timestamp);
+	if (persistent_index->records_count != records_count) {
+		persistent_index->records_count = records_count;
+		region_runtime->data->persist(&persistent_index->records_count,
+					      sizeof(persistent_index->records_count));
+	}
+}
+
+/* Returns offset from which region recovery should start looking for the end of data: offset of the entry described
+ * by the last valid record of the persistent index (if there is any) - all entries preceding it are valid. */
+static uint64_t region_recovery_start_offset(const struct pmemstream_region_runtime *region_runtime)
+{
+	uint64_t first_entry_offset = region_first_entry_offset(region_runtime->region);
+	const struct span_region_index *persistent_index =
+		region_persistent_index(region_runtime->data, region_runtime->region);
+	if (!persistent_index) {
+		return first_entry_offset;
+	}
+
+	const struct span_region *span_region = (const struct span_region *)span_offset_to_span_ptr(
+		region_runtime->data, region_runtime->region.offset);
+	size_t records_count = region_persistent_index_valid_records(
+		region_runtime, persistent_index, region_end_offset(region_runtime->data, region_runtime->region),
+		span_region->max_valid_timestamp);
+	return records_count == 0 ? first_entry_offset : persistent_index->records[records_count - 1].offset;
+}
+
+/* Makes sure that all bytes up to 'offset' are zeroed and persisted. */
+static void region_runtime_extend_zeroed_locked(struct pmemstream_region_runtime *region_runtime, uint64_t offset)
+{
+	pthread_mutex_lock(&region_runtime->region_lock);
+
+	uint64_t zeroed_offset = __atomic_load_n(&region_runtime->zeroed_offset, __ATOMIC_RELAXED);
+	if (zeroed_offset < offset) {
+		uint64_t end_offset = region_end_offset(region_runtime->data, region_runtime->region);
+		uint64_t new_zeroed_offset = zeroed_offset + REGION_RUNTIME_ZEROED_CHUNK_SIZE;
+		if (new_zeroed_offset < offset) {
+			new_zeroed_offset = offset;
+		}
+		if (new_zeroed_offset > end_offset) {
+			new_zeroed_offset = end_offset;
+		}
+
+		uint8_t *dst = (uint8_t *)pmemstream_offset_to_ptr(region_runtime->data, zeroed_offset);
+		region_runtime->data->memset(dst, 0, new_zeroed_offset - zeroed_offset, PMEM2_F_MEM_NONTEMPORAL);
+
+		__atomic_store_n(&region_runtime->zeroed_offset, new_zeroed_offset, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&region_runtime->region_lock);
+}
+
+/*
+ * Lock-free reservation for multi-writer regions: space is reserved by a CAS on the append offset. Metadata of the
+ * reserved span is not stored here - the caller claims reserved entries (see pmemstream_reserve_entries). Until then,
+ * the reserved span looks like the end of data.
+ */
+static uint64_t region_runtime_reserve_multi_writer(struct pmemstream_region_runtime *region_runtime, size_t size)
+{
+	assert(size >= sizeof(struct span_entry) && size % sizeof(span_bytes) == 0);
+
+	uint64_t end_offset = region_end_offset(region_runtime->data, region_runtime->region);
+	uint64_t offset = __atomic_load_n(&region_runtime->append_offset, __ATOMIC_RELAXED);
+	while (true) {
+		if (offset + size > end_offset) {
+			return PMEMSTREAM_INVALID_OFFSET;
+		}
+
+		/* Metadata of the span following the reserved one must be zeroed as well. */
+		uint64_t required_offset = offset + size + sizeof(struct span_entry);
+		if (required_offset > end_offset) {
+			required_offset = end_offset;
+		}
+		if (__atomic_load_n(&region_runtime->zeroed_offset, __ATOMIC_ACQUIRE) < required_offset) {
+			region_runtime_extend_zeroed_locked(region_runtime, required_offset);
+		}
+
+		const bool weak = true;
+		if (__atomic_compare_exchange_n(&region_runtime->append_offset, &offset, offset + size, weak,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			return offset;
+		}
+	}
+}
+
+uint64_t region_runtime_reserve(struct pmemstream_region_runtime *region_runtime, size_t size)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+
+	if (region_runtime_is_multi_writer(region_runtime)) {
+		return region_runtime_reserve_multi_writer(region_runtime, size);
+	}
+
+	uint64_t offset = region_runtime_get_append_offset_acquire(region_runtime);
+	assert(offset >= region_first_entry_offset(region_runtime->region));
+	uint64_t end_offset = region_end_offset(region_runtime->data, region_runtime->region);
+	if (offset + size > end_offset) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	/* Entries with checksums are persisted by the same drain as the persisted timestamp, so clearing metadata of
+	 * the following span is not ordered before the timestamp is durable. If only the latter survived a crash,
+	 * recovery could find a stale entry (with a valid checksum and a timestamp reused after an earlier crash) right
+	 * after the tail. Space is zeroed and persisted in advance instead. */
+	if (region_has_entry_checksums(region_runtime_get_flags(region_runtime))) {
+		uint64_t required_offset = offset + size + sizeof(struct span_entry);
+		if (required_offset > end_offset) {
+			required_offset = end_offset;
+		}
+		if (__atomic_load_n(&region_runtime->zeroed_offset, __ATOMIC_ACQUIRE) < required_offset) {
+			region_runtime_extend_zeroed_locked(region_runtime, required_offset);
+		}
+	}
+
+	region_runtime_increase_append_offset(region_runtime, size);
+
+	return offset;
+}
+
+void region_runtime_seal(struct pmemstream_region_runtime *region_runtime)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+
+	if (!region_runtime_is_multi_writer(region_runtime)) {
+		return;
+	}
+
+	uint64_t end_offset = region_end_offset(region_runtime->data, region_runtime->region);
+	uint64_t offset = region_runtime_get_append_offset_acquire(region_runtime);
+	while (true) {
+		if (offset + sizeof(struct span_entry) > end_offset) {
+			/* No entry fits in the remaining space. */
+			return;
+		}
+
+		/* Fails if some other thread reserved space in the meantime. */
+		const bool weak = true;
+		if (__atomic_compare_exchange_n(&region_runtime->append_offset, &offset, end_offset, weak,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	struct span_base *padding = (struct span_base *)pmemstream_offset_to_ptr(region_runtime->data, offset);
+	size_t padding_size = end_offset - offset - sizeof(struct span_empty);
+	span_base_atomic_store(padding, span_base_create(padding_size, SPAN_EMPTY));
+	region_runtime->data->persist(padding, sizeof(*padding));
+}
+
+void region_runtime_cancel_reservation(struct pmemstream_region_runtime *region_runtime, uint64_t offset)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+
+	if (!region_runtime_is_multi_writer(region_runtime)) {
+		/* Only one reservation might be outstanding - it always ends at the append offset. */
+		__atomic_store_n(&region_runtime->append_offset, offset, __ATOMIC_RELEASE);
+		return;
+	}
+
+	/* Claim (which will never get a timestamp) would stop iterators until the region is recovered. */
+	struct span_base *claimed = (struct span_base *)pmemstream_offset_to_ptr(region_runtime->data, offset);
+	if (span_get_type(claimed) != SPAN_ENTRY) {
+		return;
+	}
+	size_t padding_size = span_get_total_size(claimed) - sizeof(struct span_empty);
+	span_base_atomic_store(claimed, span_base_create(padding_size, SPAN_EMPTY));
+	region_runtime->data->persist(claimed, sizeof(*claimed));
+}
+
+int region_runtime_shrink_reservation(struct pmemstream_region_runtime *region_runtime, uint64_t offset, size_t size)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+
+	if (!region_runtime_is_multi_writer(region_runtime)) {
+		/* Only one reservation might be outstanding - it always ends at the append offset. */
+		uint64_t append_offset = region_runtime_get_append_offset_relaxed(region_runtime);
+		if (offset + size > append_offset) {
+			region_runtime_cancel_reservation(region_runtime, offset);
+			return -1;
+		}
+		__atomic_store_n(&region_runtime->append_offset, offset + size, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	/* Span header at 'offset' still holds the claim of the reserved entry, which occupies the whole slot (along
+	 * with its padding). Other spans might have been reserved past it already, so the unused tail is turned into
+	 * a padding span instead. */
+	const struct span_base *claimed = span_offset_to_span_ptr(region_runtime->data, offset);
+	if (span_get_type(claimed) != SPAN_ENTRY) {
+		return -1;
+	}
+	size_t reserved_size =
+		region_entry_slot_size(region_runtime_entry_alignment(region_runtime), span_get_total_size(claimed));
+
+	/* Padding must have a non-zero size - empty span of zero size marks the end of data. */
+	if (size > reserved_size || (size < reserved_size && reserved_size - size <= sizeof(struct span_empty))) {
+		region_runtime_cancel_reservation(region_runtime, offset);
+		return -1;
+	}
+
+	if (size < reserved_size) {
+		/* Padding has to be persisted before entry metadata (with the actual size) is stored - metadata of the
+		 * claim might be persistent already (see region_runtime_flush_spans) and, after a crash, recovery would
+		 * not be able to walk past this entry. */
+		uint8_t *padding_dst = (uint8_t *)pmemstream_offset_to_ptr(region_runtime->data, offset + size);
+		struct span_base *padding = (struct span_base *)padding_dst;
+		size_t padding_size = reserved_size - size - sizeof(struct span_empty);
+		span_base_atomic_store(padding, span_base_create(padding_size, SPAN_EMPTY));
+		region_runtime->data->persist(padding, sizeof(*padding));
+	}
+
+	return 0;
+}
+
+bool region_runtime_flush_spans(struct pmemstream_region_runtime *region_runtime, uint64_t offset, bool *flushed)
+{
+	assert(region_runtime_is_multi_writer(region_runtime));
+
+	*flushed = false;
+	uint64_t span_offset = __atomic_load_n(&region_runtime->persistent_spans_offset, __ATOMIC_ACQUIRE);
+	while (span_offset < offset) {
+		const struct span_base *span_base = span_offset_to_span_ptr(region_runtime->data, span_offset);
+		struct span_base span = {.size_and_type = __atomic_load_n(&span_base->size_and_type, __ATOMIC_ACQUIRE)};
+		if (span_get_type(&span) == SPAN_EMPTY && span_get_size(&span) == 0) {
+			/* Space is already reserved, but entries placed in it are not claimed yet. */
+			return false;
+		}
+		region_runtime->data->flush(span_base, sizeof(*span_base));
+		*flushed = true;
+		span_offset += span_get_total_size(&span);
+	}
+
+	return true;
+}
+
+void region_runtime_set_spans_persistent(struct pmemstream_region_runtime *region_runtime, uint64_t offset)
+{
+	assert(region_runtime_is_multi_writer(region_runtime));
+
+	uint64_t persistent_spans_offset = __atomic_load_n(&region_runtime->persistent_spans_offset, __ATOMIC_RELAXED);
+	while (persistent_spans_offset < offset) {
+		const bool weak = true;
+		if (__atomic_compare_exchange_n(&region_runtime->persistent_spans_offset, &persistent_spans_offset,
+						offset, weak, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+}
+
 static void region_runtime_initialize_for_write_no_lock(struct pmemstream_region_runtime *region_runtime,
 							uint64_t tail_offset)
 {
@@ -201,11 +773,21 @@ static void region_runtime_initialize_for_write_no_lock(struct pmemstream_region
 
 	region_runtime->append_offset = tail_offset;
 
+	/* Region might be completely filled - do not touch the following one. */
+	uint64_t end_offset = region_end_offset(region_runtime->data, region_runtime->region);
+	size_t clear_size = sizeof(struct span_entry);
+	if (tail_offset + clear_size > end_offset) {
+		clear_size = end_offset - tail_offset;
+	}
+
 	uint8_t *next_entry_dst = (uint8_t *)pmemstream_offset_to_ptr(region_runtime->data, tail_offset);
-	region_runtime->data->memset(next_entry_dst, 0, sizeof(struct span_entry), 0);
+	region_runtime->data->memset(next_entry_dst, 0, clear_size, 0);
+	region_runtime->zeroed_offset = tail_offset + clear_size;
+	region_runtime->persistent_spans_offset = tail_offset;
 
 	struct span_region *span_region =
 		(struct span_region *)span_offset_to_span_ptr(region_runtime->data, region_runtime->region.offset);
+	region_persistent_index_truncate(region_runtime, tail_offset, span_region->max_valid_timestamp);
 	span_region->max_valid_timestamp = UINT64_MAX;
 	region_runtime->data->persist(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
 
@@ -232,6 +814,52 @@ uint64_t region_first_entry_offset(struct pmemstream_region region)
 	return region.offset + offsetof(struct span_region, data);
 }
 
+struct pmemstream_region region_next_chained(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	struct pmemstream_region next = {.offset = __atomic_load_n(&span_region->next_chained_region, __ATOMIC_ACQUIRE)};
+	return next;
+}
+
+/*
+ * In multi-writer regions, entries are stored in the order of space reservation, so an entry which was not committed
+ * before a crash (or was only reserved) might be followed by valid entries. Such an entry is turned into a padding
+ * span (empty span of non-zero size), which is skipped by iterators. Returns offset of the first empty span.
+ */
+static uint64_t region_recover_multi_writer(struct pmemstream_entry_iterator *iterator)
+{
+	const struct pmemstream_runtime *data = &iterator->stream->data;
+	uint64_t end_offset = region_end_offset(data, iterator->region);
+
+	iterator->offset = region_first_entry_offset(iterator->region);
+	while (iterator->offset + sizeof(struct span_base) <= end_offset) {
+		struct span_base *span_base = (struct span_base *)span_offset_to_span_ptr(data, iterator->offset);
+		enum span_type type = span_get_type(span_base);
+		size_t total_size = span_get_total_size(span_base);
+
+		if (span_get_size(span_base) == 0 && type == SPAN_EMPTY) {
+			break;
+		}
+		if ((type != SPAN_ENTRY && type != SPAN_COMPACT_ENTRY && type != SPAN_EMPTY) ||
+		    iterator->offset + total_size > end_offset) {
+			/* Should not happen unless the region was corrupted. */
+			break;
+		}
+
+		if (type != SPAN_EMPTY && !check_entry_consistency(iterator)) {
+			struct span_base padding = span_base_create(total_size - sizeof(struct span_empty), SPAN_EMPTY);
+			span_base_atomic_store(span_base, padding);
+			data->flush(span_base, sizeof(*span_base));
+		}
+
+		iterator->offset += total_size;
+	}
+	data->drain();
+
+	return iterator->offset;
+}
+
 static int region_runtime_iterate_and_initialize_for_write_no_lock(struct pmemstream *stream,
 								   struct pmemstream_region region,
 								   struct pmemstream_region_runtime *region_runtime)
@@ -247,7 +875,15 @@ static int region_runtime_iterate_and_initialize_for_write_no_lock(struct pmemst
 		return ret;
 	}
 
-	iterator.offset = region_first_entry_offset(region);
+	if (region_runtime_is_multi_writer(region_runtime)) {
+		region_runtime_initialize_for_write_no_lock(region_runtime, region_recover_multi_writer(&iterator));
+		return 0;
+	}
+
+	/* In regions with aligned entries, the first entry is preceded by padding. Entries preceding the last valid
+	 * record of the persistent index are not examined. */
+	iterator.offset = region_recovery_start_offset(region_runtime);
+	skip_padding(&iterator);
 	while (pmemstream_entry_iterator_is_valid(&iterator) == 0) {
 		pmemstream_entry_iterator_next(&iterator);
 	}
@@ -281,9 +917,9 @@ bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator)
 {
 	const struct span_region *span_region =
 		(const struct span_region *)span_offset_to_span_ptr(&iterator->stream->data, iterator->region.offset);
-	uint64_t region_end_offset = iterator->region.offset + span_get_total_size(&span_region->span_base);
+	uint64_t end_offset = region_end_offset(&iterator->stream->data, iterator->region);
 
-	if (iterator->offset >= region_end_offset) {
+	if (iterator->offset >= end_offset) {
 		return false;
 	}
 
@@ -298,26 +934,270 @@ bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator)
 		(const struct span_entry *)span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
 	struct span_entry span_entry = span_entry_atomic_load(span_entry_ptr);
 
-	if (span_get_type(&span_entry.span_base) != SPAN_ENTRY) {
+	/* In regions with compact entries, span of SPAN_ENTRY type can only be a claim of space (of a multi-writer
+	 * region), never a valid entry. */
+	enum span_type entry_type = region_runtime_has_compact_entries(iterator->region_runtime) ? SPAN_COMPACT_ENTRY
+												    : SPAN_ENTRY;
+	if (span_get_type(&span_entry.span_base) != entry_type) {
 		return false;
 	}
 
-	if (span_entry.timestamp == PMEMSTREAM_INVALID_TIMESTAMP) {
+	uint64_t timestamp = region_runtime_entry_timestamp(iterator->region_runtime, &span_entry);
+	if (timestamp == PMEMSTREAM_INVALID_TIMESTAMP) {
 		return false;
 	}
 
-	if (span_entry.timestamp <= max_valid_timestamp) {
-		return true;
+	if (timestamp > max_valid_timestamp) {
+		return false;
 	}
 
-	return false;
+	/* Checksums are verified only until the region is recovered - afterwards, all entries up to the committed
+	 * timestamp are complete. */
+	if (span_entry_has_checksum(&span_entry.span_base) &&
+	    region_runtime_get_state_acquire(iterator->region_runtime) != REGION_RUNTIME_STATE_WRITE_READY) {
+		if (iterator->offset + span_get_total_size(&span_entry.span_base) > end_offset) {
+			return false;
+		}
+		const struct span_checksummed_entry *checksummed_entry =
+			(const struct span_checksummed_entry *)span_entry_ptr;
+		return checksummed_entry->checksum == span_checksummed_entry_checksum(checksummed_entry);
+	}
+
+	return true;
+}
+
+void skip_padding(struct pmemstream_entry_iterator *iterator)
+{
+	if (!region_runtime_may_contain_padding(iterator->region_runtime)) {
+		return;
+	}
+
+	uint64_t end_offset = region_end_offset(&iterator->stream->data, iterator->region);
+	while (iterator->offset + sizeof(struct span_base) <= end_offset) {
+		const struct span_base *span_base = span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
+		struct span_base span = {.size_and_type = __atomic_load_n(&span_base->size_and_type, __ATOMIC_ACQUIRE)};
+		if (span_get_type(&span) != SPAN_EMPTY || span_get_size(&span) == 0) {
+			return;
+		}
+		iterator->offset += span_get_total_size(&span);
+	}
 }
 
 bool check_entry_and_maybe_recover_region(struct pmemstream_entry_iterator *iterator)
 {
+	skip_padding(iterator);
+
 	bool valid_entry = check_entry_consistency(iterator);
 	if (!valid_entry && iterator->perform_recovery) {
-		region_runtime_initialize_for_write_locked(iterator->region_runtime, iterator->offset);
+		if (region_runtime_is_multi_writer(iterator->region_runtime)) {
+			/* Invalid entry does not have to be the last one - the whole region has to be examined. */
+			region_runtime_iterate_and_initialize_for_write_locked(iterator->stream, iterator->region,
+									       iterator->region_runtime);
+			skip_padding(iterator);
+			valid_entry = check_entry_consistency(iterator);
+		} else {
+			region_runtime_initialize_for_write_locked(iterator->region_runtime, iterator->offset);
+		}
 	}
 	return valid_entry;
 }
+
+/* Returns offset from which search for the first entry with timestamp not less than 'timestamp' should start: the last
+ * sampled entry preceded only by entries with smaller timestamps (or the beginning of the region). */
+static uint64_t region_index_find(const struct region_index *index, struct pmemstream_region region,
+				  uint64_t timestamp)
+{
+	/* Find the first sample with max_timestamp not less than 'timestamp'. */
+	size_t begin = 0;
+	size_t end = index->samples_count;
+	while (begin < end) {
+		size_t mid = begin + (end - begin) / 2;
+		if (index->samples[mid].max_timestamp < timestamp) {
+			begin = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+
+	return begin == 0 ? region_first_entry_offset(region) : index->samples[begin - 1].offset;
+}
+
+/* Makes sure that at least 'count' samples fit in the index. Returns false if memory could not be allocated. */
+static bool region_index_reserve(struct region_index *index, size_t count)
+{
+	if (count <= index->samples_capacity) {
+		return true;
+	}
+
+	size_t capacity = index->samples_capacity ? index->samples_capacity : REGION_INDEX_INITIAL_CAPACITY;
+	while (capacity < count) {
+		capacity *= 2;
+	}
+
+	struct span_region_index_record *samples = realloc(index->samples, capacity * sizeof(*samples));
+	if (!samples) {
+		return false;
+	}
+	index->samples = samples;
+	index->samples_capacity = capacity;
+	return true;
+}
+
+/* Adds entry placed at 'offset' to the index, unless it's already covered by it. Entries must be added in the order
+ * of their offsets, without gaps. */
+static void region_index_add(struct region_index *index, uint64_t offset, size_t total_size, uint64_t timestamp)
+{
+	if (offset < index->end_offset) {
+		return;
+	}
+
+	/* Missing sample only makes seeks slower - the entry is still accounted for below. */
+	if (index->entries_count % REGION_INDEX_INTERVAL == 0 &&
+	    region_index_reserve(index, index->samples_count + 1)) {
+		struct span_region_index_record sample = {
+			.offset = offset, .ordinal = index->entries_count, .max_timestamp = index->max_timestamp};
+		index->samples[index->samples_count++] = sample;
+	}
+
+	index->entries_count++;
+	if (timestamp > index->max_timestamp) {
+		index->max_timestamp = timestamp;
+	}
+	index->end_offset = offset + total_size;
+}
+
+/* Loads valid records of the persistent index (if the region has one) as samples of the empty index. The last one is
+ * not loaded - index ends right before the entry it describes, so that the following entries are indexed in order. */
+static void region_index_load(struct pmemstream_entry_iterator *iterator)
+{
+	struct pmemstream_region_runtime *region_runtime = iterator->region_runtime;
+	struct region_index *index = &region_runtime->index;
+	if (index->loaded) {
+		return;
+	}
+	index->loaded = true;
+
+	const struct span_region_index *persistent_index =
+		region_persistent_index(region_runtime->data, region_runtime->region);
+	if (!persistent_index) {
+		return;
+	}
+
+	const struct span_region *span_region = (const struct span_region *)span_offset_to_span_ptr(
+		region_runtime->data, region_runtime->region.offset);
+	uint64_t max_timestamp = pmemstream_committed_timestamp(iterator->stream);
+	uint64_t max_valid_timestamp = __atomic_load_n(&span_region->max_valid_timestamp, __ATOMIC_RELAXED);
+	if (max_valid_timestamp < max_timestamp) {
+		max_timestamp = max_valid_timestamp;
+	}
+
+	size_t records_count = region_persistent_index_valid_records(
+		region_runtime, persistent_index, region_end_offset(region_runtime->data, region_runtime->region),
+		max_timestamp);
+	if (records_count == 0 || !region_index_reserve(index, records_count)) {
+		return;
+	}
+
+	const struct span_region_index_record *last = &persistent_index->records[records_count - 1];
+	memcpy(index->samples, persistent_index->records, (records_count - 1) * sizeof(*last));
+	index->samples_count = records_count - 1;
+	index->persisted_samples = records_count - 1;
+	index->end_offset = last->offset;
+	index->entries_count = last->ordinal;
+	index->max_timestamp = last->max_timestamp;
+}
+
+/* Records new samples of the index in the persistent index (if the region has one). Records are only written to
+ * regions ready for writes - recovery might still drop records of a region which is not. */
+static void region_index_persist(struct pmemstream_region_runtime *region_runtime)
+{
+	struct region_index *index = &region_runtime->index;
+	struct span_region_index *persistent_index =
+		region_persistent_index(region_runtime->data, region_runtime->region);
+	if (!persistent_index || region_runtime_get_state_acquire(region_runtime) != REGION_RUNTIME_STATE_WRITE_READY) {
+		return;
+	}
+
+	const struct span_region *span_region = (const struct span_region *)span_offset_to_span_ptr(
+		region_runtime->data, region_runtime->region.offset);
+	size_t capacity =
+		region_persistent_index_capacity(region_runtime->flags, span_get_total_size(&span_region->span_base));
+
+	for (; index->persisted_samples < index->samples_count; index->persisted_samples++) {
+		const struct span_region_index_record *sample = &index->samples[index->persisted_samples];
+		uint64_t slot = sample->ordinal / REGION_PERSISTENT_INDEX_INTERVAL;
+
+		/* Records are written in order - a sample might be missing only if memory allocation failed. */
+		if (sample->ordinal % REGION_PERSISTENT_INDEX_INTERVAL != 0 ||
+		    slot != persistent_index->records_count ||
+		    slot >= capacity) {
+			continue;
+		}
+
+		/* Record must be persisted before it's counted. */
+		persistent_index->records[slot] = *sample;
+		region_runtime->data->persist(&persistent_index->records[slot], sizeof(*sample));
+		persistent_index->records_count = slot + 1;
+		region_runtime->data->persist(&persistent_index->records_count,
+					      sizeof(persistent_index->records_count));
+	}
+}
+
+/* Moves iterator to the first entry with timestamp not less than 'timestamp', starting at 'offset', and adds
+ * examined entries to the index. Returns false if there is no such entry. */
+static bool region_index_scan(struct pmemstream_entry_iterator *iterator, uint64_t offset, uint64_t timestamp)
+{
+	struct pmemstream_region_runtime *region_runtime = iterator->region_runtime;
+
+	iterator->offset = offset;
+	while (check_entry_and_maybe_recover_region(iterator)) {
+		const struct span_entry *span_entry =
+			(const struct span_entry *)span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
+		uint64_t entry_timestamp = region_runtime_entry_timestamp(region_runtime, span_entry);
+		size_t total_size = span_get_total_size(&span_entry->span_base);
+
+		/* Scan starts at an indexed entry (or at the end of the index), so it reaches entries not covered by
+		 * the index in order. */
+		region_index_add(&region_runtime->index, iterator->offset, total_size, entry_timestamp);
+		if (entry_timestamp >= timestamp) {
+			return true;
+		}
+		iterator->offset += total_size;
+	}
+
+	return false;
+}
+
+bool region_seek_timestamp(struct pmemstream_entry_iterator *iterator, uint64_t timestamp)
+{
+	struct pmemstream_region_runtime *region_runtime = iterator->region_runtime;
+	struct region_index *index = &region_runtime->index;
+
+	pthread_mutex_lock(&index->lock);
+
+	region_index_load(iterator);
+	bool found = region_index_scan(iterator, region_index_find(index, iterator->region, timestamp), timestamp);
+	region_index_persist(region_runtime);
+
+	pthread_mutex_unlock(&index->lock);
+
+	return found;
+}
+
+void region_index_extend(struct pmemstream_entry_iterator *iterator)
+{
+	struct pmemstream_region_runtime *region_runtime = iterator->region_runtime;
+	struct region_index *index = &region_runtime->index;
+
+	/* Some other thread uses the index - entries will be indexed later. */
+	if (pthread_mutex_trylock(&index->lock) != 0) {
+		return;
+	}
+
+	region_index_load(iterator);
+	/* No entry has the biggest possible timestamp, so all valid entries are scanned. */
+	region_index_scan(iterator, index->end_offset, UINT64_MAX);
+	region_index_persist(region_runtime);
+
+	pthread_mutex_unlock(&index->lock);
+}
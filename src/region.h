@@ -34,6 +34,9 @@ int region_runtimes_map_get_or_create(struct region_runtimes_map *map, struct pm
 				      struct pmemstream_region_runtime **container_handle);
 void region_runtimes_map_remove(struct region_runtimes_map *map, struct pmemstream_region region);
 
+/* Returns region_runtime of the region containing 'offset' (NULL if there is no such region_runtime). */
+struct pmemstream_region_runtime *region_runtimes_map_find_containing(struct region_runtimes_map *map, uint64_t offset);
+
 /* Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
 uint64_t region_runtime_get_append_offset_relaxed(const struct pmemstream_region_runtime *region_runtime);
 
@@ -43,6 +46,95 @@ uint64_t region_runtime_get_append_offset_acquire(const struct pmemstream_region
 /* Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
 void region_runtime_increase_append_offset(struct pmemstream_region_runtime *region_runtime, uint64_t diff);
 
+/* Reserves 'size' bytes (span aligned) at the append offset of the region. In multi-writer regions, the append offset
+ * is moved forward atomically, so this function is safe to be called concurrently - the caller must claim entries
+ * placed in the reserved space right away (metadata of the reserved span is not stored).
+ * Returns offset of the reserved space or PMEMSTREAM_INVALID_OFFSET if there is not enough space in the region.
+ *
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+uint64_t region_runtime_reserve(struct pmemstream_region_runtime *region_runtime, size_t size);
+
+/* Shrinks reservation (made by region_runtime_reserve) at 'offset' to 'size' bytes (span aligned). In single-writer
+ * regions, the unused tail is returned to the append offset. In multi-writer regions, it becomes a padding span.
+ * Returns -1 if 'size' exceeds the reservation (or, in multi-writer regions, if the tail is exactly 8 bytes - too
+ * small to hold a padding span). On failure, the whole reservation is released (given back to the append offset or
+ * turned into padding).
+ *
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+int region_runtime_shrink_reservation(struct pmemstream_region_runtime *region_runtime, uint64_t offset, size_t size);
+
+/* Releases reservation (made by region_runtime_reserve) at 'offset', which will not be published. In single-writer
+ * regions, it's given back to the append offset. In multi-writer regions, it becomes a padding span.
+ *
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+void region_runtime_cancel_reservation(struct pmemstream_region_runtime *region_runtime, uint64_t offset);
+
+/* Makes sure that no more entries can be appended to the region. In multi-writer regions, all remaining space is
+ * claimed as padding. In single-writer regions it's a no-op - the only writer is expected to stop appending.
+ *
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+void region_runtime_seal(struct pmemstream_region_runtime *region_runtime);
+
+/* In multi-writer regions, metadata of reserved spans is not persisted on reservation - it's persisted along with
+ * entries placed after them, on commit. This function flushes (without a drain) metadata of all spans placed before
+ * 'offset' which might not be persistent yet ('flushed' is set if there was any). Returns false if some of them is
+ * reserved, but not claimed yet (the caller should retry later). Once flushed metadata is drained (along with
+ * metadata of spans following 'offset', up to some 'end_offset'),
+ * region_runtime_set_spans_persistent(region_runtime, end_offset) records that, so that it's not flushed again.
+ *
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+bool region_runtime_flush_spans(struct pmemstream_region_runtime *region_runtime, uint64_t offset, bool *flushed);
+void region_runtime_set_spans_persistent(struct pmemstream_region_runtime *region_runtime, uint64_t offset);
+
+bool region_runtime_is_multi_writer(const struct pmemstream_region_runtime *region_runtime);
+
+/* Returns alignment of entries in a region with specified PMEMSTREAM_REGION_* 'flags' (sizeof(span_bytes) unless
+ * one of PMEMSTREAM_REGION_ENTRY_ALIGN_* flags is set). */
+size_t region_entry_alignment(uint64_t flags);
+
+size_t region_runtime_entry_alignment(const struct pmemstream_region_runtime *region_runtime);
+
+/* Returns size of space occupied by an entry of 'entry_total_size' bytes (span aligned), including padding which
+ * places the following entry at 'alignment' boundary. */
+size_t region_entry_slot_size(size_t alignment, size_t entry_total_size);
+
+/* Functions describing entries format of a region with specified PMEMSTREAM_REGION_* 'flags'. In regions allocated
+ * with PMEMSTREAM_REGION_COMPACT_ENTRIES flag, entries have compact metadata (struct span_compact_entry), which
+ * limits their size. region_codec returns identifier of the region's codec (0 if data is not compressed). */
+bool region_has_compact_entries(uint64_t flags);
+bool region_has_entry_checksums(uint64_t flags);
+bool region_has_persistent_index(uint64_t flags);
+unsigned region_codec(uint64_t flags);
+bool region_entry_size_fits(uint64_t flags, size_t size);
+size_t region_entry_header_size(uint64_t flags);
+
+/* Returns size of the persistent index placed at the end of a region of 'region_total_size' bytes (including its
+ * metadata) with specified 'flags' - 0 if the region does not have a persistent index. */
+size_t region_persistent_index_size(uint64_t flags, size_t region_total_size);
+
+/* Returns persistent index of the region (NULL if the region does not have one). */
+struct span_region_index *region_persistent_index(const struct pmemstream_runtime *data,
+						  struct pmemstream_region region);
+
+/* Creates metadata (without timestamp) of a regular, not compact, entry of 'size' bytes. */
+struct span_base region_entry_span_base_create(uint64_t flags, size_t size);
+
+/* Returns size of an entry of 'size' bytes, including its metadata (span aligned).
+ * Precondition: region_entry_size_fits(flags, size). */
+size_t region_entry_total_size(uint64_t flags, size_t size);
+
+uint64_t region_runtime_get_flags(const struct pmemstream_region_runtime *region_runtime);
+bool region_runtime_has_compact_entries(const struct pmemstream_region_runtime *region_runtime);
+uint64_t region_runtime_get_timestamp_base(const struct pmemstream_region_runtime *region_runtime);
+
+/* Creates metadata of a compact entry with specified 'timestamp'. */
+struct span_base region_runtime_compact_entry_create(const struct pmemstream_region_runtime *region_runtime,
+						     size_t size, uint64_t timestamp);
+
+/* Returns timestamp of an entry (either regular or compact) of the region. */
+uint64_t region_runtime_entry_timestamp(const struct pmemstream_region_runtime *region_runtime,
+					const struct span_entry *span_entry);
+
 /*
  * Performs region recovery. This function iterates over entire region to find last entry and set append/committed
  * offset appropriately. * After this call, it's safe to write to the region. */
@@ -51,9 +143,32 @@ int region_runtime_iterate_and_initialize_for_write_locked(struct pmemstream *st
 
 bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator);
 
+/* Moves iterator past padding spans (empty spans of non-zero size), if there are any at its offset.
+ * Padding is only created in multi-writer regions and in regions with aligned entries - anywhere else, empty span
+ * marks the end of data. */
+void skip_padding(struct pmemstream_entry_iterator *iterator);
+
 bool check_entry_and_maybe_recover_region(struct pmemstream_entry_iterator *iterator);
 
+/* Moves iterator to the first entry of its region (in the order of entries) with timestamp not less than
+ * 'timestamp'. It's done using (and extending) the sampled index of the region, so only entries following the last
+ * sample preceding the sought entry are examined. Returns false if there is no such entry. */
+bool region_seek_timestamp(struct pmemstream_entry_iterator *iterator, uint64_t timestamp);
+
+/* Extends the sampled index of iterator's region (and its persistent index, if there is one) with entries appended
+ * since the index was last extended. It's skipped if the index is being used by some other thread at the moment.
+ * Iterator position is not preserved. */
+void region_index_extend(struct pmemstream_entry_iterator *iterator);
+
 uint64_t region_first_entry_offset(struct pmemstream_region region);
+
+/* Returns the region following 'region' in a region chain (its offset is PMEMSTREAM_INVALID_OFFSET if there is
+ * none). */
+struct pmemstream_region region_next_chained(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Returns offset right past the end of space for entries of the region (it's followed by the persistent index
+ * in regions which have one). */
+uint64_t region_end_offset(const struct pmemstream_runtime *data, struct pmemstream_region region);
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -27,16 +27,48 @@ static void recover_free_list_extension(const struct pmemstream_runtime *runtime
 }
 
 static void perform_free_list_head_to_allocated_list_tail_move(const struct pmemstream_runtime *runtime,
-							       struct allocator_header *header)
+							       struct allocator_header *header, uint64_t flags,
+							       uint64_t timestamp_base, uint64_t prev_chained_region)
 {
 	uint64_t region_free = header->free_list.head;
 
 	struct span_base *span = (struct span_base *)span_offset_to_span_ptr(runtime, region_free);
 	assert(span_get_type(span) == SPAN_REGION);
 
+	/* max_valid_timestamp, flags, next_chained_region, timestamp_base and prev_chained_region are adjacent -
+	 * persist them at once. */
 	((struct span_region *)span)->max_valid_timestamp = UINT64_MAX;
-	runtime->persist(&((struct span_region *)span)->max_valid_timestamp, sizeof(uint64_t));
-	runtime->memset(((struct span_region *)span)->data, 0, sizeof(struct span_entry), PMEM2_F_MEM_NONTEMPORAL);
+	((struct span_region *)span)->flags = flags;
+	((struct span_region *)span)->next_chained_region = PMEMSTREAM_INVALID_OFFSET;
+	((struct span_region *)span)->timestamp_base = timestamp_base;
+	((struct span_region *)span)->prev_chained_region = prev_chained_region;
+	runtime->persist(&((struct span_region *)span)->max_valid_timestamp, 5 * sizeof(uint64_t));
+
+	/* In regions with aligned entries, the first entry is preceded by padding. Entries are aligned in memory - the
+	 * spans base (right after the stream header) does not have to be aligned to 256 bytes. All entries occupy
+	 * multiples of the alignment, so it's enough to align the first one. */
+	struct pmemstream_region region = {.offset = region_free};
+	uint64_t first_entry_offset = region_first_entry_offset(region);
+	uintptr_t first_entry_address = (uintptr_t)pmemstream_offset_to_ptr(runtime, first_entry_offset);
+	size_t padding_size = ALIGN_UP(first_entry_address, region_entry_alignment(flags)) - first_entry_address;
+	if (padding_size > 0 && padding_size + sizeof(struct span_entry) <= span_get_size(span)) {
+		struct span_empty padding = {
+			.span_base = span_base_create(padding_size - sizeof(struct span_empty), SPAN_EMPTY)};
+		struct span_empty *padding_dst =
+			(struct span_empty *)span_offset_to_span_ptr(runtime, first_entry_offset);
+		*padding_dst = padding;
+		runtime->persist(padding_dst, sizeof(*padding_dst));
+		first_entry_offset += padding_size;
+	}
+	runtime->memset((uint8_t *)pmemstream_offset_to_ptr(runtime, first_entry_offset), 0, sizeof(struct span_entry),
+			PMEM2_F_MEM_NONTEMPORAL);
+
+	/* Persistent index of a reused region must not describe entries of the previous one. */
+	struct span_region_index *persistent_index = region_persistent_index(runtime, region);
+	if (persistent_index) {
+		runtime->memset(&persistent_index->records_count, 0, sizeof(persistent_index->records_count),
+				PMEM2_F_MEM_NONTEMPORAL);
+	}
 
 	SLIST_INSERT_TAIL(struct span_region, runtime, &header->allocated_list, region_free,
 			  allocator_entry_metadata.next_allocated);
@@ -118,7 +150,7 @@ void allocator_runtime_initialize(const struct pmemstream_runtime *runtime, stru
 }
 
 uint64_t allocator_region_allocate(const struct pmemstream_runtime *runtime, struct allocator_header *header,
-				   size_t size)
+				   size_t size, uint64_t flags, uint64_t timestamp_base, uint64_t prev_chained_region)
 {
 	uint64_t free_region = header->free_list.head;
 
@@ -133,7 +165,7 @@ uint64_t allocator_region_allocate(const struct pmemstream_runtime *runtime, str
 	assert(span_get_type(span_offset_to_span_ptr(runtime, free_region)) == SPAN_REGION);
 	assert(span_get_size(span_offset_to_span_ptr(runtime, free_region)) == size);
 
-	perform_free_list_head_to_allocated_list_tail_move(runtime, header);
+	perform_free_list_head_to_allocated_list_tail_move(runtime, header, flags, timestamp_base, prev_chained_region);
 
 	return free_region;
 }
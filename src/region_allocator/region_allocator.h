@@ -13,7 +13,7 @@ extern "C" {
 /* Should be called on each application restart. */
 void allocator_runtime_initialize(const struct pmemstream_runtime *runtime, struct allocator_header *header);
 uint64_t allocator_region_allocate(const struct pmemstream_runtime *runtime, struct allocator_header *header,
-				   size_t size);
+				   size_t size, uint64_t flags, uint64_t timestamp_base, uint64_t prev_chained_region);
 void allocator_region_free(const struct pmemstream_runtime *runtime, struct allocator_header *header, uint64_t offset);
 
 #ifdef __cplusplus
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#include "region_chain.h"
+#include "iterator.h"
+#include "libpmemstream_internal.h"
+#include "region.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+static void region_chain_link(struct pmemstream_region_chain *chain, struct pmemstream_region region,
+			      struct pmemstream_region next)
+{
+	struct span_region *span_region =
+		(struct span_region *)span_offset_to_span_ptr(&chain->stream->data, region.offset);
+	__atomic_store_n(&span_region->next_chained_region, next.offset, __ATOMIC_RELEASE);
+	chain->stream->data.persist(&span_region->next_chained_region, sizeof(span_region->next_chained_region));
+}
+
+/* Allocates a new region and links it after 'region' (which must be the last region of the chain). The new region
+ * records (on allocation) that it follows 'region', so it's not leaked if a crash happens before it's linked - see
+ * region_chain_recover_link. */
+static int region_chain_extend(struct pmemstream_region_chain *chain, struct pmemstream_region region,
+			       struct pmemstream_region *new_region)
+{
+	assert(region_next_chained(&chain->stream->data, region).offset == PMEMSTREAM_INVALID_OFFSET);
+
+	int ret = pmemstream_region_allocate_chained(chain->stream, chain->region_size, chain->region_flags, region,
+						     new_region);
+	if (ret) {
+		return ret;
+	}
+
+	region_chain_link(chain, region, *new_region);
+
+	return 0;
+}
+
+/* Links the region allocated to follow 'last' (the last region of the chain), if a crash happened after its
+ * allocation, but before it was linked. */
+static void region_chain_recover_link(struct pmemstream_region_chain *chain, struct pmemstream_region last)
+{
+	const struct pmemstream_runtime *data = &chain->stream->data;
+	struct allocator_header *allocator_header = &chain->stream->header->region_allocator_header;
+
+	uint64_t offset;
+	SLIST_FOREACH(struct span_region, data, &allocator_header->allocated_list, offset,
+		      allocator_entry_metadata.next_allocated)
+	{
+		const struct span_region *span_region =
+			(const struct span_region *)span_offset_to_span_ptr(data, offset);
+		if (span_region->prev_chained_region == last.offset) {
+			struct pmemstream_region next = {.offset = offset};
+			region_chain_link(chain, last, next);
+			return;
+		}
+	}
+}
+
+/* Makes sure there is a region following 'region'. Failure is not fatal - allocation is retried on the next roll. */
+static void region_chain_preallocate(struct pmemstream_region_chain *chain, struct pmemstream_region region)
+{
+	if (region_next_chained(&chain->stream->data, region).offset == PMEMSTREAM_INVALID_OFFSET) {
+		struct pmemstream_region next;
+		region_chain_extend(chain, region, &next);
+	}
+}
+
+static bool region_has_entries(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator iterator;
+	if (entry_iterator_initialize(&iterator, stream, region, true)) {
+		return false;
+	}
+
+	pmemstream_entry_iterator_seek_first(&iterator);
+	return pmemstream_entry_iterator_is_valid(&iterator) == 0;
+}
+
+int pmemstream_region_chain_new(struct pmemstream_region_chain **chain, struct pmemstream *stream,
+				struct pmemstream_region head)
+{
+	if (!chain) {
+		return -1;
+	}
+
+	int ret = pmemstream_validate_stream_and_offset(stream, head.offset);
+	if (ret) {
+		return ret;
+	}
+
+	struct pmemstream_region_chain *c = malloc(sizeof(*c));
+	if (!c) {
+		return -1;
+	}
+
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(&stream->data, head.offset);
+	assert(span_get_type(&span_region->span_base) == SPAN_REGION);
+
+	c->stream = stream;
+	c->head = head;
+	c->region_size = span_get_size(&span_region->span_base);
+	c->region_flags = span_region->flags;
+
+	ret = pthread_mutex_init(&c->roll_lock, NULL);
+	if (ret) {
+		goto err_roll_lock;
+	}
+
+	/* Tail is the last region with any entries - following regions (if any) were only allocated in advance. */
+	struct pmemstream_region tail = head;
+	struct pmemstream_region last = head;
+	for (struct pmemstream_region region = region_next_chained(&stream->data, head);
+	     region.offset != PMEMSTREAM_INVALID_OFFSET; region = region_next_chained(&stream->data, region)) {
+		if (region_has_entries(stream, region)) {
+			tail = region;
+		}
+		last = region;
+	}
+	c->tail_offset = tail.offset;
+
+	region_chain_recover_link(c, last);
+	region_chain_preallocate(c, tail);
+
+	*chain = c;
+	return 0;
+
+err_roll_lock:
+	free(c);
+	return -1;
+}
+
+void pmemstream_region_chain_delete(struct pmemstream_region_chain **chain)
+{
+	if (!chain || !*chain) {
+		return;
+	}
+
+	pthread_mutex_destroy(&(*chain)->roll_lock);
+	free(*chain);
+	*chain = NULL;
+}
+
+/* Moves tail of the chain past (full) 'tail' region, unless it was already done by another thread. */
+static int region_chain_roll(struct pmemstream_region_chain *chain, struct pmemstream_region tail,
+			     struct pmemstream_region_runtime *tail_runtime)
+{
+	int ret = 0;
+	pthread_mutex_lock(&chain->roll_lock);
+
+	if (__atomic_load_n(&chain->tail_offset, __ATOMIC_RELAXED) != tail.offset) {
+		goto out;
+	}
+
+	struct pmemstream_region next = region_next_chained(&chain->stream->data, tail);
+	if (next.offset == PMEMSTREAM_INVALID_OFFSET) {
+		/* Region was not allocated in advance. */
+		ret = region_chain_extend(chain, tail, &next);
+		if (ret) {
+			goto out;
+		}
+	}
+
+	/* Nothing can be appended to the previous tail anymore (by threads which have not noticed the roll yet), so
+	 * that iterators can safely move on to the next region. */
+	region_runtime_seal(tail_runtime);
+	__atomic_store_n(&chain->tail_offset, next.offset, __ATOMIC_RELEASE);
+
+	region_chain_preallocate(chain, next);
+
+out:
+	pthread_mutex_unlock(&chain->roll_lock);
+	return ret;
+}
+
+int pmemstream_region_chain_append(struct pmemstream_region_chain *chain, const void *data, size_t size,
+				   struct pmemstream_entry *new_entry)
+{
+	if (!chain) {
+		return -1;
+	}
+
+	/* Entry must fit in a single (empty) region. In regions with aligned entries, the first entry is preceded by
+	 * padding - its size depends on the address of the region, so the biggest one possible is assumed. */
+	size_t alignment = region_entry_alignment(chain->region_flags);
+	uint64_t first_entry_offset = region_first_entry_offset(chain->head) + alignment - sizeof(span_bytes);
+	uint64_t region_capacity = region_end_offset(&chain->stream->data, chain->head) - first_entry_offset;
+	if (!region_entry_size_fits(chain->region_flags, size) ||
+	    size > region_capacity - region_entry_header_size(chain->region_flags)) {
+		return -1;
+	}
+	size_t entry_total_size = region_entry_total_size(chain->region_flags, size);
+	if (region_entry_slot_size(alignment, entry_total_size) > region_capacity) {
+		return -1;
+	}
+
+	while (true) {
+		struct pmemstream_region tail = {.offset = __atomic_load_n(&chain->tail_offset, __ATOMIC_ACQUIRE)};
+		struct pmemstream_region_runtime *tail_runtime;
+		int ret = pmemstream_region_runtime_initialize(chain->stream, tail, &tail_runtime);
+		if (ret) {
+			return ret;
+		}
+
+		ret = pmemstream_append(chain->stream, tail, tail_runtime, data, size, new_entry);
+		if (ret == 0) {
+			return 0;
+		}
+
+		/* Chain rolls only if the tail is full (or, in regions with compact entries, timestamps of new entries
+		 * no longer fit in its delta range) - any other error is returned. */
+		if (!pmemstream_region_is_full(chain->stream, tail, tail_runtime, size)) {
+			return ret;
+		}
+
+		ret = region_chain_roll(chain, tail, tail_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
+}
+
+int pmemstream_region_chain_entry_iterator_new(struct pmemstream_entry_iterator **iterator,
+					       struct pmemstream_region_chain *chain)
+{
+	if (!iterator || !chain) {
+		return -1;
+	}
+
+	struct pmemstream_entry_iterator *iter = malloc(sizeof(*iter));
+	if (!iter) {
+		return -1;
+	}
+
+	int ret = entry_iterator_initialize(iter, chain->stream, chain->head, true);
+	if (ret) {
+		goto err;
+	}
+	iter->chain_head = chain->head;
+
+	*iterator = iter;
+
+	return 0;
+
+err:
+	free(iter);
+	return ret;
+}
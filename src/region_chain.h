@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_REGION_CHAIN_H
+#define LIBPMEMSTREAM_REGION_CHAIN_H
+
+#include "libpmemstream.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Regions of a chain are linked (persistently) by next_chained_region field of span_region. Entries are appended
+ * to the tail region - once it is full, the chain rolls to the next region, which is always allocated in advance
+ * (unless stream was full at that time). A newly allocated region records its predecessor (prev_chained_region), so
+ * that a link interrupted by a crash is completed when the chain is reopened.
+ */
+struct pmemstream_region_chain {
+	struct pmemstream *stream;
+	struct pmemstream_region head;
+
+	/* Size and PMEMSTREAM_REGION_* flags of all regions in the chain (taken from the head). */
+	size_t region_size;
+	uint64_t region_flags;
+
+	/* Offset of the region to which entries are appended. */
+	uint64_t tail_offset;
+
+	/* Protects rolling to the next region (along with allocation of the regions). */
+	pthread_mutex_t roll_lock;
+};
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_REGION_CHAIN_H */
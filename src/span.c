@@ -5,6 +5,7 @@
 
 #include <assert.h>
 
+#include "common/crc32c.h"
 #include "common/util.h"
 
 struct span_base span_base_create(uint64_t size, enum span_type type)
@@ -14,8 +15,97 @@ struct span_base span_base_create(uint64_t size, enum span_type type)
 	return span;
 };
 
+struct span_base span_compact_entry_create(uint64_t size, uint64_t timestamp_delta)
+{
+	assert(size <= SPAN_COMPACT_ENTRY_MAX_SIZE && timestamp_delta <= SPAN_COMPACT_ENTRY_MAX_DELTA);
+	uint64_t size_and_delta = (size << SPAN_COMPACT_ENTRY_DELTA_BITS) | timestamp_delta;
+	struct span_base span = {.size_and_type = size_and_delta | SPAN_COMPACT_ENTRY};
+	return span;
+}
+
+struct span_base span_checksummed_entry_create(uint64_t size)
+{
+	assert((size & (SPAN_TYPE_MASK | SPAN_ENTRY_CHECKSUM)) == 0);
+	struct span_base span = {.size_and_type = size | SPAN_ENTRY_CHECKSUM | SPAN_ENTRY};
+	return span;
+}
+
+bool span_entry_has_checksum(const struct span_base *span)
+{
+	return span_get_type(span) == SPAN_ENTRY && (span->size_and_type & SPAN_ENTRY_CHECKSUM) != 0;
+}
+
+uint64_t span_checksummed_entry_checksum(const struct span_checksummed_entry *entry)
+{
+	assert(span_entry_has_checksum(&entry->span_base));
+	uint32_t crc = crc32c_update(CRC32C_INIT, &entry->span_base.size_and_type, sizeof(entry->span_base));
+	crc = crc32c_update(crc, &entry->timestamp, sizeof(entry->timestamp));
+	crc = crc32c_update(crc, entry->data, span_get_size(&entry->span_base));
+	return ~crc;
+}
+
+struct span_base span_compressed_entry_create(uint64_t size)
+{
+	assert((size & (SPAN_TYPE_MASK | SPAN_ENTRY_COMPRESSED)) == 0);
+	struct span_base span = {.size_and_type = size | SPAN_ENTRY_COMPRESSED | SPAN_ENTRY};
+	return span;
+}
+
+bool span_entry_is_compressed(const struct span_base *span)
+{
+	return span_get_type(span) == SPAN_ENTRY && (span->size_and_type & SPAN_ENTRY_COMPRESSED) != 0;
+}
+
+uint64_t span_compressed_entry_codec_and_size(unsigned codec_id, size_t uncompressed_size)
+{
+	assert(codec_id < (1U << SPAN_COMPRESSED_ENTRY_CODEC_BITS));
+	assert((uncompressed_size >> SPAN_COMPRESSED_ENTRY_SIZE_BITS) == 0);
+	return ((uint64_t)codec_id << SPAN_COMPRESSED_ENTRY_SIZE_BITS) | uncompressed_size;
+}
+
+unsigned span_compressed_entry_get_codec(const struct span_compressed_entry *entry)
+{
+	assert(span_entry_is_compressed(&entry->span_base));
+	return (unsigned)(entry->codec_and_size >> SPAN_COMPRESSED_ENTRY_SIZE_BITS);
+}
+
+size_t span_compressed_entry_get_uncompressed_size(const struct span_compressed_entry *entry)
+{
+	if (span_compressed_entry_get_codec(entry) == 0) {
+		return span_get_size(&entry->span_base);
+	}
+	return entry->codec_and_size & ((1ULL << SPAN_COMPRESSED_ENTRY_SIZE_BITS) - 1);
+}
+
+size_t span_entry_header_size(const struct span_base *span)
+{
+	assert(span_get_type(span) == SPAN_ENTRY || span_get_type(span) == SPAN_COMPACT_ENTRY);
+	if (span_get_type(span) == SPAN_COMPACT_ENTRY) {
+		return sizeof(struct span_compact_entry);
+	}
+	if (span_entry_has_checksum(span)) {
+		return sizeof(struct span_checksummed_entry);
+	}
+	if (span_entry_is_compressed(span)) {
+		return sizeof(struct span_compressed_entry);
+	}
+	return sizeof(struct span_entry);
+}
+
+uint64_t span_compact_entry_get_timestamp_delta(const struct span_base *span)
+{
+	assert(span_get_type(span) == SPAN_COMPACT_ENTRY);
+	return span->size_and_type & SPAN_COMPACT_ENTRY_MAX_DELTA;
+}
+
 uint64_t span_get_size(const struct span_base *span)
 {
+	if (span_get_type(span) == SPAN_COMPACT_ENTRY) {
+		return (span->size_and_type & SPAN_EXTRA_MASK) >> SPAN_COMPACT_ENTRY_DELTA_BITS;
+	}
+	if (span_get_type(span) == SPAN_ENTRY) {
+		return span->size_and_type & SPAN_EXTRA_MASK & ~(SPAN_ENTRY_CHECKSUM | SPAN_ENTRY_COMPRESSED);
+	}
 	return span->size_and_type & SPAN_EXTRA_MASK;
 }
 
@@ -27,11 +117,19 @@ size_t span_get_total_size(const struct span_base *span)
 			size += sizeof(struct span_empty);
 			break;
 		case SPAN_ENTRY:
-			size += sizeof(struct span_entry);
+			size += span_entry_header_size(span);
 			break;
 		case SPAN_REGION:
 			size += sizeof(struct span_region);
 			break;
+		case SPAN_COMPACT_ENTRY:
+			/* Empty compact entry takes as much space as the smallest regular one, so that it can be
+			 * claimed (and turned into padding) as any other entry. */
+			size += sizeof(struct span_compact_entry);
+			if (size < sizeof(struct span_entry)) {
+				size = sizeof(struct span_entry);
+			}
+			break;
 		default:
 			break;
 	}
@@ -11,6 +11,7 @@
 
 #include <assert.h>
 #include <stdalign.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -28,7 +29,7 @@ enum span_type {
 	SPAN_EMPTY = 0b00ULL << 62,
 	SPAN_REGION = 0b11ULL << 62,
 	SPAN_ENTRY = 0b10ULL << 62,
-	SPAN_UNKNOWN = 0b01ULL << 62
+	SPAN_COMPACT_ENTRY = 0b01ULL << 62
 };
 
 #define SPAN_TYPE_MASK (11ULL << 62)
@@ -42,6 +43,10 @@ struct span_region {
 	alignas(CACHELINE_SIZE) struct span_base span_base;
 	struct allocator_entry_metadata allocator_entry_metadata;
 	uint64_t max_valid_timestamp; /* used for region recovery */
+	uint64_t flags;		      /* PMEMSTREAM_REGION_* flags, set on allocation */
+	uint64_t next_chained_region; /* offset of the next region in a region chain, set by pmemstream_region_chain */
+	uint64_t timestamp_base;      /* timestamps of compact entries are stored as a delta from this value */
+	uint64_t prev_chained_region; /* offset of the region this one is allocated to follow in a region chain */
 
 	alignas(CACHELINE_SIZE) uint64_t data[];
 };
@@ -49,12 +54,76 @@ struct span_region {
 static_assert(sizeof(struct span_region) == CACHELINE_SIZE,
 	      "size of struct span_region must be equal to CACHELINE_SIZE");
 
+/*
+ * Persistent index of a region allocated with PMEMSTREAM_REGION_PERSISTENT_INDEX flag, placed at the end of the
+ * region (entries are only stored before it). Records describe every few hundred entries of the region, in order -
+ * offset of the entry, its ordinal number in the region and the biggest timestamp of entries preceding it. Only the
+ * first records_count records are used.
+ */
+struct span_region_index_record {
+	uint64_t offset;
+	uint64_t ordinal;
+	uint64_t max_timestamp;
+};
+
+struct span_region_index {
+	alignas(CACHELINE_SIZE) uint64_t records_count;
+	alignas(CACHELINE_SIZE) struct span_region_index_record records[];
+};
+
 struct span_entry {
 	struct span_base span_base;
 	uint64_t timestamp;
 	uint64_t data[];
 };
 
+/*
+ * Entry of a region allocated with PMEMSTREAM_REGION_ENTRY_CHECKSUMS flag has SPAN_ENTRY_CHECKSUM bit set in its
+ * span_base. Its metadata is followed by CRC32C of the metadata and data (see span_checksummed_entry_checksum), which
+ * lets recovery detect torn entries.
+ */
+struct span_checksummed_entry {
+	struct span_base span_base;
+	uint64_t timestamp;
+	uint64_t checksum;
+	uint64_t data[];
+};
+
+#define SPAN_ENTRY_CHECKSUM (1ULL << 61)
+
+/*
+ * Entry of a region allocated with PMEMSTREAM_REGION_CODEC flag has SPAN_ENTRY_COMPRESSED bit set in its span_base
+ * (and span size is the size of stored, possibly compressed, data). Its metadata is followed by a codec identifier
+ * (SPAN_COMPRESSED_ENTRY_CODEC_BITS most significant bits) and size of uncompressed data. Codec 0 means data is
+ * stored as is - in such a case uncompressed size is not used.
+ */
+struct span_compressed_entry {
+	struct span_base span_base;
+	uint64_t timestamp;
+	uint64_t codec_and_size;
+	uint64_t data[];
+};
+
+#define SPAN_ENTRY_COMPRESSED (1ULL << 60)
+
+#define SPAN_COMPRESSED_ENTRY_CODEC_BITS 8
+#define SPAN_COMPRESSED_ENTRY_SIZE_BITS (64 - SPAN_COMPRESSED_ENTRY_CODEC_BITS)
+
+/*
+ * Compact entry (used in regions allocated with PMEMSTREAM_REGION_COMPACT_ENTRIES flag) keeps its metadata in
+ * span_base only: SPAN_COMPACT_ENTRY_SIZE_BITS of size and SPAN_COMPACT_ENTRY_DELTA_BITS of timestamp, stored as
+ * a delta from the region's timestamp_base (0 stands for PMEMSTREAM_INVALID_TIMESTAMP).
+ */
+struct span_compact_entry {
+	struct span_base span_base;
+	uint64_t data[];
+};
+
+#define SPAN_COMPACT_ENTRY_SIZE_BITS 16
+#define SPAN_COMPACT_ENTRY_DELTA_BITS 46
+#define SPAN_COMPACT_ENTRY_MAX_SIZE ((1ULL << SPAN_COMPACT_ENTRY_SIZE_BITS) - 1)
+#define SPAN_COMPACT_ENTRY_MAX_DELTA ((1ULL << SPAN_COMPACT_ENTRY_DELTA_BITS) - 1)
+
 struct span_empty {
 	struct span_base span_base;
 };
@@ -63,6 +132,35 @@ typedef uint64_t span_bytes;
 
 struct span_base span_base_create(uint64_t size, enum span_type type);
 
+struct span_base span_compact_entry_create(uint64_t size, uint64_t timestamp_delta);
+
+struct span_base span_checksummed_entry_create(uint64_t size);
+
+struct span_base span_compressed_entry_create(uint64_t size);
+
+/* Returns true if span is an entry with a checksum (struct span_checksummed_entry). */
+bool span_entry_has_checksum(const struct span_base *span);
+
+/* Computes checksum of an entry: its size, timestamp and data. */
+uint64_t span_checksummed_entry_checksum(const struct span_checksummed_entry *entry);
+
+/* Returns true if span is an entry with codec metadata (struct span_compressed_entry). */
+bool span_entry_is_compressed(const struct span_base *span);
+
+/* Creates value of codec_and_size field of struct span_compressed_entry. */
+uint64_t span_compressed_entry_codec_and_size(unsigned codec_id, size_t uncompressed_size);
+
+/* Returns identifier of a codec used to compress data of the entry (0 if data is not compressed). */
+unsigned span_compressed_entry_get_codec(const struct span_compressed_entry *entry);
+
+/* Returns size of the entry's data after decompression. */
+size_t span_compressed_entry_get_uncompressed_size(const struct span_compressed_entry *entry);
+
+/* Returns size of metadata of an entry (either regular or compact), preceding its data. */
+size_t span_entry_header_size(const struct span_base *span);
+
+uint64_t span_compact_entry_get_timestamp_delta(const struct span_base *span);
+
 /* Returns size of the span's data - excluding size of the span structure itself. */
 size_t span_get_size(const struct span_base *span);
 
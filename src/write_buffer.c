@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+#include "write_buffer.h"
+#include "common/util.h"
+#include "libpmemstream_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t write_buffer_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int pmemstream_write_buffer_new(struct pmemstream_write_buffer **buffer, struct pmemstream *stream,
+				struct pmemstream_region region, size_t capacity, uint64_t max_delay_ns)
+{
+	if (!buffer || capacity < sizeof(struct span_entry)) {
+		return -1;
+	}
+
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	struct pmemstream_write_buffer *b = calloc(1, sizeof(*b));
+	if (!b) {
+		return -1;
+	}
+
+	ret = pmemstream_region_runtime_initialize(stream, region, &b->region_runtime);
+	if (ret) {
+		free(b);
+		return ret;
+	}
+
+	b->capacity = ALIGN_DOWN(capacity, sizeof(span_bytes));
+	b->staged = malloc(b->capacity);
+	if (!b->staged) {
+		goto err_staged;
+	}
+
+	b->sizes = malloc(stream->max_concurrency * sizeof(*b->sizes));
+	if (!b->sizes) {
+		goto err_sizes;
+	}
+
+	b->stream = stream;
+	b->region = region;
+	b->max_delay_ns = max_delay_ns;
+	b->last_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+
+	*buffer = b;
+	return 0;
+
+err_sizes:
+	free(b->staged);
+err_staged:
+	free(b);
+	return -1;
+}
+
+/* Appends all staged entries to the region. Entries stay staged if that fails. */
+static int write_buffer_emit(struct pmemstream_write_buffer *buffer)
+{
+	if (buffer->count == 0) {
+		return 0;
+	}
+
+	int ret = pmemstream_append_staged_batch(buffer->stream, buffer->region, buffer->region_runtime,
+						 buffer->staged, buffer->sizes, buffer->count, &buffer->last_timestamp);
+	if (ret) {
+		return ret;
+	}
+
+	buffer->staged_size = 0;
+	buffer->count = 0;
+
+	return 0;
+}
+
+/* Emits staged entries if the first of them has been staged for at least max_delay_ns. */
+static int write_buffer_emit_expired(struct pmemstream_write_buffer *buffer)
+{
+	if (buffer->max_delay_ns == 0 || buffer->count == 0) {
+		return 0;
+	}
+
+	if (write_buffer_now_ns() - buffer->first_staged_ns < buffer->max_delay_ns) {
+		return 0;
+	}
+
+	return write_buffer_emit(buffer);
+}
+
+int pmemstream_write_buffer_delete(struct pmemstream_write_buffer **buffer)
+{
+	if (!buffer || !*buffer) {
+		return 0;
+	}
+
+	struct pmemstream_write_buffer *b = *buffer;
+	/* Buffer is released even if staged entries could not be emitted - the caller is only notified that they are
+	 * lost (see pmemstream_write_buffer_flush). */
+	int ret = write_buffer_emit(b);
+
+	free(b->sizes);
+	free(b->staged);
+	free(b);
+	*buffer = NULL;
+
+	return ret;
+}
+
+int pmemstream_write_buffer_append(struct pmemstream_write_buffer *buffer, const void *data, size_t size)
+{
+	if (!buffer || (!data && size > 0)) {
+		return -1;
+	}
+
+	uint64_t region_flags = region_runtime_get_flags(buffer->region_runtime);
+	if (!region_entry_size_fits(region_flags, size)) {
+		return -1;
+	}
+
+	size_t total_size = region_entry_total_size(region_flags, size);
+	if (buffer->staged_size + total_size > buffer->capacity || buffer->count == buffer->stream->max_concurrency) {
+		int ret = write_buffer_emit(buffer);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	if (total_size > buffer->capacity) {
+		/* Entry does not fit in the buffer - it's appended directly. */
+		struct pmemstream_entry entry;
+		int ret = pmemstream_async_append(buffer->stream, buffer->stream->data_mover_sync_vdm, buffer->region,
+						  buffer->region_runtime, data, size, &entry);
+		if (ret) {
+			return ret;
+		}
+		buffer->last_timestamp = pmemstream_entry_timestamp(buffer->stream, entry);
+		return 0;
+	}
+
+	/* Span metadata is written on emit, but placeholder (and alignment padding) is zeroed, so that no
+	 * uninitialized bytes are copied to the region. */
+	uint8_t *destination = buffer->staged + buffer->staged_size;
+	size_t header_size = region_entry_header_size(region_flags);
+	memset(destination, 0, header_size);
+	memcpy(destination + header_size, data, size);
+	memset(destination + header_size + size, 0, total_size - header_size - size);
+
+	buffer->sizes[buffer->count] = size;
+	buffer->staged_size += total_size;
+	buffer->count++;
+
+	if (buffer->count == 1) {
+		/* Deadline starts with the first staged entry. */
+		buffer->first_staged_ns = buffer->max_delay_ns ? write_buffer_now_ns() : 0;
+		return 0;
+	}
+
+	return write_buffer_emit_expired(buffer);
+}
+
+int pmemstream_write_buffer_poll(struct pmemstream_write_buffer *buffer)
+{
+	if (!buffer) {
+		return -1;
+	}
+
+	return write_buffer_emit_expired(buffer);
+}
+
+uint64_t pmemstream_write_buffer_flush(struct pmemstream_write_buffer *buffer)
+{
+	if (!buffer) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	if (write_buffer_emit(buffer)) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	return buffer->last_timestamp;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/* Internal Header */
+
+#ifndef LIBPMEMSTREAM_WRITE_BUFFER_H
+#define LIBPMEMSTREAM_WRITE_BUFFER_H
+
+#include "libpmemstream.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * DRAM buffer, combining tiny appends (done by a single thread) into a region. Entries are staged with exactly
+ * the same layout as they will have in the region, so that the whole buffer is written with a single copy and
+ * flushed at once, on commit.
+ */
+struct pmemstream_write_buffer {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+	struct pmemstream_region_runtime *region_runtime;
+
+	/* Staged entries: span_entry placeholder followed by (span aligned) data, for each entry. */
+	uint8_t *staged;
+	size_t staged_size;
+	size_t capacity;
+
+	/* Data sizes of staged entries (there can be at most max_concurrency of them). */
+	size_t *sizes;
+	size_t count;
+
+	/* Staged entries are emitted once the first of them waits longer than max_delay_ns (0 means no deadline). */
+	uint64_t max_delay_ns;
+	uint64_t first_staged_ns;
+
+	/* Timestamp of the last emitted entry. */
+	uint64_t last_timestamp;
+};
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_WRITE_BUFFER_H */
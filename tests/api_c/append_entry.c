@@ -2,10 +2,13 @@
 /* Copyright 2021-2022, Intel Corporation */
 
 #include "common/util.h"
+#include "libpmemstream_internal.h"
 #include "span.h"
 #include "stream_helpers.h"
 #include "unittest.h"
 
+#include <string.h>
+
 /**
  * append_entry - unit test for pmemstream_append, pmemstream_entry_data,
  *					pmemstream_entry_size
@@ -172,6 +175,79 @@ void invalid_entry_test(char *path)
 	pmemstream_test_teardown(env);
 }
 
+static struct pmemstream_runtime original_runtime;
+static size_t flushed_bytes;
+
+static void counting_flush(const void *ptr, size_t size)
+{
+	flushed_bytes += size;
+	original_runtime.flush(ptr, size);
+}
+
+static void counting_persist(const void *ptr, size_t size)
+{
+	flushed_bytes += size;
+	original_runtime.persist(ptr, size);
+}
+
+/* Appends 'data' (of 'size' bytes) in a few different ways and checks how many bytes were flushed. Data copied with
+ * non-temporal stores should not be flushed on commit. */
+void copy_policy_test(char *path, size_t threshold, bool nontemporal)
+{
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_nontemporal_copy_threshold(config, threshold), 0);
+
+	pmemstream_test_env env;
+	env.map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(env.map, NULL);
+	UT_ASSERTeq(pmemstream_from_map_with_config(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map, config), 0);
+	pmemstream_config_delete(&config);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	static const size_t size = 1024;
+	uint8_t data[2][1024];
+	memset(data[0], 0xAB, size);
+	memset(data[1], 0xCD, size);
+
+	original_runtime = env.stream->data;
+	env.stream->data.flush = counting_flush;
+	env.stream->data.persist = counting_persist;
+
+	struct pmemstream_entry entries[4];
+
+	flushed_bytes = 0;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data[0], size, &entries[0]), 0);
+	UT_ASSERT(nontemporal ? flushed_bytes < size : flushed_bytes >= size);
+
+	flushed_bytes = 0;
+	struct iovec iov[] = {{.iov_base = data[0], .iov_len = size / 2},
+			      {.iov_base = data[0] + size / 2, .iov_len = size / 2}};
+	UT_ASSERTeq(pmemstream_appendv(env.stream, region, NULL, iov, 2, &entries[1]), 0);
+	UT_ASSERT(nontemporal ? flushed_bytes < size : flushed_bytes >= size);
+
+	flushed_bytes = 0;
+	const void *batch_data[] = {data[0], data[1]};
+	const size_t sizes[] = {size, size};
+	UT_ASSERTeq(pmemstream_append_batch(env.stream, region, NULL, batch_data, sizes, 2, &entries[2]), 0);
+	UT_ASSERT(nontemporal ? flushed_bytes < size : flushed_bytes >= 2 * size);
+
+	env.stream->data = original_runtime;
+
+	/* Verify data after reopen. */
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	for (size_t i = 0; i < 4; i++) {
+		UT_ASSERTeq(pmemstream_entry_size(env.stream, entries[i]), size);
+		UT_ASSERTeq(memcmp(pmemstream_entry_data(env.stream, entries[i]), data[i == 3], size), 0);
+	}
+
+	pmemstream_test_teardown(env);
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 2) {
@@ -190,6 +266,10 @@ int main(int argc, char *argv[])
 	null_data_test(path);
 	null_entry_test(path);
 	invalid_entry_test(path);
+	copy_policy_test(path, 0, true);
+	copy_policy_test(path, 1024, true);
+	copy_policy_test(path, 1025, false);
+	copy_policy_test(path, SIZE_MAX, false);
 
 	return 0;
 }
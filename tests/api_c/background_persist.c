@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * background_persist - unit test for pmemstream_config_set_background_persist
+ */
+
+#include "libpmemstream_internal.h"
+#include "unittest.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define THREADS_COUNT 16
+#define ENTRIES_PER_THREAD 100
+#define LEASE_SIZE 16
+#define REGIONS_COUNT 4
+
+struct test_env {
+	struct pmem2_map *map;
+	struct pmemstream *stream;
+};
+
+static struct test_env make_stream(char *path, int background_persist, size_t lease_size, bool truncate)
+{
+	struct test_env env;
+	env.map = map_open(path, TEST_DEFAULT_STREAM_SIZE, truncate);
+	UT_ASSERTne(env.map, NULL);
+
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_background_persist(config, background_persist), 0);
+	UT_ASSERTeq(pmemstream_config_set_timestamp_lease_size(config, lease_size), 0);
+
+	UT_ASSERTeq(pmemstream_from_map_with_config(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map, config), 0);
+	pmemstream_config_delete(&config);
+
+	return env;
+}
+
+static void teardown(struct test_env env)
+{
+	pmemstream_delete(&env.stream);
+	pmem2_map_delete(&env.map);
+}
+
+/* Verifies that region contains entries with values 0, 1, ..., count - 1. */
+static void verify_region(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), i);
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void test_invalid_config(void)
+{
+	UT_ASSERTne(pmemstream_config_set_background_persist(NULL, 1), 0);
+}
+
+struct thread_args {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+};
+
+static void *append_thread(void *arg)
+{
+	struct thread_args *args = arg;
+	for (uint64_t e = 0; e < ENTRIES_PER_THREAD; e++) {
+		struct pmemstream_entry entry;
+		UT_ASSERTeq(pmemstream_append(args->stream, args->region, NULL, &e, sizeof(e), &entry), 0);
+		UT_ASSERT(pmemstream_entry_timestamp(args->stream, entry) <= pmemstream_persisted_timestamp(args->stream));
+	}
+
+	return NULL;
+}
+
+/* Synchronous appends only wait for the background thread. */
+void test_sync_appends(char *path)
+{
+	struct test_env env = make_stream(path, 1, 0, true);
+
+	pthread_t threads[THREADS_COUNT];
+	struct thread_args args[THREADS_COUNT];
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE / THREADS_COUNT / 2,
+						     &args[i].region);
+		UT_ASSERTeq(ret, 0);
+		args[i].stream = env.stream;
+	}
+
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_create(&threads[i], NULL, append_thread, &args[i]), 0);
+	}
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_join(threads[i], NULL), 0);
+	}
+
+	const uint64_t expected_timestamp = THREADS_COUNT * ENTRIES_PER_THREAD;
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), expected_timestamp);
+	teardown(env);
+
+	env = make_stream(path, 0, 0, false);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), expected_timestamp);
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		verify_region(env.stream, args[i].region, ENTRIES_PER_THREAD);
+	}
+	teardown(env);
+}
+
+/* Published entries are persisted without anyone waiting for them. */
+void test_async_publish(char *path)
+{
+	struct test_env env = make_stream(path, 1, 0, true);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	struct pmemstream_region_runtime *region_runtime;
+	UT_ASSERTeq(pmemstream_region_runtime_initialize(env.stream, region, &region_runtime), 0);
+
+	struct pmemstream_entry entry;
+	for (uint64_t e = 0; e < ENTRIES_PER_THREAD; e++) {
+		void *data;
+		UT_ASSERTeq(pmemstream_reserve(env.stream, region, region_runtime, sizeof(e), &entry, &data), 0);
+		memcpy(data, &e, sizeof(e));
+		UT_ASSERTeq(pmemstream_async_publish(env.stream, region, region_runtime, entry, sizeof(e)), 0);
+	}
+
+	uint64_t timestamp = pmemstream_entry_timestamp(env.stream, entry);
+	while (pmemstream_persisted_timestamp(env.stream) < timestamp) {
+		sched_yield();
+	}
+
+	/* Blocking waits return right away. */
+	UT_ASSERTeq(pmemstream_wait_committed(env.stream, timestamp), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, timestamp), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, timestamp + 1), -1);
+
+	/* One more entry, waited for with a blocking call. */
+	uint64_t e = ENTRIES_PER_THREAD;
+	void *data;
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, region_runtime, sizeof(e), &entry, &data), 0);
+	memcpy(data, &e, sizeof(e));
+	UT_ASSERTeq(pmemstream_async_publish(env.stream, region, region_runtime, entry, sizeof(e)), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, timestamp + 1), 0);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), timestamp + 1);
+
+	verify_region(env.stream, region, ENTRIES_PER_THREAD + 1);
+	teardown(env);
+}
+
+/* Background thread does not revoke leases - timestamps handed out from a lease stay consecutive, even if the thread
+ * runs in between. Leases holding timestamps preceding an awaited one are revoked by the waiting thread. */
+void test_timestamp_leases(char *path)
+{
+	struct test_env env = make_stream(path, 1, LEASE_SIZE, true);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[r]), 0);
+	}
+	struct pmemstream_region_runtime *region_runtime;
+	UT_ASSERTeq(pmemstream_region_runtime_initialize(env.stream, regions[0], &region_runtime), 0);
+
+	uint64_t first_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	for (uint64_t e = 0; e < LEASE_SIZE / 2; e++) {
+		struct pmemstream_entry entry;
+		void *data;
+		UT_ASSERTeq(pmemstream_reserve(env.stream, regions[0], region_runtime, sizeof(e), &entry, &data), 0);
+		memcpy(data, &e, sizeof(e));
+		UT_ASSERTeq(pmemstream_async_publish(env.stream, regions[0], region_runtime, entry, sizeof(e)), 0);
+
+		uint64_t timestamp = pmemstream_entry_timestamp(env.stream, entry);
+		if (e == 0) {
+			first_timestamp = timestamp;
+		}
+		UT_ASSERTeq(timestamp, first_timestamp + e);
+
+		/* Let the background thread process published entries. */
+		uint64_t committed_timestamp = pmemstream_committed_timestamp(env.stream);
+		for (int i = 0; i < 100 && pmemstream_committed_timestamp(env.stream) == committed_timestamp; i++) {
+			sched_yield();
+		}
+	}
+
+	/* Entries appended to other regions (using other leases) follow unused timestamps of the first lease. */
+	for (size_t r = 1; r < REGIONS_COUNT; r++) {
+		uint64_t e = 0;
+		struct pmemstream_entry entry;
+		UT_ASSERTeq(pmemstream_append(env.stream, regions[r], NULL, &e, sizeof(e), &entry), 0);
+		UT_ASSERT(pmemstream_entry_timestamp(env.stream, entry) <= pmemstream_persisted_timestamp(env.stream));
+	}
+
+	verify_region(env.stream, regions[0], LEASE_SIZE / 2);
+	for (size_t r = 1; r < REGIONS_COUNT; r++) {
+		verify_region(env.stream, regions[r], 1);
+	}
+	teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+	char *path = argv[1];
+
+	START();
+
+	test_invalid_config();
+	test_sync_appends(path);
+	test_async_publish(path);
+	test_timestamp_leases(path);
+
+	return 0;
+}
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * compact_entries - unit test for regions allocated with PMEMSTREAM_REGION_COMPACT_ENTRIES flag
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <string.h>
+
+#define MAX_ENTRY_SIZE 4000
+#define BATCH_SIZE 4
+#define RECORD_SIZE 16
+#define WRITE_BUFFER_CAPACITY 1024
+
+/* Sizes of appended entries - compact entry metadata takes 8 bytes, but the whole entry takes at least 16 bytes. */
+static const size_t entry_sizes[] = {0, 1, 7, 8, 9, 16, 24, 100, 600, MAX_ENTRY_SIZE};
+#define ENTRY_SIZES_COUNT (sizeof(entry_sizes) / sizeof(entry_sizes[0]))
+#define ENTRIES_COUNT (10 * ENTRY_SIZES_COUNT)
+
+static size_t entry_size(size_t i)
+{
+	return entry_sizes[i % ENTRY_SIZES_COUNT];
+}
+
+static void fill_entry(uint8_t *data, size_t i)
+{
+	memset(data, (int)i, entry_size(i));
+}
+
+/* Verifies that region contains 'count' entries created by fill_entry, with timestamps stored in 'timestamps'. */
+static void verify_entries(struct pmemstream *stream, struct pmemstream_region region, const uint64_t *timestamps,
+			   size_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	size_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERT(i < count);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), entry_size(i));
+		UT_ASSERTeq(pmemstream_entry_timestamp(stream, entry), timestamps[i]);
+
+		const uint8_t *data = pmemstream_entry_data(stream, entry);
+		for (size_t j = 0; j < entry_size(i); j++) {
+			UT_ASSERTeq(data[j], (uint8_t)i);
+		}
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* Appends 'count' entries, starting from i-th one, using append, batch append and reserve/publish. Timestamps of
+ * appended entries are stored in 'timestamps'. */
+static void append_entries(struct pmemstream *stream, struct pmemstream_region region, uint64_t *timestamps,
+			   size_t i, size_t count)
+{
+	static uint8_t data[BATCH_SIZE][MAX_ENTRY_SIZE];
+	const size_t end = i + count;
+	while (i < end) {
+		struct pmemstream_entry entries[BATCH_SIZE];
+		size_t appended = 1;
+		if (i % 3 == 0) {
+			fill_entry(data[0], i);
+			UT_ASSERTeq(pmemstream_append(stream, region, NULL, data[0], entry_size(i), &entries[0]), 0);
+		} else if (i % 3 == 1 && i + BATCH_SIZE <= end) {
+			const void *batch_data[BATCH_SIZE];
+			size_t sizes[BATCH_SIZE];
+			for (size_t j = 0; j < BATCH_SIZE; j++) {
+				fill_entry(data[j], i + j);
+				batch_data[j] = data[j];
+				sizes[j] = entry_size(i + j);
+			}
+			int ret = pmemstream_append_batch(stream, region, NULL, batch_data, sizes, BATCH_SIZE, entries);
+			UT_ASSERTeq(ret, 0);
+			appended = BATCH_SIZE;
+		} else {
+			/* Entry is reserved with the maximal size and published with the actual one. */
+			void *reserved_data;
+			int ret = pmemstream_reserve(stream, region, NULL, MAX_ENTRY_SIZE, &entries[0], &reserved_data);
+			UT_ASSERTeq(ret, 0);
+			fill_entry(reserved_data, i);
+			UT_ASSERTeq(pmemstream_publish(stream, region, NULL, entries[0], entry_size(i)), 0);
+		}
+
+		for (size_t j = 0; j < appended; j++) {
+			timestamps[i + j] = pmemstream_entry_timestamp(stream, entries[j]);
+			UT_ASSERTne(timestamps[i + j], PMEMSTREAM_INVALID_TIMESTAMP);
+			UT_ASSERT(i + j == 0 || timestamps[i + j] > timestamps[i + j - 1]);
+		}
+		i += appended;
+	}
+}
+
+void test_invalid_sizes(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	static uint8_t data[SPAN_COMPACT_ENTRY_MAX_SIZE + 1];
+	const size_t too_big = SPAN_COMPACT_ENTRY_MAX_SIZE + 1;
+
+	struct pmemstream_entry entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data, too_big, &entry), -1);
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, too_big, &entry, &reserved_data), -1);
+
+	const void *batch_data[] = {data, data};
+	size_t sizes[] = {1, too_big};
+	struct pmemstream_entry entries[2];
+	UT_ASSERTeq(pmemstream_append_batch(env.stream, region, NULL, batch_data, sizes, 2, entries), -1);
+
+	/* Nothing was appended so far. */
+	uint64_t timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	verify_entries(env.stream, region, &timestamp, 0);
+
+	/* The biggest compact entry. */
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data, SPAN_COMPACT_ENTRY_MAX_SIZE, &entry), 0);
+	UT_ASSERTeq(pmemstream_entry_size(env.stream, entry), SPAN_COMPACT_ENTRY_MAX_SIZE);
+
+	/* Entry cannot be published with a size which does not fit in compact metadata - its reservation is released
+	 * (in single-writer regions, the space is reused by the next entry). */
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, 1, &entry, &reserved_data), 0);
+	UT_ASSERTeq(pmemstream_publish(env.stream, region, NULL, entry, too_big), -1);
+	struct pmemstream_entry next_entry;
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, 1, &next_entry, &reserved_data), 0);
+	if (!(flags & PMEMSTREAM_REGION_MULTI_WRITER)) {
+		UT_ASSERTeq(next_entry.offset, entry.offset);
+	}
+	UT_ASSERTeq(pmemstream_publish(env.stream, region, NULL, next_entry, 1), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_compact_entries(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	/* Timestamps in the compact region are relative to timestamps of entries appended before its allocation. */
+	struct pmemstream_region regular_region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regular_region), 0);
+	uint64_t value = 0;
+	UT_ASSERTeq(pmemstream_append(env.stream, regular_region, NULL, &value, sizeof(value), NULL), 0);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE * 5, flags,
+							  &region),
+		    0);
+
+	uint64_t timestamps[2 * ENTRIES_COUNT];
+	append_entries(env.stream, region, timestamps, 0, ENTRIES_COUNT);
+	verify_entries(env.stream, region, timestamps, ENTRIES_COUNT);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_entries(env.stream, region, timestamps, ENTRIES_COUNT);
+
+	append_entries(env.stream, region, timestamps, ENTRIES_COUNT, ENTRIES_COUNT);
+	verify_entries(env.stream, region, timestamps, 2 * ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Returns number of RECORD_SIZE records which fit in a region allocated with 'flags'. */
+static size_t count_records(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, flags, &region),
+		    0);
+
+	uint8_t record[RECORD_SIZE] = {0};
+	size_t count = 0;
+	while (pmemstream_append(env.stream, region, NULL, record, sizeof(record), NULL) == 0) {
+		count++;
+	}
+
+	pmemstream_test_teardown(env);
+	return count;
+}
+
+void test_capacity(char *path)
+{
+	size_t regular_count = count_records(path, 0);
+	size_t compact_count = count_records(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+
+	/* Compact entry takes 24 bytes instead of 32. */
+	UT_ASSERT(compact_count * 3 >= regular_count * 4 - 4);
+}
+
+void test_write_buffer(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, WRITE_BUFFER_CAPACITY, 0), 0);
+
+	uint8_t data[MAX_ENTRY_SIZE];
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		fill_entry(data, i);
+		UT_ASSERTeq(pmemstream_write_buffer_append(buffer, data, entry_size(i)), 0);
+	}
+
+	static uint8_t too_big[SPAN_COMPACT_ENTRY_MAX_SIZE + 1];
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, too_big, sizeof(too_big)), -1);
+
+	uint64_t last_timestamp = pmemstream_write_buffer_flush(buffer);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, last_timestamp), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+
+	/* No other entries were appended to the stream, so timestamps are consecutive. */
+	uint64_t timestamps[ENTRIES_COUNT];
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		timestamps[i] = last_timestamp - ENTRIES_COUNT + 1 + i;
+	}
+	verify_entries(env.stream, region, timestamps, ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_sizes(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+	test_invalid_sizes(path, PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_MULTI_WRITER);
+
+	test_compact_entries(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+	test_compact_entries(path, PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_MULTI_WRITER);
+	test_compact_entries(path, PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_ENTRY_ALIGN_64);
+	test_compact_entries(path, PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_ENTRY_ALIGN_256 |
+					   PMEMSTREAM_REGION_MULTI_WRITER);
+
+	test_capacity(path);
+
+	test_write_buffer(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+	test_write_buffer(path, PMEMSTREAM_REGION_COMPACT_ENTRIES | PMEMSTREAM_REGION_MULTI_WRITER);
+
+	return 0;
+}
@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * compressed_entries - unit test for regions allocated with PMEMSTREAM_REGION_CODEC flag
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ENTRY_SIZE 4096
+#define ENTRIES_COUNT 64
+#define RLE_CODEC 2
+
+static const size_t entry_sizes[] = {0, 1, 7, 64, 100, 1000, MAX_ENTRY_SIZE};
+#define ENTRY_SIZES_COUNT (sizeof(entry_sizes) / sizeof(entry_sizes[0]))
+
+static size_t entry_size(size_t i)
+{
+	return entry_sizes[i % ENTRY_SIZES_COUNT];
+}
+
+/* Fills data with JSON-like, compressible text (odd entries) or pseudo-random, incompressible bytes (even ones). */
+static void fill_entry(uint8_t *data, size_t i)
+{
+	size_t size = entry_size(i);
+	if (i % 2) {
+		char record[64];
+		size_t offset = 0;
+		for (size_t n = 0; offset < size; n++) {
+			int len = snprintf(record, sizeof(record), "{\"id\": %zu, \"entry\": %zu, \"ok\": 1}, ", n, i);
+			size_t copied = (size - offset < (size_t)len) ? size - offset : (size_t)len;
+			memcpy(data + offset, record, copied);
+			offset += copied;
+		}
+	} else {
+		uint64_t state = i * 0x9E3779B97F4A7C15ULL + 1;
+		for (size_t j = 0; j < size; j++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			data[j] = (uint8_t)state;
+		}
+	}
+}
+
+/* Verifies that region contains 'count' entries created by fill_entry. */
+static void verify_entries(struct pmemstream *stream, struct pmemstream_region region, size_t count)
+{
+	static uint8_t expected[MAX_ENTRY_SIZE];
+	static uint8_t buffer[MAX_ENTRY_SIZE];
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	size_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		size_t size = entry_size(i);
+		fill_entry(expected, i);
+
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), size);
+		UT_ASSERTeq(pmemstream_entry_read(stream, entry, buffer, size), 0);
+		UT_ASSERTeq(memcmp(buffer, expected, size), 0);
+
+		/* Buffer must fit the whole (decompressed) entry. */
+		if (size > 0) {
+			UT_ASSERTeq(pmemstream_entry_read(stream, entry, buffer, size - 1), -1);
+		}
+
+		/* Uncompressed data is still accessible directly. */
+		const struct span_compressed_entry *span =
+			(const struct span_compressed_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
+		UT_ASSERT(span_entry_is_compressed(&span->span_base));
+		const uint8_t *data = pmemstream_entry_data(stream, entry);
+		if (span_compressed_entry_get_codec(span) == 0) {
+			UT_ASSERTne(data, NULL);
+			UT_ASSERTeq(memcmp(data, expected, size), 0);
+		} else {
+			UT_ASSERTeq(data, NULL);
+			UT_ASSERT(span_get_size(&span->span_base) < size);
+		}
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* Appends 'count' entries, starting from i-th one. */
+static void append_entries(struct pmemstream *stream, struct pmemstream_region region, size_t i, size_t count)
+{
+	static uint8_t data[MAX_ENTRY_SIZE];
+	for (size_t end = i + count; i < end; i++) {
+		fill_entry(data, i);
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, data, entry_size(i), NULL), 0);
+	}
+}
+
+/* Returns number of bytes taken by entries appended to the region. */
+static size_t used_size(struct pmemstream *stream, struct pmemstream_region region)
+{
+	return pmemstream_region_size(stream, region) - pmemstream_region_usable_size(stream, region);
+}
+
+/* Toy codec which compresses only data consisting of a single, repeated byte. */
+static size_t rle_compress(const void *src, size_t src_size, void *dst, size_t dst_capacity)
+{
+	const uint8_t *in = src;
+	for (size_t i = 1; i < src_size; i++) {
+		if (in[i] != in[0]) {
+			return 0;
+		}
+	}
+	if (src_size == 0 || dst_capacity < 1) {
+		return 0;
+	}
+	*(uint8_t *)dst = in[0];
+	return 1;
+}
+
+static int rle_decompress(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	if (src_size != 1) {
+		return -1;
+	}
+	memset(dst, *(const uint8_t *)src, dst_size);
+	return 0;
+}
+
+static pmemstream_test_env make_stream_with_rle_codec(char *path, bool truncate)
+{
+	pmemstream_test_env env;
+	env.map = map_open(path, TEST_DEFAULT_STREAM_SIZE, truncate);
+	UT_ASSERTne(env.map, NULL);
+
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	struct pmemstream_codec codec = {.compress = rle_compress, .decompress = rle_decompress};
+	UT_ASSERTeq(pmemstream_config_set_codec(config, RLE_CODEC, &codec), 0);
+
+	UT_ASSERTeq(pmemstream_from_map_with_config(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map, config), 0);
+	pmemstream_config_delete(&config);
+
+	return env;
+}
+
+void test_invalid_codecs(char *path)
+{
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	struct pmemstream_codec codec = {.compress = rle_compress, .decompress = rle_decompress};
+	struct pmemstream_codec incomplete_codec = {.compress = rle_compress, .decompress = NULL};
+	UT_ASSERTeq(pmemstream_config_set_codec(config, 0, &codec), -1);
+	UT_ASSERTeq(pmemstream_config_set_codec(config, PMEMSTREAM_CODEC_LZ, &codec), -1);
+	UT_ASSERTeq(pmemstream_config_set_codec(config, PMEMSTREAM_MAX_CODECS, &codec), -1);
+	UT_ASSERTeq(pmemstream_config_set_codec(config, RLE_CODEC, NULL), -1);
+	UT_ASSERTeq(pmemstream_config_set_codec(config, RLE_CODEC, &incomplete_codec), -1);
+	UT_ASSERTeq(pmemstream_config_set_codec(config, PMEMSTREAM_MAX_CODECS - 1, &codec), 0);
+	pmemstream_config_delete(&config);
+
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	const uint64_t invalid_flags[] = {
+		PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ) | PMEMSTREAM_REGION_COMPACT_ENTRIES,
+		PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ) | PMEMSTREAM_REGION_ENTRY_CHECKSUMS,
+		/* Codec is not registered. */
+		PMEMSTREAM_REGION_CODEC(RLE_CODEC)};
+	for (size_t i = 0; i < sizeof(invalid_flags) / sizeof(invalid_flags[0]); i++) {
+		struct pmemstream_region region;
+		int ret = pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, invalid_flags[i],
+								&region);
+		UT_ASSERTeq(ret, -1);
+	}
+
+	pmemstream_test_teardown(env);
+}
+
+void test_lz_entries(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	flags |= PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ);
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	append_entries(env.stream, region, 0, ENTRIES_COUNT);
+	verify_entries(env.stream, region, ENTRIES_COUNT);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_entries(env.stream, region, ENTRIES_COUNT);
+
+	append_entries(env.stream, region, ENTRIES_COUNT, ENTRIES_COUNT);
+	verify_entries(env.stream, region, 2 * ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Compressible data takes less space than in a regular region. */
+void test_lz_saves_space(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regular_region;
+	struct pmemstream_region compressed_region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regular_region), 0);
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE,
+							  PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ),
+							  &compressed_region),
+		    0);
+
+	/* Odd entries are compressible. */
+	static uint8_t data[MAX_ENTRY_SIZE];
+	const size_t compressible_entry = 5;
+	fill_entry(data, compressible_entry);
+	size_t size = entry_size(compressible_entry);
+	UT_ASSERTeq(size, 1000);
+
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(env.stream, regular_region, NULL, data, size, NULL), 0);
+		UT_ASSERTeq(pmemstream_append(env.stream, compressed_region, NULL, data, size, NULL), 0);
+	}
+
+	size_t regular_size = used_size(env.stream, regular_region);
+	size_t compressed_size = used_size(env.stream, compressed_region);
+	UT_ASSERT(compressed_size * 2 < regular_size);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Reserved entries, batches and vectored appends are stored uncompressed. */
+void test_uncompressed_paths(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE,
+							  PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ), &region),
+		    0);
+
+	static uint8_t data[3][MAX_ENTRY_SIZE];
+	for (size_t i = 0; i < 3; i++) {
+		fill_entry(data[i], i);
+	}
+
+	struct pmemstream_entry entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, MAX_ENTRY_SIZE, &entry, &reserved_data), 0);
+	memcpy(reserved_data, data[0], entry_size(0));
+	UT_ASSERTeq(pmemstream_publish(env.stream, region, NULL, entry, entry_size(0)), 0);
+
+	const void *batch_data[] = {data[1]};
+	size_t sizes[] = {entry_size(1)};
+	UT_ASSERTeq(pmemstream_append_batch(env.stream, region, NULL, batch_data, sizes, 1, NULL), 0);
+
+	struct iovec iov[] = {{.iov_base = data[2], .iov_len = 3}, {.iov_base = data[2] + 3, .iov_len = 4}};
+	UT_ASSERTeq(entry_size(2), 7);
+	UT_ASSERTeq(pmemstream_appendv(env.stream, region, NULL, iov, 2, NULL), 0);
+
+	verify_entries(env.stream, region, 3);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_custom_codec(char *path)
+{
+	pmemstream_test_env env = make_stream_with_rle_codec(path, true);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE,
+							  PMEMSTREAM_REGION_CODEC(RLE_CODEC), &region),
+		    0);
+
+	static uint8_t data[MAX_ENTRY_SIZE];
+	static uint8_t buffer[MAX_ENTRY_SIZE];
+	memset(data, 0xAB, sizeof(data));
+	struct pmemstream_entry entry;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data, sizeof(data), &entry), 0);
+
+	const struct span_base *span = span_offset_to_span_ptr(&env.stream->data, entry.offset);
+	UT_ASSERTeq(span_get_size(span), 1);
+	UT_ASSERTeq(pmemstream_entry_size(env.stream, entry), sizeof(data));
+	UT_ASSERTeq(pmemstream_entry_read(env.stream, entry, buffer, sizeof(buffer)), 0);
+	UT_ASSERTeq(memcmp(buffer, data, sizeof(data)), 0);
+
+	/* Without the codec, the entry can't be decompressed. */
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	UT_ASSERTeq(pmemstream_entry_size(env.stream, entry), sizeof(data));
+	UT_ASSERTeq(pmemstream_entry_read(env.stream, entry, buffer, sizeof(buffer)), -1);
+	pmemstream_test_teardown(env);
+
+	env = make_stream_with_rle_codec(path, false);
+	memset(buffer, 0, sizeof(buffer));
+	UT_ASSERTeq(pmemstream_entry_read(env.stream, entry, buffer, sizeof(buffer)), 0);
+	UT_ASSERTeq(memcmp(buffer, data, sizeof(data)), 0);
+	pmemstream_test_teardown(env);
+}
+
+/* In a multi-writer region, data is stored as is if compressing it would leave exactly 8 unused bytes (which can't
+ * become padding) in the reservation. */
+void test_custom_codec_multi_writer(char *path)
+{
+	pmemstream_test_env env = make_stream_with_rle_codec(path, true);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE,
+							  PMEMSTREAM_REGION_CODEC(RLE_CODEC) |
+								  PMEMSTREAM_REGION_MULTI_WRITER,
+							  &region),
+		    0);
+
+	static uint8_t data[MAX_ENTRY_SIZE];
+	static uint8_t buffer[MAX_ENTRY_SIZE];
+	memset(data, 0xAB, sizeof(data));
+	const size_t max_size = 4 * sizeof(uint64_t);
+	for (size_t size = 1; size <= max_size; size++) {
+		UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data, size, NULL), 0);
+	}
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+	size_t size = 1;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		const struct span_compressed_entry *span =
+			(const struct span_compressed_entry *)span_offset_to_span_ptr(&env.stream->data, entry.offset);
+
+		/* Compressed data takes 1 byte (so it doesn't save anything for a 1-byte entry), which is stored in an
+		 * 8-byte slot. */
+		bool stored_as_is = size == 1 || (size > sizeof(uint64_t) && size <= 2 * sizeof(uint64_t));
+		UT_ASSERTeq(span_compressed_entry_get_codec(span), stored_as_is ? 0 : RLE_CODEC);
+		UT_ASSERTeq(pmemstream_entry_size(env.stream, entry), size);
+		UT_ASSERTeq(pmemstream_entry_read(env.stream, entry, buffer, size), 0);
+		UT_ASSERTeq(memcmp(buffer, data, size), 0);
+		size++;
+	}
+	UT_ASSERTeq(size, max_size + 1);
+	pmemstream_entry_iterator_delete(&it);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Reading malformed compressed data fails instead of overflowing the buffer. */
+void test_corrupted_entry(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE,
+							  PMEMSTREAM_REGION_CODEC(PMEMSTREAM_CODEC_LZ), &region),
+		    0);
+
+	static uint8_t data[MAX_ENTRY_SIZE];
+	static uint8_t buffer[MAX_ENTRY_SIZE];
+	memset(data, 0, sizeof(data));
+	struct pmemstream_entry entry;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, data, sizeof(data), &entry), 0);
+
+	struct span_compressed_entry *span =
+		(struct span_compressed_entry *)span_offset_to_span_ptr(&env.stream->data, entry.offset);
+	UT_ASSERTeq(span_compressed_entry_get_codec(span), PMEMSTREAM_CODEC_LZ);
+	memset(span->data, 0xFF, span_get_size(&span->span_base));
+	UT_ASSERTeq(pmemstream_entry_read(env.stream, entry, buffer, sizeof(buffer)), -1);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_codecs(path);
+
+	test_lz_entries(path, 0);
+	test_lz_entries(path, PMEMSTREAM_REGION_MULTI_WRITER);
+	test_lz_entries(path, PMEMSTREAM_REGION_ENTRY_ALIGN_64);
+
+	test_lz_saves_space(path);
+	test_uncompressed_paths(path);
+	test_custom_codec(path);
+	test_custom_codec_multi_writer(path);
+	test_corrupted_entry(path);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * entry_alignment - unit test for regions allocated with PMEMSTREAM_REGION_ENTRY_ALIGN_64 and
+ *			PMEMSTREAM_REGION_ENTRY_ALIGN_256 flags
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <string.h>
+
+#define MAX_ENTRY_SIZE 600
+#define BATCH_SIZE 4
+
+/* Sizes of appended entries - some of them would leave exactly 8 bytes of padding (entry metadata takes 16 bytes). */
+static const size_t entry_sizes[] = {1, 8, 40, 48, 56, 64, 100, 232, 240, 256, 300, 504, 512, 600};
+#define ENTRY_SIZES_COUNT (sizeof(entry_sizes) / sizeof(entry_sizes[0]))
+
+static size_t entry_size(size_t i)
+{
+	return entry_sizes[i % ENTRY_SIZES_COUNT];
+}
+
+static void fill_entry(uint8_t *data, size_t i)
+{
+	memset(data, (int)i, entry_size(i));
+}
+
+/* Entries are aligned in memory (their offsets are relative to the spans base, which might be aligned only to the
+ * block size). */
+static bool entry_is_aligned(struct pmemstream *stream, struct pmemstream_entry entry, size_t alignment)
+{
+	return (uintptr_t)span_offset_to_span_ptr(&stream->data, entry.offset) % alignment == 0;
+}
+
+/* Verifies that region contains 'count' entries created by fill_entry, each of them placed at 'alignment'. */
+static void verify_entries(struct pmemstream *stream, struct pmemstream_region region, size_t alignment, size_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	size_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERT(entry_is_aligned(stream, entry, alignment));
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), entry_size(i));
+
+		const uint8_t *data = pmemstream_entry_data(stream, entry);
+		for (size_t j = 0; j < entry_size(i); j++) {
+			UT_ASSERTeq(data[j], (uint8_t)i);
+		}
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* Appends 'count' entries, starting from i-th one, using append, batch append and reserve/publish. */
+static void append_entries(struct pmemstream *stream, struct pmemstream_region region, size_t alignment, size_t i,
+			   size_t count)
+{
+	uint8_t data[BATCH_SIZE][MAX_ENTRY_SIZE];
+	const size_t end = i + count;
+	while (i < end) {
+		struct pmemstream_entry entries[BATCH_SIZE];
+		if (i % 3 == 0) {
+			fill_entry(data[0], i);
+			UT_ASSERTeq(pmemstream_append(stream, region, NULL, data[0], entry_size(i), &entries[0]), 0);
+			UT_ASSERT(entry_is_aligned(stream, entries[0], alignment));
+			i++;
+		} else if (i % 3 == 1 && i + BATCH_SIZE <= end) {
+			const void *batch_data[BATCH_SIZE];
+			size_t sizes[BATCH_SIZE];
+			for (size_t j = 0; j < BATCH_SIZE; j++) {
+				fill_entry(data[j], i + j);
+				batch_data[j] = data[j];
+				sizes[j] = entry_size(i + j);
+			}
+			int ret = pmemstream_append_batch(stream, region, NULL, batch_data, sizes, BATCH_SIZE, entries);
+			UT_ASSERTeq(ret, 0);
+			for (size_t j = 0; j < BATCH_SIZE; j++) {
+				UT_ASSERT(entry_is_aligned(stream, entries[j], alignment));
+			}
+			i += BATCH_SIZE;
+		} else {
+			/* Entry is reserved with the maximal size and published with the actual one. */
+			void *reserved_data;
+			int ret = pmemstream_reserve(stream, region, NULL, MAX_ENTRY_SIZE, &entries[0], &reserved_data);
+			UT_ASSERTeq(ret, 0);
+			UT_ASSERT(entry_is_aligned(stream, entries[0], alignment));
+			fill_entry(reserved_data, i);
+			UT_ASSERTeq(pmemstream_publish(stream, region, NULL, entries[0], entry_size(i)), 0);
+			i++;
+		}
+	}
+}
+
+void test_invalid_flags(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	uint64_t flags = PMEMSTREAM_REGION_ENTRY_ALIGN_64 | PMEMSTREAM_REGION_ENTRY_ALIGN_256;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), -1);
+
+	pmemstream_test_teardown(env);
+}
+
+static pmemstream_test_env make_stream(char *path, size_t block_size)
+{
+	pmemstream_test_env env;
+	env.map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(env.map, NULL);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, block_size, env.map), 0);
+	return env;
+}
+
+void test_aligned_entries(char *path, size_t block_size, uint64_t flags, size_t alignment)
+{
+	pmemstream_test_env env = make_stream(path, block_size);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	/* Empty region. */
+	verify_entries(env.stream, region, alignment, 0);
+
+	const size_t count = 5 * ENTRY_SIZES_COUNT;
+	append_entries(env.stream, region, alignment, 0, count);
+	verify_entries(env.stream, region, alignment, count);
+
+	/* Region recovery must find the end of data past the last padding. */
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, block_size, env.map), 0);
+	verify_entries(env.stream, region, alignment, count);
+
+	append_entries(env.stream, region, alignment, count, count);
+	verify_entries(env.stream, region, alignment, 2 * count);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Recovery of an empty region must not overwrite padding which precedes the first entry. */
+void test_empty_region_recovery(char *path, uint64_t flags, size_t alignment)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	append_entries(env.stream, region, alignment, 0, ENTRY_SIZES_COUNT);
+	verify_entries(env.stream, region, alignment, ENTRY_SIZES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_flags(path);
+
+	/* With small block sizes, the spans base (right after the stream header) is not aligned to 256 bytes. */
+	const size_t block_sizes[] = {64, 128, TEST_DEFAULT_BLOCK_SIZE};
+	for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+		size_t block_size = block_sizes[i];
+		const uint64_t multi_writer = PMEMSTREAM_REGION_MULTI_WRITER;
+		test_aligned_entries(path, block_size, PMEMSTREAM_REGION_ENTRY_ALIGN_64, 64);
+		test_aligned_entries(path, block_size, PMEMSTREAM_REGION_ENTRY_ALIGN_256, 256);
+		test_aligned_entries(path, block_size, PMEMSTREAM_REGION_ENTRY_ALIGN_64 | multi_writer, 64);
+		test_aligned_entries(path, block_size, PMEMSTREAM_REGION_ENTRY_ALIGN_256 | multi_writer, 256);
+	}
+
+	test_empty_region_recovery(path, PMEMSTREAM_REGION_ENTRY_ALIGN_256, 256);
+	test_empty_region_recovery(path, PMEMSTREAM_REGION_ENTRY_ALIGN_256 | PMEMSTREAM_REGION_MULTI_WRITER, 256);
+
+	return 0;
+}
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * entry_checksums - unit test for regions allocated with PMEMSTREAM_REGION_ENTRY_CHECKSUMS flag
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <string.h>
+
+#define MAX_ENTRY_SIZE 1000
+#define BATCH_SIZE 4
+#define ENTRIES_COUNT 100
+#define TORN_ENTRY_INDEX 42
+#define LOST_ENTRIES_INDEX 10
+#define OTHER_ENTRIES_COUNT 5
+
+static const size_t entry_sizes[] = {0, 1, 8, 33, 64, 100, 256, MAX_ENTRY_SIZE};
+#define ENTRY_SIZES_COUNT (sizeof(entry_sizes) / sizeof(entry_sizes[0]))
+
+static size_t entry_size(size_t i)
+{
+	return entry_sizes[i % ENTRY_SIZES_COUNT];
+}
+
+static void fill_entry(uint8_t *data, size_t i)
+{
+	memset(data, (int)i, entry_size(i));
+}
+
+/* Verifies that region contains 'count' entries created by fill_entry (skipping entry with 'skipped_index'), each of
+ * them with a valid checksum. */
+static void verify_entries(struct pmemstream *stream, struct pmemstream_region region, size_t count,
+			   size_t skipped_index)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	size_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		if (i == skipped_index) {
+			i++;
+		}
+
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), entry_size(i));
+
+		const uint8_t *data = pmemstream_entry_data(stream, entry);
+		for (size_t j = 0; j < entry_size(i); j++) {
+			UT_ASSERTeq(data[j], (uint8_t)i);
+		}
+
+		const struct span_checksummed_entry *span =
+			(const struct span_checksummed_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
+		UT_ASSERT(span_entry_has_checksum(&span->span_base));
+		UT_ASSERTeq(span->checksum, span_checksummed_entry_checksum(span));
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* Appends 'count' entries, starting from i-th one, using append, batch append and reserve/publish. */
+static void append_entries(struct pmemstream *stream, struct pmemstream_region region, size_t i, size_t count)
+{
+	static uint8_t data[BATCH_SIZE][MAX_ENTRY_SIZE];
+	const size_t end = i + count;
+	while (i < end) {
+		if (i % 3 == 0) {
+			fill_entry(data[0], i);
+			UT_ASSERTeq(pmemstream_append(stream, region, NULL, data[0], entry_size(i), NULL), 0);
+			i++;
+		} else if (i % 3 == 1 && i + BATCH_SIZE <= end) {
+			const void *batch_data[BATCH_SIZE];
+			size_t sizes[BATCH_SIZE];
+			for (size_t j = 0; j < BATCH_SIZE; j++) {
+				fill_entry(data[j], i + j);
+				batch_data[j] = data[j];
+				sizes[j] = entry_size(i + j);
+			}
+			int ret = pmemstream_append_batch(stream, region, NULL, batch_data, sizes, BATCH_SIZE, NULL);
+			UT_ASSERTeq(ret, 0);
+			i += BATCH_SIZE;
+		} else {
+			/* Entry is reserved with the maximal size and published with the actual one. */
+			struct pmemstream_entry entry;
+			void *reserved_data;
+			int ret = pmemstream_reserve(stream, region, NULL, MAX_ENTRY_SIZE, &entry, &reserved_data);
+			UT_ASSERTeq(ret, 0);
+			fill_entry(reserved_data, i);
+			UT_ASSERTeq(pmemstream_publish(stream, region, NULL, entry, entry_size(i)), 0);
+			i++;
+		}
+	}
+}
+
+/* Returns i-th entry of the region. */
+static struct pmemstream_entry get_entry(struct pmemstream *stream, struct pmemstream_region region, size_t i)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+	pmemstream_entry_iterator_seek_first(it);
+	for (size_t j = 0; j < i; j++) {
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+		pmemstream_entry_iterator_next(it);
+	}
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+	pmemstream_entry_iterator_delete(&it);
+	return entry;
+}
+
+void test_invalid_flags(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	uint64_t flags = PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_COMPACT_ENTRIES;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), -1);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_entries(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	append_entries(env.stream, region, 0, ENTRIES_COUNT);
+	verify_entries(env.stream, region, ENTRIES_COUNT, SIZE_MAX);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_entries(env.stream, region, ENTRIES_COUNT, SIZE_MAX);
+
+	append_entries(env.stream, region, ENTRIES_COUNT, ENTRIES_COUNT);
+	verify_entries(env.stream, region, 2 * ENTRIES_COUNT, SIZE_MAX);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Entry which was not written completely before a crash (simulated by corrupting its data) is detected by recovery.
+ * In single-writer regions, recovery truncates the region at such an entry, in multi-writer regions only the entry
+ * itself is skipped. */
+void test_torn_entry(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	append_entries(env.stream, region, 0, ENTRIES_COUNT);
+
+	UT_ASSERT(entry_size(TORN_ENTRY_INDEX) > 0);
+	struct pmemstream_entry torn_entry = get_entry(env.stream, region, TORN_ENTRY_INDEX);
+	uint8_t *data = (uint8_t *)pmemstream_entry_data(env.stream, torn_entry);
+	data[entry_size(TORN_ENTRY_INDEX) - 1]++;
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	if (flags & PMEMSTREAM_REGION_MULTI_WRITER) {
+		verify_entries(env.stream, region, ENTRIES_COUNT, TORN_ENTRY_INDEX);
+	} else {
+		verify_entries(env.stream, region, TORN_ENTRY_INDEX, SIZE_MAX);
+
+		/* New entries are appended in place of the torn one. */
+		append_entries(env.stream, region, TORN_ENTRY_INDEX, ENTRIES_COUNT);
+		verify_entries(env.stream, region, TORN_ENTRY_INDEX + ENTRIES_COUNT, SIZE_MAX);
+	}
+
+	pmemstream_test_teardown(env);
+}
+
+static size_t drain_count;
+static struct pmemstream_runtime original_runtime;
+
+static void counting_drain(void)
+{
+	drain_count++;
+	original_runtime.drain();
+}
+
+static void counting_persist(const void *ptr, size_t size)
+{
+	drain_count++;
+	original_runtime.persist(ptr, size);
+}
+
+/* Returns number of drains (including persists) issued by a synchronous append to a region allocated with 'flags'. */
+static size_t count_append_drains(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	/* Region is initialized for write on the first append. */
+	uint64_t value = 0;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL), 0);
+
+	original_runtime = env.stream->data;
+	env.stream->data.drain = counting_drain;
+	env.stream->data.persist = counting_persist;
+	drain_count = 0;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL), 0);
+	env.stream->data = original_runtime;
+
+	pmemstream_test_teardown(env);
+	return drain_count;
+}
+
+/* Entry data and persisted timestamp are persisted with a single drain. In multi-writer regions, claim of the entry's
+ * space is persisted along with the entry, on commit. */
+void test_single_drain(char *path)
+{
+	UT_ASSERTeq(count_append_drains(path, 0), 2);
+	UT_ASSERTeq(count_append_drains(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS), 1);
+
+	UT_ASSERTeq(count_append_drains(path, PMEMSTREAM_REGION_MULTI_WRITER), 2);
+	UT_ASSERTeq(count_append_drains(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_MULTI_WRITER), 1);
+}
+
+/* Tracks durability of the metadata of a single span (at 'watched'), written through the hooked runtime functions.
+ * 'watched_before_drain' is its durable content just before the first drain which made a new content durable. */
+static uint8_t *watched;
+static uint8_t watched_durable[sizeof(struct span_entry)];
+static uint8_t watched_before_drain[sizeof(struct span_entry)];
+static bool watched_flushed;
+static bool watched_drained;
+
+static bool overlaps_watched(const void *ptr, size_t size)
+{
+	const uint8_t *begin = ptr;
+	return begin < watched + sizeof(watched_durable) && watched < begin + size;
+}
+
+static void watched_drain(void)
+{
+	if (!watched_flushed) {
+		return;
+	}
+	if (!watched_drained) {
+		memcpy(watched_before_drain, watched_durable, sizeof(watched_durable));
+		watched_drained = true;
+	}
+	memcpy(watched_durable, watched, sizeof(watched_durable));
+	watched_flushed = false;
+}
+
+static void watching_flush(const void *ptr, size_t size)
+{
+	original_runtime.flush(ptr, size);
+	watched_flushed = watched_flushed || overlaps_watched(ptr, size);
+}
+
+static void watching_drain(void)
+{
+	original_runtime.drain();
+	watched_drain();
+}
+
+static void watching_persist(const void *ptr, size_t size)
+{
+	original_runtime.persist(ptr, size);
+	watching_flush(ptr, size);
+	watched_drain();
+}
+
+static void *watching_memset(void *dest, int c, size_t len, unsigned flags)
+{
+	void *ret = original_runtime.memset(dest, c, len, flags);
+	watching_flush(dest, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN)) {
+		watched_drain();
+	}
+	return ret;
+}
+
+static void *watching_memcpy(void *dest, const void *src, size_t len, unsigned flags)
+{
+	void *ret = original_runtime.memcpy(dest, src, len, flags);
+	watching_flush(dest, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN)) {
+		watched_drain();
+	}
+	return ret;
+}
+
+/* Space beyond a recovered tail (holding stale entries with valid checksums) is reused by new entries. Persisted
+ * timestamp is made durable by the same drain as the new entry and metadata of the span following it - crash in
+ * which only the former two survive must not resurrect any stale entry. Timestamps of stale entries are reused after
+ * the first crash, so they can't be told apart from the new ones. */
+void test_crash_after_reusing_space(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	struct pmemstream_region other_region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE,
+							  PMEMSTREAM_REGION_ENTRY_CHECKSUMS, &region),
+		    0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &other_region), 0);
+
+	/* First crash: only LOST_ENTRIES_INDEX first entries survive. */
+	struct pmemstream_entry entries[ENTRIES_COUNT];
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &i, sizeof(i), &entries[i]), 0);
+	}
+	uint64_t persisted_timestamp = pmemstream_entry_timestamp(env.stream, entries[LOST_ENTRIES_INDEX - 1]);
+	struct pmemstream_header *header = env.stream->header;
+	pmemstream_delete(&env.stream);
+	for (size_t i = 0; i < PMEMSTREAM_PERSISTED_TIMESTAMP_LANES; i++) {
+		header->persisted_timestamps[i].timestamp = persisted_timestamp;
+	}
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	/* Entries appended to the other region make timestamps of the stale entries smaller than the new ones. */
+	for (uint64_t i = 0; i < OTHER_ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(env.stream, other_region, NULL, &i, sizeof(i), NULL), 0);
+	}
+
+	/* The new entry takes place of the first stale one, metadata of the second stale one is cleared. */
+	watched = (uint8_t *)span_offset_to_span_ptr(&env.stream->data, entries[LOST_ENTRIES_INDEX + 1].offset);
+	memcpy(watched_durable, watched, sizeof(watched_durable));
+	watched_flushed = false;
+	watched_drained = false;
+
+	original_runtime = env.stream->data;
+	env.stream->data.flush = watching_flush;
+	env.stream->data.drain = watching_drain;
+	env.stream->data.persist = watching_persist;
+	env.stream->data.memset = watching_memset;
+	env.stream->data.memcpy = watching_memcpy;
+
+	uint64_t value = ENTRIES_COUNT;
+	struct pmemstream_entry entry;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &value, sizeof(value), &entry), 0);
+	UT_ASSERTeq(entry.offset, entries[LOST_ENTRIES_INDEX].offset);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), pmemstream_entry_timestamp(env.stream, entry));
+
+	/* Second crash: the last drain was interrupted after making persisted timestamp durable. */
+	env.stream->data = original_runtime;
+	pmemstream_delete(&env.stream);
+	if (watched_drained) {
+		memcpy(watched, watched_before_drain, sizeof(watched_before_drain));
+	}
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		const uint64_t *data = pmemstream_entry_data(env.stream, pmemstream_entry_iterator_get(it));
+		UT_ASSERTeq(*data, count < LOST_ENTRIES_INDEX ? count : ENTRIES_COUNT);
+		count++;
+	}
+	UT_ASSERTeq(count, LOST_ENTRIES_INDEX + 1);
+	pmemstream_entry_iterator_delete(&it);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_flags(path);
+
+	test_entries(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS);
+	test_entries(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_MULTI_WRITER);
+	test_entries(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_ENTRY_ALIGN_256);
+	test_entries(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_ENTRY_ALIGN_64 |
+				   PMEMSTREAM_REGION_MULTI_WRITER);
+
+	test_torn_entry(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS);
+	test_torn_entry(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS | PMEMSTREAM_REGION_MULTI_WRITER);
+
+	test_single_drain(path);
+
+	test_crash_after_reusing_space(path);
+
+	return 0;
+}
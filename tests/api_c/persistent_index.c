@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * persistent_index - unit test for regions allocated with PMEMSTREAM_REGION_PERSISTENT_INDEX flag
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/* Must match REGION_PERSISTENT_INDEX_INTERVAL. */
+#define RECORDS_INTERVAL 256
+#define ENTRIES_COUNT 2000
+#define LOST_ENTRIES_COUNT 900
+
+static uint64_t timestamps[2 * ENTRIES_COUNT];
+
+/* Appends entries with values [first, first + count) and stores their timestamps. */
+static void append_values(struct pmemstream *stream, struct pmemstream_region region, uint64_t first, uint64_t count)
+{
+	for (uint64_t i = first; i < first + count; i++) {
+		struct pmemstream_entry entry;
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, &i, sizeof(i), &entry), 0);
+		timestamps[i] = pmemstream_entry_timestamp(stream, entry);
+	}
+}
+
+/* Persistent index of the region allocated by allocate_region. */
+static const struct span_region_index *persistent_index;
+
+static struct pmemstream_region allocate_region(struct pmemstream *stream, size_t size, uint64_t flags)
+{
+	struct pmemstream_region region;
+	flags |= PMEMSTREAM_REGION_PERSISTENT_INDEX;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(stream, size, flags, &region), 0);
+
+	/* Index is placed right after the usable space of an empty region. */
+	uint64_t index_offset =
+		region.offset + offsetof(struct span_region, data) + pmemstream_region_usable_size(stream, region);
+	UT_ASSERTeq(index_offset % CACHELINE_SIZE, 0);
+	persistent_index = (const struct span_region_index *)span_offset_to_span_ptr(&stream->data, index_offset);
+
+	return region;
+}
+
+/* Verifies that region contains entries with values [0, count) and that each of them is found by seek. */
+static void verify_region(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), i);
+		UT_ASSERTeq(pmemstream_entry_timestamp(stream, entry), timestamps[i]);
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	for (i = count; i-- > 0;) {
+		pmemstream_entry_iterator_seek_timestamp(it, timestamps[i]);
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, pmemstream_entry_iterator_get(it)), i);
+	}
+	pmemstream_entry_iterator_seek_timestamp(it, timestamps[count - 1] + 1);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+static void reopen(pmemstream_test_env *env)
+{
+	pmemstream_delete(&env->stream);
+	UT_ASSERTeq(pmemstream_from_map(&env->stream, TEST_DEFAULT_BLOCK_SIZE, env->map), 0);
+}
+
+/* Index takes a small part of the region and it's empty after allocation (even if the region was used before). */
+void test_layout(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regular_region;
+	struct pmemstream_region indexed_region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regular_region), 0);
+	indexed_region = allocate_region(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, 0);
+
+	size_t regular_size = pmemstream_region_usable_size(env.stream, regular_region);
+	size_t indexed_size = pmemstream_region_usable_size(env.stream, indexed_region);
+	UT_ASSERT(indexed_size < regular_size);
+	UT_ASSERT(regular_size - indexed_size < regular_size / 100);
+	UT_ASSERTeq(persistent_index->records_count, 0);
+
+	append_values(env.stream, indexed_region, 0, ENTRIES_COUNT);
+	UT_ASSERTeq(persistent_index->records_count, (ENTRIES_COUNT - 1) / RECORDS_INTERVAL + 1);
+
+	UT_ASSERTeq(pmemstream_region_free(env.stream, indexed_region), 0);
+	indexed_region = allocate_region(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, 0);
+	UT_ASSERTeq(persistent_index->records_count, 0);
+	append_values(env.stream, indexed_region, 0, RECORDS_INTERVAL / 2);
+	verify_region(env.stream, indexed_region, RECORDS_INTERVAL / 2);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_reopen(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region = allocate_region(env.stream, TEST_DEFAULT_REGION_SIZE, flags);
+
+	append_values(env.stream, region, 0, ENTRIES_COUNT);
+	UT_ASSERTeq(persistent_index->records_count, (ENTRIES_COUNT - 1) / RECORDS_INTERVAL + 1);
+
+	reopen(&env);
+	verify_region(env.stream, region, ENTRIES_COUNT);
+
+	append_values(env.stream, region, ENTRIES_COUNT, ENTRIES_COUNT);
+	UT_ASSERTeq(persistent_index->records_count, (2 * ENTRIES_COUNT - 1) / RECORDS_INTERVAL + 1);
+
+	reopen(&env);
+	verify_region(env.stream, region, 2 * ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Recovery of a single-writer region starts at the entry described by the last record - entries preceding it are not
+ * examined (so it does not notice that one of them was overwritten). */
+void test_recovery_starts_at_last_record(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region = allocate_region(env.stream, TEST_DEFAULT_REGION_SIZE, 0);
+
+	append_values(env.stream, region, 0, ENTRIES_COUNT);
+	size_t usable_size = pmemstream_region_usable_size(env.stream, region);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+	pmemstream_entry_iterator_seek_timestamp(it, timestamps[1]);
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&env.stream->data, entry.offset);
+	pmemstream_entry_iterator_delete(&it);
+
+	reopen(&env);
+	span_entry->timestamp = UINT64_MAX;
+	UT_ASSERTeq(pmemstream_region_usable_size(env.stream, region), usable_size);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Records describing entries lost in a crash are dropped, new entries are recorded in their place. */
+void test_lost_entries(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region = allocate_region(env.stream, TEST_DEFAULT_REGION_SIZE, flags);
+
+	append_values(env.stream, region, 0, ENTRIES_COUNT);
+
+	/* Pretend that only LOST_ENTRIES_COUNT first entries were persisted before a crash. */
+	struct pmemstream_header *header = env.stream->header;
+	pmemstream_delete(&env.stream);
+	for (size_t i = 0; i < PMEMSTREAM_PERSISTED_TIMESTAMP_LANES; i++) {
+		header->persisted_timestamps[i].timestamp = timestamps[LOST_ENTRIES_COUNT - 1];
+	}
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	verify_region(env.stream, region, LOST_ENTRIES_COUNT);
+	UT_ASSERTeq(persistent_index->records_count, (LOST_ENTRIES_COUNT - 1) / RECORDS_INTERVAL + 1);
+
+	append_values(env.stream, region, LOST_ENTRIES_COUNT, ENTRIES_COUNT);
+	UT_ASSERTeq(persistent_index->records_count,
+		    (LOST_ENTRIES_COUNT + ENTRIES_COUNT - 1) / RECORDS_INTERVAL + 1);
+
+	reopen(&env);
+	verify_region(env.stream, region, LOST_ENTRIES_COUNT + ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_layout(path);
+
+	test_reopen(path, 0);
+	test_reopen(path, PMEMSTREAM_REGION_MULTI_WRITER);
+	test_reopen(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+	test_reopen(path, PMEMSTREAM_REGION_ENTRY_ALIGN_64);
+
+	test_recovery_starts_at_last_record(path);
+
+	test_lost_entries(path, 0);
+	test_lost_entries(path, PMEMSTREAM_REGION_MULTI_WRITER);
+
+	return 0;
+}
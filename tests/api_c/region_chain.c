@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * region_chain - unit test for pmemstream_region_chain_new, pmemstream_region_chain_append,
+ *		pmemstream_region_chain_entry_iterator_new
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define CHAIN_REGION_SIZE (4 * TEST_DEFAULT_BLOCK_SIZE)
+#define ENTRY_SIZE 512
+/* Entries span multiple regions. */
+#define ENTRIES_COUNT 200
+
+#define THREADS_COUNT 8
+#define ENTRIES_PER_THREAD 100
+
+struct entry_data {
+	uint64_t thread_id;
+	uint64_t value;
+	uint8_t payload[ENTRY_SIZE - 2 * sizeof(uint64_t)];
+};
+
+static void append_value(struct pmemstream_region_chain *chain, uint64_t thread_id, uint64_t value)
+{
+	struct entry_data data = {.thread_id = thread_id, .value = value};
+	memset(data.payload, (int)value, sizeof(data.payload));
+	UT_ASSERTeq(pmemstream_region_chain_append(chain, &data, sizeof(data), NULL), 0);
+}
+
+static const struct entry_data *iterator_data(struct pmemstream *stream, struct pmemstream_entry_iterator *it)
+{
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+	UT_ASSERTeq(pmemstream_entry_size(stream, entry), sizeof(struct entry_data));
+	return pmemstream_entry_data(stream, entry);
+}
+
+/* Verifies that chain contains entries with values 0, 1, ..., count - 1. */
+static void verify_chain(struct pmemstream *stream, struct pmemstream_region_chain *chain, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(&it, chain), 0);
+
+	uint64_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		const struct entry_data *data = iterator_data(stream, it);
+		UT_ASSERTeq(data->value, i);
+		UT_ASSERTeq(data->payload[sizeof(data->payload) - 1], (uint8_t)i);
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void test_invalid_args(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region head;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAIN_REGION_SIZE, &head), 0);
+
+	struct pmemstream_region_chain *chain;
+	UT_ASSERTeq(pmemstream_region_chain_new(NULL, env.stream, head), -1);
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, NULL, head), -1);
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+
+	/* Entry must fit into a single region. */
+	static uint8_t big_entry[2 * CHAIN_REGION_SIZE];
+	UT_ASSERTeq(pmemstream_region_chain_append(NULL, big_entry, sizeof(uint64_t), NULL), -1);
+	UT_ASSERTeq(pmemstream_region_chain_append(chain, big_entry, sizeof(big_entry), NULL), -1);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(NULL, chain), -1);
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(&it, NULL), -1);
+
+	pmemstream_region_chain_delete(&chain);
+	UT_ASSERTeq(chain, NULL);
+	pmemstream_region_chain_delete(NULL);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Appends entries spanning multiple regions, while iterator follows them. Then reopens the chain and continues. */
+void test_single_writer(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region head;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAIN_REGION_SIZE, &head), 0);
+
+	struct pmemstream_region_chain *chain;
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(&it, chain), 0);
+	pmemstream_entry_iterator_seek_first(it);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		append_value(chain, 0, i);
+
+		if (i == 0) {
+			pmemstream_entry_iterator_seek_first(it);
+		} else {
+			pmemstream_entry_iterator_next(it);
+		}
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+		UT_ASSERTeq(iterator_data(env.stream, it)->value, i);
+	}
+	pmemstream_entry_iterator_delete(&it);
+
+	verify_chain(env.stream, chain, ENTRIES_COUNT);
+	pmemstream_region_chain_delete(&chain);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+	verify_chain(env.stream, chain, ENTRIES_COUNT);
+	for (uint64_t i = ENTRIES_COUNT; i < 2 * ENTRIES_COUNT; i++) {
+		append_value(chain, 0, i);
+	}
+	verify_chain(env.stream, chain, 2 * ENTRIES_COUNT);
+	pmemstream_region_chain_delete(&chain);
+
+	pmemstream_test_teardown(env);
+}
+
+static size_t regions_count(struct pmemstream *stream)
+{
+	struct pmemstream_region_iterator *it;
+	UT_ASSERTeq(pmemstream_region_iterator_new(&it, stream), 0);
+
+	size_t count = 0;
+	for (pmemstream_region_iterator_seek_first(it); pmemstream_region_iterator_is_valid(it) == 0;
+	     pmemstream_region_iterator_next(it)) {
+		count++;
+	}
+
+	pmemstream_region_iterator_delete(&it);
+	return count;
+}
+
+/* Region allocated in advance is linked to the chain on reopen, if a crash happened before it was linked (instead of
+ * being leaked). */
+void test_crash_before_link(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region head;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAIN_REGION_SIZE, &head), 0);
+
+	struct pmemstream_region_chain *chain;
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+	append_value(chain, 0, 0);
+	pmemstream_region_chain_delete(&chain);
+
+	struct span_region *span_head = (struct span_region *)span_offset_to_span_ptr(&env.stream->data, head.offset);
+	uint64_t next_offset = span_head->next_chained_region;
+	UT_ASSERTne(next_offset, PMEMSTREAM_INVALID_OFFSET);
+	UT_ASSERTeq(regions_count(env.stream), 2);
+
+	/* Pretend that the next region was allocated, but not linked before a crash. */
+	pmemstream_delete(&env.stream);
+	span_head->next_chained_region = PMEMSTREAM_INVALID_OFFSET;
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+	UT_ASSERTeq(span_head->next_chained_region, next_offset);
+	UT_ASSERTeq(regions_count(env.stream), 2);
+
+	for (uint64_t i = 1; i < ENTRIES_COUNT; i++) {
+		append_value(chain, 0, i);
+	}
+	verify_chain(env.stream, chain, ENTRIES_COUNT);
+	pmemstream_region_chain_delete(&chain);
+
+	pmemstream_test_teardown(env);
+}
+
+struct thread_args {
+	struct pmemstream_region_chain *chain;
+	uint64_t thread_id;
+};
+
+static void *append_thread(void *arg)
+{
+	struct thread_args *args = arg;
+	for (uint64_t i = 0; i < ENTRIES_PER_THREAD; i++) {
+		append_value(args->chain, args->thread_id, i);
+	}
+	return NULL;
+}
+
+/* Verifies that entries of each thread are placed in the chain in order of appends. */
+static void verify_multi_writer_chain(struct pmemstream *stream, struct pmemstream_region_chain *chain)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(&it, chain), 0);
+
+	uint64_t next_values[THREADS_COUNT] = {0};
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		const struct entry_data *data = iterator_data(stream, it);
+		UT_ASSERT(data->thread_id < THREADS_COUNT);
+		UT_ASSERTeq(data->value, next_values[data->thread_id]);
+		next_values[data->thread_id]++;
+	}
+	for (size_t t = 0; t < THREADS_COUNT; t++) {
+		UT_ASSERTeq(next_values[t], ENTRIES_PER_THREAD);
+	}
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void test_multi_writer(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region head;
+	int ret = pmemstream_region_allocate_with_flags(env.stream, CHAIN_REGION_SIZE, PMEMSTREAM_REGION_MULTI_WRITER,
+							&head);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_region_chain *chain;
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+
+	pthread_t threads[THREADS_COUNT];
+	struct thread_args args[THREADS_COUNT];
+	for (size_t t = 0; t < THREADS_COUNT; t++) {
+		args[t].chain = chain;
+		args[t].thread_id = t;
+		UT_ASSERTeq(pthread_create(&threads[t], NULL, append_thread, &args[t]), 0);
+	}
+	for (size_t t = 0; t < THREADS_COUNT; t++) {
+		UT_ASSERTeq(pthread_join(threads[t], NULL), 0);
+	}
+
+	verify_multi_writer_chain(env.stream, chain);
+	pmemstream_region_chain_delete(&chain);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+	verify_multi_writer_chain(env.stream, chain);
+	pmemstream_region_chain_delete(&chain);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_args(path);
+	test_single_writer(path);
+	test_multi_writer(path);
+	test_crash_before_link(path);
+
+	return 0;
+}
@@ -2,13 +2,16 @@
 /* Copyright 2021-2022, Intel Corporation */
 
 #include "common/util.h"
+#include "libpmemstream_internal.h"
 #include "span.h"
 #include "stream_helpers.h"
 #include "unittest.h"
 #include <string.h>
 
 /**
- * reserve_and_publish - unit test for pmemstream_reserve, pmemstream_publish
+ * reserve_and_publish - unit test for pmemstream_reserve, pmemstream_publish, pmemstream_reserve_batch,
+ *			pmemstream_publish_batch, pmemstream_async_publish_batch (including publishing entries smaller
+ *			than their reservation and crashing with unpublished reservations)
  */
 
 struct entry_data {
@@ -165,6 +168,356 @@ void null_entry_test(char *path)
 	pmemstream_test_teardown(env);
 }
 
+#define BATCH_SIZE 8
+
+/* Reserves and publishes (synchronously or not) two batches of entries with values 0, 1, ..., 2 * BATCH_SIZE - 1. */
+static void publish_batches(struct pmemstream *stream, struct pmemstream_region region, bool async)
+{
+	size_t sizes[BATCH_SIZE];
+	struct pmemstream_entry entries[BATCH_SIZE];
+	void *data_addresses[BATCH_SIZE];
+	for (size_t i = 0; i < BATCH_SIZE; i++) {
+		sizes[i] = sizeof(struct entry_data) * (i + 1);
+	}
+
+	for (uint64_t batch = 0; batch < 2; batch++) {
+		int ret = pmemstream_reserve_batch(stream, region, NULL, sizes, BATCH_SIZE, entries, data_addresses);
+		UT_ASSERTeq(ret, 0);
+
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			struct entry_data data = {.data = batch * BATCH_SIZE + i};
+			memset(data_addresses[i], 0, sizes[i]);
+			memcpy(data_addresses[i], &data, sizeof(data));
+		}
+
+		if (async) {
+			ret = pmemstream_async_publish_batch(stream, region, NULL, entries, sizes, BATCH_SIZE);
+		} else {
+			ret = pmemstream_publish_batch(stream, region, NULL, entries, sizes, BATCH_SIZE);
+		}
+		UT_ASSERTeq(ret, 0);
+
+		uint64_t last_timestamp = pmemstream_entry_timestamp(stream, entries[BATCH_SIZE - 1]);
+		UT_ASSERTeq(pmemstream_entry_timestamp(stream, entries[0]) + BATCH_SIZE - 1, last_timestamp);
+		if (async) {
+			UT_ASSERTeq(pmemstream_wait_persisted(stream, last_timestamp), 0);
+		}
+		UT_ASSERT(last_timestamp <= pmemstream_persisted_timestamp(stream));
+	}
+}
+
+static void verify_batches(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), sizeof(struct entry_data) * (count % BATCH_SIZE + 1));
+		UT_ASSERTeq(((const struct entry_data *)pmemstream_entry_data(stream, entry))->data, count);
+		count++;
+	}
+	UT_ASSERTeq(count, 2 * BATCH_SIZE);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void batch_test(char *path, uint64_t flags, bool async)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region);
+	UT_ASSERTeq(ret, 0);
+
+	publish_batches(env.stream, region, async);
+	verify_batches(env.stream, region);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_batches(env.stream, region);
+
+	pmemstream_test_teardown(env);
+}
+
+void invalid_batch_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	size_t sizes[2] = {sizeof(struct entry_data), sizeof(struct entry_data)};
+	struct pmemstream_entry entries[2];
+	void *data_addresses[2];
+
+	UT_ASSERTeq(pmemstream_reserve_batch(NULL, region, NULL, sizes, 2, entries, data_addresses), -1);
+	UT_ASSERTeq(pmemstream_reserve_batch(env.stream, region, NULL, NULL, 2, entries, data_addresses), -1);
+	UT_ASSERTeq(pmemstream_reserve_batch(env.stream, region, NULL, sizes, 2, NULL, data_addresses), -1);
+	UT_ASSERTeq(pmemstream_reserve_batch(env.stream, region, NULL, sizes, 2, entries, NULL), -1);
+	UT_ASSERTeq(pmemstream_reserve_batch(env.stream, region, NULL, sizes, 0, entries, data_addresses), -1);
+
+	ret = pmemstream_reserve_batch(env.stream, region, NULL, sizes, 2, entries, data_addresses);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERTeq(pmemstream_publish_batch(NULL, region, NULL, entries, sizes, 2), -1);
+	UT_ASSERTeq(pmemstream_publish_batch(env.stream, region, NULL, NULL, sizes, 2), -1);
+	UT_ASSERTeq(pmemstream_publish_batch(env.stream, region, NULL, entries, NULL, 2), -1);
+	UT_ASSERTeq(pmemstream_async_publish_batch(env.stream, region, NULL, entries, sizes, 0), -1);
+
+	/* Entries are not placed contiguously. */
+	struct pmemstream_entry swapped_entries[2] = {entries[1], entries[0]};
+	UT_ASSERTeq(pmemstream_publish_batch(env.stream, region, NULL, swapped_entries, sizes, 2), -1);
+
+	UT_ASSERTeq(pmemstream_publish_batch(env.stream, region, NULL, entries, sizes, 2), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+#define SHRINK_ENTRIES 16
+
+/* Each entry consists of 'i % BATCH_SIZE + 1' values equal to 'i'. In multi-writer regions, reservation can't be
+ * shrunk by exactly one value (unused space would be too small to be skipped as padding). */
+static size_t shrunk_entry_values(uint64_t i, uint64_t flags)
+{
+	size_t values = i % BATCH_SIZE + 1;
+	if ((flags & PMEMSTREAM_REGION_MULTI_WRITER) && values == BATCH_SIZE - 1) {
+		return BATCH_SIZE;
+	}
+	return values;
+}
+
+static void verify_shrunk_entries(struct pmemstream *stream, struct pmemstream_region region, uint64_t flags)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		size_t values = shrunk_entry_values(count, flags);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), sizeof(struct entry_data) * values);
+
+		const struct entry_data *data = pmemstream_entry_data(stream, entry);
+		for (size_t v = 0; v < values; v++) {
+			UT_ASSERTeq(data[v].data, count);
+		}
+		count++;
+	}
+	UT_ASSERTeq(count, SHRINK_ENTRIES);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* Reserves space for the biggest possible entry and publishes only the part which was actually written. */
+void shrink_test(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region);
+	UT_ASSERTeq(ret, 0);
+
+	const size_t max_size = sizeof(struct entry_data) * BATCH_SIZE;
+	uint64_t next_offset = PMEMSTREAM_INVALID_OFFSET;
+	for (uint64_t i = 0; i < SHRINK_ENTRIES; i++) {
+		struct pmemstream_entry entry;
+		struct entry_data *data;
+		size_t values = shrunk_entry_values(i, flags);
+
+		/* Entry can't be bigger than its reservation (nor, in multi-writer regions, leave exactly 8 bytes of
+		 * it unused). Publishing fails and releases the reservation, so it does not hide entries published
+		 * afterwards. */
+		ret = pmemstream_reserve(env.stream, region, NULL, max_size, &entry, (void **)&data);
+		UT_ASSERTeq(ret, 0);
+		ret = pmemstream_publish(env.stream, region, NULL, entry, max_size + sizeof(struct entry_data));
+		UT_ASSERTeq(ret, -1);
+		if (values != i % BATCH_SIZE + 1) {
+			ret = pmemstream_reserve(env.stream, region, NULL, max_size, &entry, (void **)&data);
+			UT_ASSERTeq(ret, 0);
+			ret = pmemstream_publish(env.stream, region, NULL, entry, max_size - sizeof(struct entry_data));
+			UT_ASSERTeq(ret, -1);
+		}
+
+		ret = pmemstream_reserve(env.stream, region, NULL, max_size, &entry, (void **)&data);
+		UT_ASSERTeq(ret, 0);
+
+		/* In single-writer regions, unused (and released) space is reused by the next entry. */
+		if (!(flags & PMEMSTREAM_REGION_MULTI_WRITER) && next_offset != PMEMSTREAM_INVALID_OFFSET) {
+			UT_ASSERTeq(entry.offset, next_offset);
+		}
+
+		for (size_t v = 0; v < values; v++) {
+			data[v].data = i;
+		}
+
+		size_t size = sizeof(struct entry_data) * values;
+		if (i % 2) {
+			ret = pmemstream_publish(env.stream, region, NULL, entry, size);
+		} else {
+			ret = pmemstream_async_publish(env.stream, region, NULL, entry, size);
+		}
+		UT_ASSERTeq(ret, 0);
+		next_offset = entry.offset + sizeof(struct span_entry) + size;
+	}
+	verify_shrunk_entries(env.stream, region, flags);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_shrunk_entries(env.stream, region, flags);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Durable content of the stream, maintained through hooked runtime functions: flushed ranges become durable on drain
+ * (the same is true for ranges written by memcpy/memset with PMEM2_F_MEM_NODRAIN flag). */
+#define MAX_PENDING_FLUSHES 1024
+static struct pmemstream_runtime original_runtime;
+static uint8_t *durable_image;
+static uint8_t *image_base;
+static struct {
+	const uint8_t *ptr;
+	size_t size;
+} pending_flushes[MAX_PENDING_FLUSHES];
+static size_t pending_flushes_count;
+static size_t drain_count;
+
+static void make_durable(const void *ptr, size_t size)
+{
+	const uint8_t *src = ptr;
+	memcpy(durable_image + (src - image_base), src, size);
+}
+
+static void tracking_flush(const void *ptr, size_t size)
+{
+	original_runtime.flush(ptr, size);
+	UT_ASSERT(pending_flushes_count < MAX_PENDING_FLUSHES);
+	pending_flushes[pending_flushes_count].ptr = ptr;
+	pending_flushes[pending_flushes_count].size = size;
+	pending_flushes_count++;
+}
+
+static void tracking_drain(void)
+{
+	original_runtime.drain();
+	for (size_t i = 0; i < pending_flushes_count; i++) {
+		make_durable(pending_flushes[i].ptr, pending_flushes[i].size);
+	}
+	pending_flushes_count = 0;
+	drain_count++;
+}
+
+static void tracking_persist(const void *ptr, size_t size)
+{
+	tracking_flush(ptr, size);
+	tracking_drain();
+}
+
+static void tracking_written(void *dest, size_t len, unsigned flags)
+{
+	if (flags & PMEM2_F_MEM_NODRAIN) {
+		tracking_flush(dest, len);
+	} else {
+		make_durable(dest, len);
+	}
+}
+
+static void *tracking_memcpy(void *dest, const void *src, size_t len, unsigned flags)
+{
+	void *ret = original_runtime.memcpy(dest, src, len, flags);
+	tracking_written(dest, len, flags);
+	return ret;
+}
+
+static void *tracking_memset(void *dest, int c, size_t len, unsigned flags)
+{
+	void *ret = original_runtime.memset(dest, c, len, flags);
+	tracking_written(dest, len, flags);
+	return ret;
+}
+
+static void verify_values(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t i = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(((const struct entry_data *)pmemstream_entry_data(stream, entry))->data, i);
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+/* In multi-writer regions, reservations are not persisted (nor drained) - claims of entries reserved before
+ * a committed entry are persisted along with it, so that recovery can walk past them after a crash. */
+void unpublished_reservations_crash_test(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	flags |= PMEMSTREAM_REGION_MULTI_WRITER;
+	int ret = pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Region is initialized for write on the first append. */
+	struct entry_data data = {.data = 0};
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &data, sizeof(data), NULL), 0);
+
+	size_t image_size = pmem2_map_get_size(env.map);
+	image_base = pmem2_map_get_address(env.map);
+	durable_image = malloc(image_size);
+	UT_ASSERTne(durable_image, NULL);
+	memcpy(durable_image, image_base, image_size);
+
+	original_runtime = env.stream->data;
+	env.stream->data.memcpy = tracking_memcpy;
+	env.stream->data.memset = tracking_memset;
+	env.stream->data.flush = tracking_flush;
+	env.stream->data.drain = tracking_drain;
+	env.stream->data.persist = tracking_persist;
+	drain_count = 0;
+
+	struct pmemstream_entry entry;
+	void *data_address;
+	ret = pmemstream_reserve(env.stream, region, NULL, 3 * sizeof(struct entry_data), &entry, &data_address);
+	UT_ASSERTeq(ret, 0);
+
+	size_t sizes[] = {sizeof(struct entry_data), 3 * sizeof(struct entry_data), 5 * sizeof(struct entry_data)};
+	struct pmemstream_entry entries[3];
+	void *data_addresses[3];
+	ret = pmemstream_reserve_batch(env.stream, region, NULL, sizes, 3, entries, data_addresses);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(drain_count, 0);
+
+	data.data = 1;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &data, sizeof(data), NULL), 0);
+
+	/* Crash - only durable content survives. */
+	env.stream->data = original_runtime;
+	pmemstream_delete(&env.stream);
+	memcpy(image_base, durable_image, image_size);
+	free(durable_image);
+
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_values(env.stream, region, 2);
+
+	/* Region is still usable after recovery. */
+	data.data = 2;
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, &data, sizeof(data), NULL), 0);
+	verify_values(env.stream, region, 3);
+
+	pmemstream_test_teardown(env);
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 2) {
@@ -182,6 +535,16 @@ int main(int argc, char *argv[])
 	null_data_test(path);
 	zero_size_test(path);
 	null_entry_test(path);
+	batch_test(path, 0, false);
+	batch_test(path, 0, true);
+	batch_test(path, PMEMSTREAM_REGION_MULTI_WRITER, false);
+	batch_test(path, PMEMSTREAM_REGION_MULTI_WRITER, true);
+	invalid_batch_test(path);
+	shrink_test(path, 0);
+	shrink_test(path, PMEMSTREAM_REGION_MULTI_WRITER);
+	unpublished_reservations_crash_test(path, 0);
+	unpublished_reservations_crash_test(path, PMEMSTREAM_REGION_ENTRY_ALIGN_64);
+	unpublished_reservations_crash_test(path, PMEMSTREAM_REGION_ENTRY_CHECKSUMS);
 
 	return 0;
 }
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * seek_timestamp - unit test for pmemstream_entry_iterator_seek_timestamp
+ */
+
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#define CHAIN_REGION_SIZE (4 * TEST_DEFAULT_BLOCK_SIZE)
+/* Entries span many samples of the region index. */
+#define ENTRIES_COUNT 1000
+#define CHAIN_ENTRY_SIZE 512
+#define CHAIN_ENTRIES_COUNT 100
+
+static uint64_t timestamps[2 * ENTRIES_COUNT];
+
+/* Appends entries with values [first, first + count) and stores their timestamps. */
+static void append_values(struct pmemstream *stream, struct pmemstream_region region, uint64_t first, uint64_t count)
+{
+	for (uint64_t i = first; i < first + count; i++) {
+		struct pmemstream_entry entry;
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, &i, sizeof(i), &entry), 0);
+		timestamps[i] = pmemstream_entry_timestamp(stream, entry);
+	}
+}
+
+/* Seeks 'timestamp' and verifies that iterator points to the entry with 'expected' value. */
+static void verify_seek(struct pmemstream *stream, struct pmemstream_entry_iterator *it, uint64_t timestamp,
+			uint64_t expected)
+{
+	pmemstream_entry_iterator_seek_timestamp(it, timestamp);
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), expected);
+	UT_ASSERTeq(pmemstream_entry_timestamp(stream, entry), timestamps[expected]);
+}
+
+/* Seeks timestamps of all (and some between) entries of the region, containing values [0, count). */
+static void verify_seeks(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	verify_seek(stream, it, 0, 0);
+	/* Seek backwards, so that the index is built by the first seek and used by the following ones. */
+	for (uint64_t i = count; i-- > 0;) {
+		verify_seek(stream, it, timestamps[i], i);
+		if (i > 0 && timestamps[i] - timestamps[i - 1] > 1) {
+			verify_seek(stream, it, timestamps[i] - 1, i);
+		}
+	}
+
+	/* Iteration continues from the sought entry. */
+	verify_seek(stream, it, timestamps[count / 2], count / 2);
+	pmemstream_entry_iterator_next(it);
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(it), 0);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, pmemstream_entry_iterator_get(it)), count / 2 + 1);
+
+	pmemstream_entry_iterator_seek_timestamp(it, timestamps[count - 1] + 1);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void test_invalid_args(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	pmemstream_entry_iterator_seek_timestamp(NULL, 1);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+
+	/* Empty region. */
+	pmemstream_entry_iterator_seek_timestamp(it, 0);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+	pmemstream_entry_iterator_seek_timestamp(it, UINT64_MAX);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+
+	pmemstream_entry_iterator_delete(&it);
+	pmemstream_test_teardown(env);
+}
+
+void test_seek_timestamp(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	append_values(env.stream, region, 0, ENTRIES_COUNT);
+	verify_seeks(env.stream, region, ENTRIES_COUNT);
+
+	/* Index is extended with entries appended after it was built. */
+	append_values(env.stream, region, ENTRIES_COUNT, ENTRIES_COUNT);
+	verify_seeks(env.stream, region, 2 * ENTRIES_COUNT);
+
+	/* Index is rebuilt after reopening the stream. */
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_seeks(env.stream, region, 2 * ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Entries appended to other regions leave gaps in timestamps of the region. */
+void test_seek_timestamp_gaps(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	struct pmemstream_region other_region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &other_region), 0);
+
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		append_values(env.stream, region, i, 1);
+		for (uint64_t j = 0; j < i % 3; j++) {
+			UT_ASSERTeq(pmemstream_append(env.stream, other_region, NULL, &j, sizeof(j), NULL), 0);
+		}
+	}
+
+	verify_seeks(env.stream, region, ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_seek_timestamp_chain(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region head;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAIN_REGION_SIZE, &head), 0);
+
+	struct pmemstream_region_chain *chain;
+	UT_ASSERTeq(pmemstream_region_chain_new(&chain, env.stream, head), 0);
+
+	/* Entries span multiple regions. */
+	uint64_t data[CHAIN_ENTRY_SIZE / sizeof(uint64_t)] = {0};
+	for (uint64_t i = 0; i < CHAIN_ENTRIES_COUNT; i++) {
+		data[0] = i;
+		struct pmemstream_entry entry;
+		UT_ASSERTeq(pmemstream_region_chain_append(chain, data, sizeof(data), &entry), 0);
+		timestamps[i] = pmemstream_entry_timestamp(env.stream, entry);
+	}
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_region_chain_entry_iterator_new(&it, chain), 0);
+	for (uint64_t i = CHAIN_ENTRIES_COUNT; i-- > 0;) {
+		verify_seek(env.stream, it, timestamps[i], i);
+	}
+
+	/* Iteration follows the chain from the sought entry. */
+	verify_seek(env.stream, it, timestamps[1], 1);
+	uint64_t count = 1;
+	for (; pmemstream_entry_iterator_is_valid(it) == 0; pmemstream_entry_iterator_next(it)) {
+		const uint64_t *value = pmemstream_entry_data(env.stream, pmemstream_entry_iterator_get(it));
+		UT_ASSERTeq(*value, count);
+		count++;
+	}
+	UT_ASSERTeq(count, CHAIN_ENTRIES_COUNT);
+
+	pmemstream_entry_iterator_seek_timestamp(it, timestamps[CHAIN_ENTRIES_COUNT - 1] + 1);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(it), 0);
+
+	pmemstream_entry_iterator_delete(&it);
+	pmemstream_region_chain_delete(&chain);
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_args(path);
+
+	test_seek_timestamp(path, 0);
+	test_seek_timestamp(path, PMEMSTREAM_REGION_MULTI_WRITER);
+	test_seek_timestamp(path, PMEMSTREAM_REGION_COMPACT_ENTRIES);
+	test_seek_timestamp(path, PMEMSTREAM_REGION_ENTRY_ALIGN_64);
+
+	test_seek_timestamp_gaps(path);
+	test_seek_timestamp_chain(path);
+
+	return 0;
+}
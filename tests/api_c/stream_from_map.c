@@ -4,6 +4,8 @@
 #include "libpmemstream_internal.h"
 #include "unittest.h"
 
+#include <string.h>
+
 /**
  * stream_from_map - unit test for pmemstream_from_map and pmemstream_delete
  */
@@ -44,6 +46,85 @@ void test_stream_from_map_null_map(char *path)
 	pmemstream_delete(&s);
 }
 
+void test_stream_from_map_with_config(char *path, size_t max_concurrency)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, max_concurrency), 0);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map_with_config(&s, TEST_DEFAULT_BLOCK_SIZE, map, config), 0);
+	UT_ASSERTne(s, NULL);
+	pmemstream_config_delete(&config);
+	UT_ASSERTeq(config, NULL);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	/* Batch can not be bigger than the number of async operations' slots. */
+	uint64_t e = 0;
+	const void *data[] = {&e, &e, &e, &e};
+	const size_t sizes[] = {sizeof(e), sizeof(e), sizeof(e), sizeof(e)};
+	size_t count = sizeof(sizes) / sizeof(sizes[0]);
+	int ret = pmemstream_append_batch(s, region, NULL, data, sizes, count, NULL);
+	UT_ASSERTeq(ret, count > max_concurrency ? -1 : 0);
+
+	/* Each timestamp reuses (one of) the slots. */
+	for (e = 0; e < 4 * max_concurrency; e++) {
+		UT_ASSERTeq(pmemstream_append(s, region, NULL, &e, sizeof(e), NULL), 0);
+	}
+	UT_ASSERTeq(pmemstream_persisted_timestamp(s), 4 * max_concurrency + (count > max_concurrency ? 0 : count));
+
+	pmemstream_delete(&s);
+	pmem2_map_delete(&map);
+}
+
+/* Stream created with a different persistent layout (e.g. before the layout version was introduced, when it was 0)
+ * is rejected and left intact. */
+void test_stream_from_map_layout_version(char *path, uint64_t layout_version)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	size_t region_size = pmemstream_region_size(s, region);
+	struct pmemstream_header *header = s->header;
+	pmemstream_delete(&s);
+
+	header->layout_version = layout_version;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), -1);
+	UT_ASSERTeq(s, NULL);
+	UT_ASSERTeq(strcmp(header->signature, PMEMSTREAM_SIGNATURE), 0);
+
+	header->layout_version = PMEMSTREAM_LAYOUT_VERSION;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(pmemstream_region_size(s, region), region_size);
+
+	pmemstream_delete(&s);
+	pmem2_map_delete(&map);
+}
+
+void test_config_invalid_max_concurrency(size_t max_concurrency)
+{
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTne(pmemstream_config_set_max_concurrency(config, max_concurrency), 0);
+	pmemstream_config_delete(&config);
+}
+
+void test_null_config()
+{
+	UT_ASSERTeq(pmemstream_config_new(NULL), -1);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(NULL, 1), -1);
+	pmemstream_config_delete(NULL);
+}
+
 void test_null_stream()
 {
 	UT_ASSERTeq(pmemstream_from_map(NULL, TEST_DEFAULT_BLOCK_SIZE, NULL), -1);
@@ -75,5 +156,18 @@ int main(int argc, char *argv[])
 	test_stream_from_map_null_map(path);
 	test_null_stream();
 
+	test_stream_from_map_with_config(path, 1);
+	test_stream_from_map_with_config(path, 2);
+	test_stream_from_map_with_config(path, 64);
+	test_stream_from_map_with_config(path, 4096);
+	test_stream_from_map_layout_version(path, 0);
+	test_stream_from_map_layout_version(path, PMEMSTREAM_LAYOUT_VERSION + 1);
+
+	/* not a power of 2 */
+	test_config_invalid_max_concurrency(0);
+	test_config_invalid_max_concurrency(3);
+	test_config_invalid_max_concurrency(1000);
+	test_null_config();
+
 	return 0;
 }
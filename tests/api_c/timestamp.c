@@ -3,7 +3,9 @@
 
 /**
  * timestamp - unit test for pmemstream_entry_timestamp,
- *					pmemstream_committed_timestamp, pmemstream_persisted_timestamp
+ *					pmemstream_committed_timestamp, pmemstream_persisted_timestamp,
+ *					pmemstream_wait_committed, pmemstream_wait_persisted,
+ *					pmemstream_process_committed, pmemstream_process_persisted
  */
 
 #include "libpmemstream.h"
@@ -11,8 +13,13 @@
 #include "stream_helpers.h"
 #include "unittest.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
 
+#define THREADS_COUNT 16
+#define ENTRIES_PER_THREAD 100
+
 void null_stream_test(char *path)
 {
 	pmemstream_test_env env = pmemstream_test_make_default(path);
@@ -36,6 +43,11 @@ void null_stream_test(char *path)
 	timestamp = pmemstream_persisted_timestamp(NULL);
 	UT_ASSERTeq(timestamp, PMEMSTREAM_INVALID_TIMESTAMP);
 
+	UT_ASSERTeq(pmemstream_wait_committed(NULL, PMEMSTREAM_FIRST_TIMESTAMP), -1);
+	UT_ASSERTeq(pmemstream_wait_persisted(NULL, PMEMSTREAM_FIRST_TIMESTAMP), -1);
+	UT_ASSERTeq(pmemstream_process_committed(NULL), PMEMSTREAM_INVALID_TIMESTAMP);
+	UT_ASSERTeq(pmemstream_process_persisted(NULL), PMEMSTREAM_INVALID_TIMESTAMP);
+
 	pmemstream_test_teardown(env);
 }
 
@@ -48,6 +60,12 @@ void invalid_entry_test(char *path)
 	uint64_t timestamp = pmemstream_entry_timestamp(env.stream, invalid_entry);
 	UT_ASSERTeq(timestamp, PMEMSTREAM_INVALID_TIMESTAMP);
 
+	/* Waiting for timestamps which were not acquired would block forever. */
+	UT_ASSERTeq(pmemstream_wait_committed(env.stream, PMEMSTREAM_FIRST_TIMESTAMP), -1);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, UINT64_MAX), -1);
+	UT_ASSERTeq(pmemstream_wait_committed(env.stream, PMEMSTREAM_INVALID_TIMESTAMP), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, PMEMSTREAM_INVALID_TIMESTAMP), 0);
+
 	pmemstream_test_teardown(env);
 }
 
@@ -87,6 +105,343 @@ void check_timestamp_and_order(char *path)
 	pmemstream_test_teardown(env);
 }
 
+static size_t flush_count;
+
+static void counting_flush(const void *ptr, size_t size)
+{
+	(void)ptr;
+	(void)size;
+	++flush_count;
+}
+
+static void counting_drain(void)
+{
+	++flush_count;
+}
+
+static void counting_persist(const void *ptr, size_t size)
+{
+	(void)ptr;
+	(void)size;
+	++flush_count;
+}
+
+/* Reading persisted timestamp (and polling for already persisted one) should not flush anything. */
+void check_persisted_timestamp_read_does_not_flush(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t e = 0;
+	struct pmemstream_entry entry;
+	ret = pmemstream_append(env.stream, region, NULL, &e, sizeof(e), &entry);
+	UT_ASSERTeq(ret, 0);
+	uint64_t timestamp = pmemstream_entry_timestamp(env.stream, entry);
+
+	struct pmemstream_runtime data = env.stream->data;
+	env.stream->data.flush = counting_flush;
+	env.stream->data.drain = counting_drain;
+	env.stream->data.persist = counting_persist;
+	flush_count = 0;
+
+	for (int i = 0; i < 10; i++) {
+		UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), timestamp);
+
+		struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(env.stream, timestamp);
+		UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	}
+	UT_ASSERTeq(flush_count, 0);
+
+	env.stream->data = data;
+	pmemstream_test_teardown(env);
+}
+
+struct thread_args {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+};
+
+static void *append_thread(void *arg)
+{
+	struct thread_args *args = arg;
+	for (uint64_t e = 0; e < ENTRIES_PER_THREAD; e++) {
+		struct pmemstream_entry entry;
+		int ret = pmemstream_append(args->stream, args->region, NULL, &e, sizeof(e), &entry);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERT(pmemstream_entry_timestamp(args->stream, entry) <= pmemstream_persisted_timestamp(args->stream));
+	}
+
+	return NULL;
+}
+
+/* Persisted timestamp is stored in multiple lanes (updated by different threads). */
+void check_persisted_timestamp_multithreaded(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	pthread_t threads[THREADS_COUNT];
+	struct thread_args args[THREADS_COUNT];
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE / THREADS_COUNT / 2,
+						     &args[i].region);
+		UT_ASSERTeq(ret, 0);
+		args[i].stream = env.stream;
+	}
+
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_create(&threads[i], NULL, append_thread, &args[i]), 0);
+	}
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_join(threads[i], NULL), 0);
+	}
+
+	const uint64_t expected_timestamp = THREADS_COUNT * ENTRIES_PER_THREAD;
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), expected_timestamp);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), expected_timestamp);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), expected_timestamp);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), expected_timestamp);
+
+	/* New entries get timestamps bigger than all persisted ones. */
+	uint64_t e = 0;
+	struct pmemstream_entry entry;
+	UT_ASSERTeq(pmemstream_append(env.stream, args[0].region, NULL, &e, sizeof(e), &entry), 0);
+	UT_ASSERTeq(pmemstream_entry_timestamp(env.stream, entry), expected_timestamp + 1);
+
+	pmemstream_test_teardown(env);
+}
+
+struct wait_thread_args {
+	struct pmemstream *stream;
+	uint64_t first_timestamp;
+	bool persisted;
+};
+
+/* Waits for every THREADS_COUNT-th timestamp (starting from 'first_timestamp'), appended by other threads. */
+static void *wait_thread(void *arg)
+{
+	struct wait_thread_args *args = arg;
+	const uint64_t last_timestamp = THREADS_COUNT * ENTRIES_PER_THREAD;
+
+	uint64_t timestamp = args->first_timestamp;
+	while (timestamp <= last_timestamp) {
+		int ret = args->persisted ? pmemstream_wait_persisted(args->stream, timestamp)
+					  : pmemstream_wait_committed(args->stream, timestamp);
+		if (ret) {
+			/* Timestamp was not acquired yet. */
+			sched_yield();
+			continue;
+		}
+
+		UT_ASSERT(timestamp <= pmemstream_committed_timestamp(args->stream));
+		if (args->persisted) {
+			UT_ASSERT(timestamp <= pmemstream_persisted_timestamp(args->stream));
+		}
+		timestamp += THREADS_COUNT;
+	}
+
+	return NULL;
+}
+
+/* Pushes commits and persists forward until all entries are persisted. */
+static void *process_thread(void *arg)
+{
+	struct pmemstream *stream = arg;
+	const uint64_t last_timestamp = THREADS_COUNT * ENTRIES_PER_THREAD;
+
+	uint64_t persisted_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	while (persisted_timestamp < last_timestamp) {
+		uint64_t timestamp = pmemstream_process_persisted(stream);
+		UT_ASSERT(timestamp >= persisted_timestamp);
+		UT_ASSERT(timestamp <= pmemstream_committed_timestamp(stream));
+		persisted_timestamp = timestamp;
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+/* Blocking waits (and a housekeeping thread) run concurrently with (more) appending threads than there are cores. */
+void check_blocking_wait_multithreaded(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	pthread_t append_threads[THREADS_COUNT];
+	pthread_t wait_threads[THREADS_COUNT];
+	struct thread_args args[THREADS_COUNT];
+	struct wait_thread_args wait_args[THREADS_COUNT];
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE / THREADS_COUNT / 2,
+						     &args[i].region);
+		UT_ASSERTeq(ret, 0);
+		args[i].stream = env.stream;
+
+		wait_args[i].stream = env.stream;
+		wait_args[i].first_timestamp = PMEMSTREAM_FIRST_TIMESTAMP + i;
+		wait_args[i].persisted = i % 2;
+	}
+
+	pthread_t housekeeping_thread;
+	UT_ASSERTeq(pthread_create(&housekeeping_thread, NULL, process_thread, env.stream), 0);
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_create(&wait_threads[i], NULL, wait_thread, &wait_args[i]), 0);
+		UT_ASSERTeq(pthread_create(&append_threads[i], NULL, append_thread, &args[i]), 0);
+	}
+	for (size_t i = 0; i < THREADS_COUNT; i++) {
+		UT_ASSERTeq(pthread_join(append_threads[i], NULL), 0);
+		UT_ASSERTeq(pthread_join(wait_threads[i], NULL), 0);
+	}
+	UT_ASSERTeq(pthread_join(housekeeping_thread, NULL), 0);
+
+	const uint64_t expected_timestamp = THREADS_COUNT * ENTRIES_PER_THREAD;
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, expected_timestamp), 0);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), expected_timestamp);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Published entries are committed and persisted without waiting for any particular timestamp. */
+void check_process_committed_and_persisted(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	struct pmemstream_region_runtime *region_runtime;
+	UT_ASSERTeq(pmemstream_region_runtime_initialize(env.stream, region, &region_runtime), 0);
+
+	/* Nothing to process. */
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), PMEMSTREAM_INVALID_TIMESTAMP);
+	UT_ASSERTeq(pmemstream_process_persisted(env.stream), PMEMSTREAM_INVALID_TIMESTAMP);
+
+	for (uint64_t e = 0; e < ENTRIES_PER_THREAD; e++) {
+		struct pmemstream_entry entry;
+		void *data;
+		UT_ASSERTeq(pmemstream_reserve(env.stream, region, region_runtime, sizeof(e), &entry, &data), 0);
+		memcpy(data, &e, sizeof(e));
+		UT_ASSERTeq(pmemstream_async_publish(env.stream, region, region_runtime, entry, sizeof(e)), 0);
+	}
+
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), PMEMSTREAM_INVALID_TIMESTAMP);
+
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), ENTRIES_PER_THREAD);
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), ENTRIES_PER_THREAD);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), PMEMSTREAM_INVALID_TIMESTAMP);
+
+	UT_ASSERTeq(pmemstream_process_persisted(env.stream), ENTRIES_PER_THREAD);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), ENTRIES_PER_THREAD);
+
+	/* Entries are visible after reopen. */
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	UT_ASSERTeq(pmemstream_persisted_timestamp(env.stream), ENTRIES_PER_THREAD);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), count);
+		count++;
+	}
+	UT_ASSERTeq(count, ENTRIES_PER_THREAD);
+	pmemstream_entry_iterator_delete(&it);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Copy of entry data, which completes only once 'copy_completed' is set. */
+static bool copy_completed;
+
+static enum future_state copy_in_progress_impl(struct future_context *ctx, struct future_notifier *notifier)
+{
+	(void)ctx;
+	if (notifier != NULL) {
+		notifier->notifier_used = FUTURE_NOTIFIER_NONE;
+	}
+	return copy_completed ? FUTURE_STATE_COMPLETE : FUTURE_STATE_RUNNING;
+}
+
+/* Entries whose data is still being copied are not waited for: entries preceding them are committed and the rest
+ * is committed by the next call (or by a thread waiting for them). */
+void check_process_committed_does_not_wait_for_copies(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	struct pmemstream_region_runtime *region_runtime;
+	UT_ASSERTeq(pmemstream_region_runtime_initialize(env.stream, region, &region_runtime), 0);
+
+	const uint64_t entries_count = 3;
+	for (uint64_t e = 0; e < entries_count; e++) {
+		struct pmemstream_entry entry;
+		void *data;
+		UT_ASSERTeq(pmemstream_reserve(env.stream, region, region_runtime, sizeof(e), &entry, &data), 0);
+		memcpy(data, &e, sizeof(e));
+		UT_ASSERTeq(pmemstream_async_publish(env.stream, region, region_runtime, entry, sizeof(e)), 0);
+	}
+
+	/* Pretend that copy of the second entry is still in progress. */
+	copy_completed = false;
+	struct async_operation *async_op = &env.stream->async_ops[2 & env.stream->async_ops_mask];
+	FUTURE_INIT(&async_op->future, copy_in_progress_impl);
+
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), 1);
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), 1);
+
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_committed(env.stream, entries_count);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), 1);
+
+	copy_completed = true;
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), entries_count);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+
+	/* Entries released by pmemstream_process_committed are taken over by a waiting thread. */
+	for (uint64_t e = entries_count; e < 2 * entries_count; e++) {
+		struct pmemstream_entry entry;
+		void *data;
+		UT_ASSERTeq(pmemstream_reserve(env.stream, region, region_runtime, sizeof(e), &entry, &data), 0);
+		memcpy(data, &e, sizeof(e));
+		UT_ASSERTeq(pmemstream_async_publish(env.stream, region, region_runtime, entry, sizeof(e)), 0);
+	}
+
+	copy_completed = false;
+	async_op = &env.stream->async_ops[(entries_count + 2) & env.stream->async_ops_mask];
+	FUTURE_INIT(&async_op->future, copy_in_progress_impl);
+
+	UT_ASSERTeq(pmemstream_process_committed(env.stream), entries_count + 1);
+
+	future = pmemstream_async_wait_committed(env.stream, 2 * entries_count);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+	copy_completed = true;
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	UT_ASSERTeq(pmemstream_committed_timestamp(env.stream), 2 * entries_count);
+
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, env.stream, region), 0);
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), count);
+		count++;
+	}
+	UT_ASSERTeq(count, 2 * entries_count);
+	pmemstream_entry_iterator_delete(&it);
+
+	pmemstream_test_teardown(env);
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 2) {
@@ -99,6 +454,11 @@ int main(int argc, char *argv[])
 	null_stream_test(path);
 	invalid_entry_test(path);
 	check_timestamp_and_order(path);
+	check_persisted_timestamp_multithreaded(path);
+	check_persisted_timestamp_read_does_not_flush(path);
+	check_blocking_wait_multithreaded(path);
+	check_process_committed_and_persisted(path);
+	check_process_committed_does_not_wait_for_copies(path);
 
 	return 0;
 }
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * timestamp_lease - unit test for pmemstream_config_set_timestamp_lease_size
+ */
+
+#include "libpmemstream_internal.h"
+#include "unittest.h"
+
+#include <pthread.h>
+
+#define LEASE_SIZE 8
+#define MAX_CONCURRENCY 64
+#define REGIONS_COUNT 4
+#define ENTRIES_PER_REGION 500
+
+struct test_env {
+	struct pmem2_map *map;
+	struct pmemstream *stream;
+};
+
+static struct test_env make_stream(char *path, size_t lease_size, bool truncate)
+{
+	struct test_env env;
+	env.map = map_open(path, TEST_DEFAULT_STREAM_SIZE, truncate);
+	UT_ASSERTne(env.map, NULL);
+
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, MAX_CONCURRENCY), 0);
+	UT_ASSERTeq(pmemstream_config_set_timestamp_lease_size(config, lease_size), 0);
+
+	UT_ASSERTeq(pmemstream_from_map_with_config(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map, config), 0);
+	pmemstream_config_delete(&config);
+
+	return env;
+}
+
+static void teardown(struct test_env env)
+{
+	pmemstream_delete(&env.stream);
+	pmem2_map_delete(&env.map);
+}
+
+/* Verifies that region contains entries with values 0, 1, ..., count - 1 and increasing timestamps. */
+static void verify_region(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t i = 0;
+	uint64_t prev_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	pmemstream_entry_iterator_seek_first(it);
+	while (pmemstream_entry_iterator_is_valid(it) == 0) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), sizeof(uint64_t));
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), i);
+
+		uint64_t timestamp = pmemstream_entry_timestamp(stream, entry);
+		UT_ASSERT(timestamp > prev_timestamp);
+		UT_ASSERT(timestamp <= pmemstream_persisted_timestamp(stream));
+		prev_timestamp = timestamp;
+
+		pmemstream_entry_iterator_next(it);
+		i++;
+	}
+	UT_ASSERTeq(i, count);
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+static void allocate_regions(struct pmemstream *stream, struct pmemstream_region *regions)
+{
+	for (size_t i = 0; i < REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]), 0);
+	}
+}
+
+void test_invalid_lease_size(char *path)
+{
+	struct pmemstream_config *config = NULL;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTne(pmemstream_config_set_timestamp_lease_size(config, 3), 0);
+	UT_ASSERTne(pmemstream_config_set_timestamp_lease_size(NULL, LEASE_SIZE), 0);
+
+	/* Lease does not fit in the async operations' ring. */
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, MAX_CONCURRENCY), 0);
+	UT_ASSERTeq(pmemstream_config_set_timestamp_lease_size(config, MAX_CONCURRENCY), 0);
+
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTne(pmemstream_from_map_with_config(&s, TEST_DEFAULT_BLOCK_SIZE, map, config), 0);
+
+	UT_ASSERTeq(pmemstream_config_set_timestamp_lease_size(config, MAX_CONCURRENCY / 2), 0);
+	UT_ASSERTeq(pmemstream_from_map_with_config(&s, TEST_DEFAULT_BLOCK_SIZE, map, config), 0);
+
+	pmemstream_delete(&s);
+	pmem2_map_delete(&map);
+	pmemstream_config_delete(&config);
+}
+
+/* Appends to multiple regions (interleaved), with each append waiting for commit of the previous ones. */
+void test_interleaved_appends(char *path, size_t lease_size)
+{
+	struct test_env env = make_stream(path, lease_size, true);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(env.stream, regions);
+
+	for (uint64_t e = 0; e < ENTRIES_PER_REGION; e++) {
+		for (size_t r = 0; r < REGIONS_COUNT; r++) {
+			struct pmemstream_entry entry;
+			UT_ASSERTeq(pmemstream_append(env.stream, regions[r], NULL, &e, sizeof(e), &entry), 0);
+			UT_ASSERT(pmemstream_entry_timestamp(env.stream, entry) <=
+				  pmemstream_persisted_timestamp(env.stream));
+		}
+	}
+
+	/* Batch bigger than the lease. */
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	uint64_t values[LEASE_SIZE * 2];
+	const void *data[LEASE_SIZE * 2];
+	size_t sizes[LEASE_SIZE * 2];
+	for (uint64_t i = 0; i < LEASE_SIZE * 2; i++) {
+		values[i] = i;
+		data[i] = &values[i];
+		sizes[i] = sizeof(values[i]);
+	}
+	UT_ASSERTeq(pmemstream_append_batch(env.stream, region, NULL, data, sizes, LEASE_SIZE / 2, NULL), 0);
+	UT_ASSERTeq(pmemstream_append_batch(env.stream, region, NULL, data + LEASE_SIZE / 2, sizes,
+					    LEASE_SIZE * 2 - LEASE_SIZE / 2, NULL),
+		    0);
+
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		verify_region(env.stream, regions[r], ENTRIES_PER_REGION);
+	}
+	verify_region(env.stream, region, LEASE_SIZE * 2);
+
+	teardown(env);
+
+	/* Reopen without leases. */
+	env = make_stream(path, 0, false);
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		verify_region(env.stream, regions[r], ENTRIES_PER_REGION);
+	}
+	verify_region(env.stream, region, LEASE_SIZE * 2);
+	teardown(env);
+}
+
+/* Waiting for an entry from one region forces commit of unused timestamps leased for other regions. */
+void test_async_appends(char *path)
+{
+	struct test_env env = make_stream(path, LEASE_SIZE, true);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(env.stream, regions);
+
+	struct data_mover_sync *dms = data_mover_sync_new();
+	UT_ASSERTne(dms, NULL);
+
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		struct pmemstream_entry entry;
+		for (uint64_t e = 0; e < ENTRIES_PER_REGION; e++) {
+			UT_ASSERTeq(pmemstream_async_append(env.stream, data_mover_sync_get_vdm(dms), regions[r], NULL,
+							    &e, sizeof(e), &entry),
+				    0);
+		}
+
+		uint64_t timestamp = pmemstream_entry_timestamp(env.stream, entry);
+		struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(env.stream, timestamp);
+		while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+			;
+		UT_ASSERT(pmemstream_persisted_timestamp(env.stream) >= timestamp);
+	}
+
+	data_mover_sync_delete(dms);
+
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		verify_region(env.stream, regions[r], ENTRIES_PER_REGION);
+	}
+
+	teardown(env);
+}
+
+struct thread_args {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+};
+
+static void *append_thread(void *arg)
+{
+	struct thread_args *args = arg;
+	for (uint64_t e = 0; e < ENTRIES_PER_REGION; e++) {
+		UT_ASSERTeq(pmemstream_append(args->stream, args->region, NULL, &e, sizeof(e), NULL), 0);
+	}
+
+	return NULL;
+}
+
+void test_concurrent_appends(char *path)
+{
+	struct test_env env = make_stream(path, LEASE_SIZE, true);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(env.stream, regions);
+
+	pthread_t threads[REGIONS_COUNT];
+	struct thread_args args[REGIONS_COUNT];
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		args[r].stream = env.stream;
+		args[r].region = regions[r];
+		UT_ASSERTeq(pthread_create(&threads[r], NULL, append_thread, &args[r]), 0);
+	}
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		UT_ASSERTeq(pthread_join(threads[r], NULL), 0);
+	}
+
+	for (size_t r = 0; r < REGIONS_COUNT; r++) {
+		verify_region(env.stream, regions[r], ENTRIES_PER_REGION);
+	}
+
+	teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	test_invalid_lease_size(path);
+	test_interleaved_appends(path, 0);
+	test_interleaved_appends(path, LEASE_SIZE);
+	test_interleaved_appends(path, 1);
+	test_async_appends(path);
+	test_concurrent_appends(path);
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/**
+ * write_buffer - unit test for pmemstream_write_buffer_new, pmemstream_write_buffer_append,
+ *		pmemstream_write_buffer_flush, pmemstream_write_buffer_poll
+ */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+#include "write_buffer.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define BUFFER_CAPACITY 1024
+#define RECORD_SIZE 32
+#define RECORDS_COUNT 500
+/* This record does not fit in the buffer. */
+#define BIG_RECORD_INDEX 250
+#define BIG_RECORD_SIZE (2 * BUFFER_CAPACITY)
+
+#define THREADS_COUNT 4
+
+struct record {
+	uint64_t thread_id;
+	uint64_t value;
+};
+
+static size_t record_size(uint64_t value)
+{
+	return value == BIG_RECORD_INDEX ? BIG_RECORD_SIZE : RECORD_SIZE;
+}
+
+static void append_records(struct pmemstream_write_buffer *buffer, uint64_t thread_id)
+{
+	uint8_t data[BIG_RECORD_SIZE];
+	for (uint64_t i = 0; i < RECORDS_COUNT; i++) {
+		struct record record = {.thread_id = thread_id, .value = i};
+		memset(data, (int)i, sizeof(data));
+		memcpy(data, &record, sizeof(record));
+		UT_ASSERTeq(pmemstream_write_buffer_append(buffer, data, record_size(i)), 0);
+	}
+}
+
+/* Verifies that records of each thread are stored in the order of appends. */
+static void verify_records(struct pmemstream *stream, struct pmemstream_region region, size_t threads)
+{
+	struct pmemstream_entry_iterator *it;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&it, stream, region), 0);
+
+	uint64_t next_values[THREADS_COUNT] = {0};
+	uint64_t last_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+	     pmemstream_entry_iterator_next(it)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(it);
+		const uint8_t *data = pmemstream_entry_data(stream, entry);
+		struct record record;
+		memcpy(&record, data, sizeof(record));
+
+		UT_ASSERT(record.thread_id < threads);
+		UT_ASSERTeq(record.value, next_values[record.thread_id]);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), record_size(record.value));
+		UT_ASSERTeq(data[record_size(record.value) - 1], (uint8_t)record.value);
+		next_values[record.thread_id]++;
+
+		/* Each entry has its own timestamp. */
+		UT_ASSERTne(pmemstream_entry_timestamp(stream, entry), last_timestamp);
+		last_timestamp = pmemstream_entry_timestamp(stream, entry);
+	}
+	for (size_t t = 0; t < threads; t++) {
+		UT_ASSERTeq(next_values[t], RECORDS_COUNT);
+	}
+
+	pmemstream_entry_iterator_delete(&it);
+}
+
+void test_invalid_args(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(NULL, env.stream, region, BUFFER_CAPACITY, 0), -1);
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, NULL, region, BUFFER_CAPACITY, 0), -1);
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, 0, 0), -1);
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, BUFFER_CAPACITY, 0), 0);
+
+	UT_ASSERTeq(pmemstream_write_buffer_append(NULL, &region, sizeof(region)), -1);
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, NULL, sizeof(region)), -1);
+	UT_ASSERTeq(pmemstream_write_buffer_flush(NULL), PMEMSTREAM_INVALID_TIMESTAMP);
+	UT_ASSERTeq(pmemstream_write_buffer_poll(NULL), -1);
+
+	/* Nothing was appended yet. */
+	UT_ASSERTeq(pmemstream_write_buffer_flush(buffer), PMEMSTREAM_INVALID_TIMESTAMP);
+
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+	UT_ASSERTeq(buffer, NULL);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(NULL), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+void test_append(char *path, uint64_t flags)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE, flags, &region), 0);
+
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, BUFFER_CAPACITY, 0), 0);
+
+	append_records(buffer, 0);
+
+	uint64_t timestamp = pmemstream_write_buffer_flush(buffer);
+	UT_ASSERTne(timestamp, PMEMSTREAM_INVALID_TIMESTAMP);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, timestamp), 0);
+	verify_records(env.stream, region, 1);
+
+	/* Flush without staged entries does not change anything. */
+	UT_ASSERTeq(pmemstream_write_buffer_flush(buffer), timestamp);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+
+	pmemstream_delete(&env.stream);
+	UT_ASSERTeq(pmemstream_from_map(&env.stream, TEST_DEFAULT_BLOCK_SIZE, env.map), 0);
+	verify_records(env.stream, region, 1);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Staged entries are emitted on append, once the deadline passes. */
+void test_deadline(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	struct pmemstream_write_buffer *buffer;
+	const uint64_t max_delay_ns = 1;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, BUFFER_CAPACITY, max_delay_ns), 0);
+
+	uint64_t value = 0;
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(buffer->count, 0);
+	UT_ASSERTeq(buffer->last_timestamp, PMEMSTREAM_FIRST_TIMESTAMP + 1);
+
+	/* Entries emitted on delete are not lost either. */
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(buffer->count, 1);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, PMEMSTREAM_FIRST_TIMESTAMP + 2), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Staged entries are emitted by poll (without further appends), once the deadline passes. */
+void test_poll(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	/* Without a deadline, poll never emits anything. */
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, BUFFER_CAPACITY, 0), 0);
+	uint64_t value = 0;
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_poll(buffer), 0);
+	UT_ASSERTeq(buffer->count, 1);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+
+	const uint64_t max_delay_ns = 1000000000ULL;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, BUFFER_CAPACITY, max_delay_ns), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_poll(buffer), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, &value, sizeof(value)), 0);
+	UT_ASSERTeq(pmemstream_write_buffer_poll(buffer), 0);
+	UT_ASSERTeq(buffer->count, 2);
+
+	/* Pretend that the deadline has passed. */
+	buffer->first_staged_ns -= max_delay_ns;
+	UT_ASSERTeq(pmemstream_write_buffer_poll(buffer), 0);
+	UT_ASSERTeq(buffer->count, 0);
+	UT_ASSERTeq(buffer->last_timestamp, PMEMSTREAM_FIRST_TIMESTAMP + 2);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+	UT_ASSERTeq(pmemstream_wait_persisted(env.stream, PMEMSTREAM_FIRST_TIMESTAMP + 2), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+/* Staged entries which can't be emitted, because the region is full, are reported on flush and on delete. */
+void test_full_region(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &region), 0);
+
+	/* Buffer is bigger than the region. */
+	const size_t capacity = 2 * pmemstream_region_size(env.stream, region);
+	uint8_t data[RECORD_SIZE] = {0};
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, env.stream, region, capacity, 0), 0);
+	while (buffer->staged_size + RECORD_SIZE + sizeof(struct span_entry) <= capacity) {
+		UT_ASSERTeq(pmemstream_write_buffer_append(buffer, data, sizeof(data)), 0);
+	}
+	UT_ASSERTeq(pmemstream_write_buffer_flush(buffer), PMEMSTREAM_INVALID_TIMESTAMP);
+	UT_ASSERTne(buffer->count, 0);
+	UT_ASSERTeq(pmemstream_write_buffer_append(buffer, data, sizeof(data)), -1);
+
+	UT_ASSERTne(pmemstream_write_buffer_delete(&buffer), 0);
+	UT_ASSERTeq(buffer, NULL);
+
+	pmemstream_test_teardown(env);
+}
+
+struct thread_args {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+	uint64_t thread_id;
+	uint64_t timestamp;
+};
+
+static void *append_thread(void *arg)
+{
+	struct thread_args *args = arg;
+
+	struct pmemstream_write_buffer *buffer;
+	UT_ASSERTeq(pmemstream_write_buffer_new(&buffer, args->stream, args->region, BUFFER_CAPACITY, 0), 0);
+	append_records(buffer, args->thread_id);
+	args->timestamp = pmemstream_write_buffer_flush(buffer);
+	UT_ASSERTeq(pmemstream_write_buffer_delete(&buffer), 0);
+
+	UT_ASSERTeq(pmemstream_wait_persisted(args->stream, args->timestamp), 0);
+	return NULL;
+}
+
+/* Each thread uses its own buffer, all of them append to the same region. */
+void test_multi_writer(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate_with_flags(env.stream, TEST_DEFAULT_REGION_SIZE,
+							PMEMSTREAM_REGION_MULTI_WRITER, &region);
+	UT_ASSERTeq(ret, 0);
+
+	pthread_t threads[THREADS_COUNT];
+	struct thread_args args[THREADS_COUNT];
+	for (size_t t = 0; t < THREADS_COUNT; t++) {
+		args[t].stream = env.stream;
+		args[t].region = region;
+		args[t].thread_id = t;
+		UT_ASSERTeq(pthread_create(&threads[t], NULL, append_thread, &args[t]), 0);
+	}
+	for (size_t t = 0; t < THREADS_COUNT; t++) {
+		UT_ASSERTeq(pthread_join(threads[t], NULL), 0);
+	}
+
+	verify_records(env.stream, region, THREADS_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	test_invalid_args(path);
+	test_append(path, 0);
+	test_append(path, PMEMSTREAM_REGION_MULTI_WRITER);
+	test_deadline(path);
+	test_poll(path);
+	test_full_region(path);
+	test_multi_writer(path);
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright 2022, Intel Corporation
+
+include(${TESTS_ROOT_DIR}/cmake/exec_functions.cmake)
+
+setup()
+
+execute(${EXECUTABLE} --path ${DIR}/testfile --element_count 1000 --iterations 1)
+
+finish()
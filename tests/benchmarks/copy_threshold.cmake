@@ -0,0 +1,10 @@
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright 2022, Intel Corporation
+
+include(${TESTS_ROOT_DIR}/cmake/exec_functions.cmake)
+
+setup()
+
+execute(${EXECUTABLE} --path ${DIR}/testfile --max_element_size 4096 --bytes_per_iteration 1048576 --iterations 1)
+
+finish()
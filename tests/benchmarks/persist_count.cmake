@@ -0,0 +1,11 @@
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright 2022, Intel Corporation
+
+include(${TESTS_ROOT_DIR}/cmake/exec_functions.cmake)
+
+setup()
+
+execute(${EXECUTABLE} --path ${DIR}/testfile --batch_size 1)
+execute(${EXECUTABLE} --path ${DIR}/testfile --batch_size 64)
+
+finish()
@@ -116,6 +116,60 @@ struct stream {
 		return {ret, new_entry};
 	}
 
+	std::tuple<int, std::vector<struct pmemstream_entry>>
+	append_batch(struct pmemstream_region region, const std::vector<std::string> &data,
+		     pmemstream_region_runtime *region_runtime = nullptr)
+	{
+		std::vector<const void *> buffers;
+		std::vector<size_t> sizes;
+		for (const auto &d : data) {
+			buffers.push_back(d.data());
+			sizes.push_back(d.size());
+		}
+
+		std::vector<struct pmemstream_entry> new_entries(data.size());
+		auto ret = pmemstream_append_batch(c_stream.get(), region, region_runtime, buffers.data(), sizes.data(),
+						   data.size(), new_entries.data());
+		return {ret, new_entries};
+	}
+
+	std::tuple<int, std::vector<struct pmemstream_entry>>
+	async_append_batch(struct vdm *vdm, struct pmemstream_region region, const std::vector<std::string> &data,
+			   pmemstream_region_runtime *region_runtime = nullptr)
+	{
+		std::vector<const void *> buffers;
+		std::vector<size_t> sizes;
+		for (const auto &d : data) {
+			buffers.push_back(d.data());
+			sizes.push_back(d.size());
+		}
+
+		std::vector<struct pmemstream_entry> new_entries(data.size());
+		auto ret = pmemstream_async_append_batch(c_stream.get(), vdm, region, region_runtime, buffers.data(),
+							 sizes.data(), data.size(), new_entries.data());
+		return {ret, new_entries};
+	}
+
+	std::tuple<int, struct pmemstream_entry> appendv(struct pmemstream_region region,
+							 const std::vector<struct iovec> &iov,
+							 pmemstream_region_runtime *region_runtime = nullptr)
+	{
+		pmemstream_entry new_entry = {0};
+		auto ret = pmemstream_appendv(c_stream.get(), region, region_runtime, iov.data(), iov.size(), &new_entry);
+		return {ret, new_entry};
+	}
+
+	/* 'iov' (and buffers described by it) must remain valid until the entry is committed. */
+	std::tuple<int, struct pmemstream_entry> async_appendv(struct vdm *vdm, struct pmemstream_region region,
+							       const std::vector<struct iovec> &iov,
+							       pmemstream_region_runtime *region_runtime = nullptr)
+	{
+		pmemstream_entry new_entry = {0};
+		auto ret = pmemstream_async_appendv(c_stream.get(), vdm, region, region_runtime, iov.data(), iov.size(),
+						    &new_entry);
+		return {ret, new_entry};
+	}
+
 	std::tuple<int, struct pmemstream_entry> async_append(struct vdm *vdm, struct pmemstream_region region,
 							      const std::string_view &data,
 							      pmemstream_region_runtime *region_runtime = nullptr)
@@ -157,6 +211,13 @@ struct stream {
 		return {ret, region};
 	}
 
+	std::tuple<int, struct pmemstream_region> region_allocate_with_flags(size_t size, uint64_t flags)
+	{
+		pmemstream_region region = {0};
+		int ret = pmemstream_region_allocate_with_flags(c_stream.get(), size, flags, &region);
+		return {ret, region};
+	}
+
 	size_t region_size(pmemstream_region region)
 	{
 		return pmemstream_region_size(c_stream.get(), region);
@@ -402,6 +463,40 @@ struct pmemstream_helpers_type {
 		}
 	}
 
+	void append_batch(struct pmemstream_region region, const std::vector<std::string> &data)
+	{
+		pmemstream_region_runtime *rrt = nullptr;
+		auto it = region_runtime.find(region.offset);
+		if (it != region_runtime.end()) {
+			rrt = it->second;
+		}
+
+		auto [ret, entries] = stream.append_batch(region, data, rrt);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	future_wrapper<pmemstream_async_wait_fut> async_append_batch(struct pmemstream_region region,
+								     const std::vector<std::string> &data)
+	{
+		struct vdm *thread_mover = data_mover_threads_get_vdm(thread_mover_handle.get());
+
+		pmemstream_region_runtime *rrt = nullptr;
+		auto it = region_runtime.find(region.offset);
+		if (it != region_runtime.end()) {
+			rrt = it->second;
+		}
+
+		auto [ret, entries] = stream.async_append_batch(thread_mover, region, data, rrt);
+		UT_ASSERTeq(ret, 0);
+
+		if (data.size()) {
+			auto future = stream.async_wait_persisted(stream.entry_timestamp(entries.back()));
+			return future_wrapper<pmemstream_async_wait_fut>(std::move(future));
+		} else {
+			return future_wrapper<pmemstream_async_wait_fut>();
+		}
+	}
+
 	struct pmemstream_region initialize_single_region(size_t region_size, const std::vector<std::string> &data)
 	{
 		auto [ret, region] = stream.region_allocate(region_size);
@@ -40,13 +40,24 @@ std::string span_to_str(const struct span_base *base)
 	std::map<uint64_t, const std::string> span_type_names = {{SPAN_ENTRY, std::string("entry")},
 								 {SPAN_REGION, std::string("region")},
 								 {SPAN_EMPTY, std::string("empty")},
-								 {SPAN_UNKNOWN, std::string("unknown")}};
+								 {SPAN_COMPACT_ENTRY, std::string("compact entry")}};
 
 	span_type type = span_get_type(base);
 	std::string span_str = "type: " + span_type_names[type] + ", data size: " + std::to_string(span_get_size(base));
 	if (type == SPAN_ENTRY) {
 		auto entry = (const struct span_entry *)base;
 		span_str += ", timestamp: " + std::to_string(entry->timestamp);
+		if (span_entry_has_checksum(base)) {
+			auto checksummed_entry = (const struct span_checksummed_entry *)base;
+			span_str += ", checksum: " + std::to_string(checksummed_entry->checksum);
+		} else if (span_entry_is_compressed(base)) {
+			auto compressed_entry = (const struct span_compressed_entry *)base;
+			span_str += ", codec: " + std::to_string(span_compressed_entry_get_codec(compressed_entry)) +
+				", uncompressed size: " +
+				std::to_string(span_compressed_entry_get_uncompressed_size(compressed_entry));
+		}
+	} else if (type == SPAN_COMPACT_ENTRY) {
+		span_str += ", timestamp delta: " + std::to_string(span_compact_entry_get_timestamp_delta(base));
 	}
 	return span_str;
 }
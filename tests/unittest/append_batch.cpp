@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * append_batch.cpp -- pmemstream_append_batch and pmemstream_async_append_batch functional test.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "rapidcheck_helpers.hpp"
+#include "span.h"
+#include "stream_helpers.hpp"
+#include "unittest.hpp"
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::cout << "Usage: " << argv[0] << " file-path" << std::endl;
+		return -1;
+	}
+
+	struct test_config_type test_config;
+	test_config.filename = std::string(argv[1]);
+
+	return run_test(test_config, [&] {
+		return_check ret;
+
+		ret += rc::check("verify if mixing regular appends with batched appends works fine",
+				 [&](pmemstream_with_single_empty_region &&stream, const std::vector<std::string> &data,
+				     const std::vector<std::string> &extra_data, const bool batch_first, bool reopen) {
+					 auto region = stream.helpers.get_first_region();
+
+					 if (batch_first) {
+						 stream.helpers.append_batch(region, data);
+						 stream.helpers.append(region, extra_data);
+					 } else {
+						 stream.helpers.append(region, data);
+						 stream.helpers.append_batch(region, extra_data);
+					 }
+
+					 if (reopen)
+						 stream.reopen();
+
+					 stream.helpers.verify(region, data, extra_data);
+				 });
+
+		ret += rc::check("verify if mixing async appends with async batched appends works fine",
+				 [&](pmemstream_with_single_empty_region &&stream, const std::vector<std::string> &data,
+				     const std::vector<std::string> &extra_data, const bool batch_first) {
+					 auto region = stream.helpers.get_first_region();
+
+					 if (batch_first) {
+						 stream.helpers.async_append_batch(region, data);
+						 stream.helpers.async_append(region, extra_data);
+					 } else {
+						 stream.helpers.async_append(region, data);
+						 stream.helpers.async_append_batch(region, extra_data);
+					 }
+
+					 stream.helpers.verify(region, data, extra_data);
+				 });
+
+		ret += rc::check("verify if entries within a batch get consecutive timestamps and are persisted together",
+				 [&](pmemstream_with_single_empty_region &&stream, const std::vector<std::string> &data) {
+					 RC_PRE(data.size() > 0);
+					 auto region = stream.helpers.get_first_region();
+
+					 auto persisted_before = stream.sut.persisted_timestamp();
+					 auto [ret, entries] = stream.sut.append_batch(region, data);
+					 UT_ASSERTeq(ret, 0);
+					 UT_ASSERTeq(entries.size(), data.size());
+
+					 for (size_t i = 0; i < entries.size(); i++) {
+						 UT_ASSERTeq(stream.sut.entry_timestamp(entries[i]), persisted_before + i + 1);
+						 UT_ASSERT(stream.sut.get_entry(entries[i]) == data[i]);
+					 }
+					 UT_ASSERTeq(stream.sut.persisted_timestamp(),
+						     stream.sut.entry_timestamp(entries.back()));
+					 UT_ASSERTeq(stream.sut.committed_timestamp(), stream.sut.persisted_timestamp());
+				 });
+
+		ret += rc::check("verify if batch which does not fit in a region is not appended at all",
+				 [&](pmemstream_with_single_empty_region &&stream, const std::vector<std::string> &data) {
+					 auto region = stream.helpers.get_first_region();
+					 auto usable_size = stream.sut.region_usable_size(region);
+
+					 auto extra_data = data;
+					 extra_data.push_back(std::string(usable_size, 'X'));
+
+					 auto [ret, entries] = stream.sut.append_batch(region, extra_data);
+					 UT_ASSERTeq(ret, -1);
+					 UT_ASSERTeq(stream.sut.region_usable_size(region), usable_size);
+
+					 stream.helpers.append_batch(region, data);
+					 stream.helpers.verify(region, data, {});
+				 });
+
+		/* verify if an empty batch does not append anything */
+		{
+			pmemstream_with_single_empty_region stream(make_default_test_stream());
+			auto region = stream.helpers.get_first_region();
+
+			auto [ret, entries] = stream.sut.append_batch(region, {});
+			UT_ASSERTeq(ret, 0);
+			UT_ASSERTeq(stream.sut.region_size(region), stream.sut.region_usable_size(region));
+			stream.helpers.verify(region, {}, {});
+		}
+	});
+}
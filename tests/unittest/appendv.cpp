@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * appendv.cpp -- pmemstream_appendv and pmemstream_async_appendv functional test.
+ */
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "rapidcheck_helpers.hpp"
+#include "stream_helpers.hpp"
+#include "unittest.hpp"
+
+static std::vector<struct iovec> make_iovec(const std::vector<std::string> &segments)
+{
+	std::vector<struct iovec> iov;
+	for (const auto &segment : segments) {
+		iov.push_back({const_cast<char *>(segment.data()), segment.size()});
+	}
+	return iov;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::cout << "Usage: " << argv[0] << " file-path" << std::endl;
+		return -1;
+	}
+
+	struct test_config_type test_config;
+	test_config.filename = std::string(argv[1]);
+
+	return run_test(test_config, [&] {
+		return_check ret;
+
+		ret += rc::check("verify if entry appended from multiple segments holds their concatenation",
+				 [&](pmemstream_with_single_empty_region &&stream,
+				     const std::vector<std::vector<std::string>> &entries, bool reopen) {
+					 auto region = stream.helpers.get_first_region();
+
+					 std::vector<std::string> expected;
+					 for (const auto &segments : entries) {
+						 auto [ret, new_entry] = stream.sut.appendv(region, make_iovec(segments));
+						 UT_ASSERTeq(ret, 0);
+
+						 expected.push_back(
+							 std::accumulate(segments.begin(), segments.end(), std::string()));
+						 UT_ASSERT(stream.sut.get_entry(new_entry) == expected.back());
+					 }
+
+					 if (reopen)
+						 stream.reopen();
+
+					 stream.helpers.verify(region, expected, {});
+				 });
+
+		ret += rc::check("verify if mixing async vectored appends with regular appends works fine",
+				 [&](pmemstream_with_single_empty_region &&stream, const std::vector<std::string> &segments,
+				     const std::vector<std::string> &extra_data) {
+					 auto region = stream.helpers.get_first_region();
+					 struct vdm *thread_mover =
+						 data_mover_threads_get_vdm(stream.helpers.thread_mover_handle.get());
+
+					 auto iov = make_iovec(segments);
+					 auto [ret, new_entry] = stream.sut.async_appendv(thread_mover, region, iov);
+					 UT_ASSERTeq(ret, 0);
+					 stream.helpers.append(region, extra_data);
+
+					 {
+						 /* make sure the entry is committed before iov is destroyed */
+						 future_wrapper<pmemstream_async_wait_fut> future(
+							 stream.sut.async_wait_persisted(stream.sut.entry_timestamp(new_entry)));
+					 }
+
+					 auto data = std::accumulate(segments.begin(), segments.end(), std::string());
+					 stream.helpers.verify(region, {data}, extra_data);
+				 });
+
+		/* verify if appendv with no segments appends an empty entry */
+		{
+			pmemstream_with_single_empty_region stream(make_default_test_stream());
+			auto region = stream.helpers.get_first_region();
+
+			auto [ret, new_entry] = stream.sut.appendv(region, {});
+			UT_ASSERTeq(ret, 0);
+			UT_ASSERTeq(stream.sut.get_entry(new_entry).size(), 0);
+			stream.helpers.verify(region, {std::string()}, {});
+		}
+
+		/* and entry which does not fit in a region cannot be appended */
+		{
+			pmemstream_with_single_empty_region stream(make_default_test_stream());
+			auto region = stream.helpers.get_first_region();
+			auto region_size = stream.sut.region_size(region);
+
+			auto segment = std::string(region_size, 'W');
+			auto [ret, new_entry] = stream.sut.appendv(region, make_iovec({segment, segment}));
+			UT_ASSERTeq(ret, -1);
+			UT_ASSERTeq(stream.sut.region_size(region), stream.sut.region_usable_size(region));
+		}
+	});
+}
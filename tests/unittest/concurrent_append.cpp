@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * concurrent_append.cpp -- verifies appends from multiple threads, each to a separate region.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "common/util.h"
+#include "rapidcheck_helpers.hpp"
+#include "stream_helpers.hpp"
+#include "thread_helpers.hpp"
+#include "unittest.hpp"
+
+static constexpr size_t max_write_concurrency = 8;
+static constexpr size_t max_size = 64; /* Max number of elements in stream and max size of single entry. */
+static constexpr size_t region_size = ALIGN_UP(max_size * max_size * 10, 4096ULL); /* 10x-margin */
+static constexpr size_t stream_size =
+	max_write_concurrency * (region_size + REGION_METADATA_SIZE) + STREAM_METADATA_SIZE;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::cout << "Usage: " << argv[0] << " file-path" << std::endl;
+		return -1;
+	}
+
+	struct test_config_type test_config;
+	test_config.stream_size = stream_size;
+	test_config.filename = std::string(argv[1]);
+	test_config.rc_params["noshrink"] = "1";
+	test_config.rc_params["max_size"] = std::to_string(max_size);
+
+	return run_test(test_config, [&] {
+		return_check ret;
+
+		ret += rc::check(
+			"verify if synchronous appends from multiple threads are all persisted",
+			[&](pmemstream_empty &&stream, const std::vector<std::string> &data, bool use_batch, bool reopen,
+			    concurrency_type<1, max_write_concurrency> concurrency) {
+				auto regions = stream.helpers.allocate_regions(concurrency, region_size);
+
+				parallel_exec(concurrency, [&](size_t tid) {
+					if (use_batch) {
+						auto [ret, entries] = stream.sut.append_batch(regions[tid], data);
+						UT_ASSERTeq(ret, 0);
+					} else {
+						for (auto &e : data) {
+							auto [ret, entry] = stream.sut.append(regions[tid], e);
+							UT_ASSERTeq(ret, 0);
+							/* Append returns only after the entry is persisted. */
+							UT_ASSERT(stream.sut.entry_timestamp(entry) <=
+								  stream.sut.persisted_timestamp());
+						}
+					}
+				});
+
+				UT_ASSERTeq(stream.sut.persisted_timestamp(), concurrency * data.size());
+
+				if (reopen)
+					stream.reopen();
+
+				for (auto &region : regions) {
+					stream.helpers.verify(region, data, {});
+				}
+			});
+
+		ret += rc::check(
+			"verify if async appends from multiple threads, exceeding number of in-flight operations, complete",
+			[&](pmemstream_empty &&stream, concurrency_type<1, max_write_concurrency> concurrency) {
+				/* Each thread issues more operations than can be in flight at once, without waiting. */
+				static constexpr size_t entries_per_thread = 1500;
+				const std::vector<std::string> data(entries_per_thread, std::string(8, 'x'));
+
+				auto regions = stream.helpers.allocate_regions(concurrency, region_size);
+
+				auto *dms = data_mover_sync_new();
+				parallel_exec(concurrency, [&](size_t tid) {
+					struct pmemstream_entry entry;
+					for (auto &e : data) {
+						auto [ret, new_entry] =
+							stream.sut.async_append(data_mover_sync_get_vdm(dms), regions[tid], e);
+						UT_ASSERTeq(ret, 0);
+						entry = new_entry;
+					}
+
+					auto future = stream.sut.async_wait_persisted(stream.sut.entry_timestamp(entry));
+					while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+						;
+				});
+				data_mover_sync_delete(dms);
+
+				for (auto &region : regions) {
+					stream.helpers.verify(region, data, {});
+				}
+			});
+	});
+}
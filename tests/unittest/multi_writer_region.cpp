@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2022, Intel Corporation */
+
+/*
+ * multi_writer_region.cpp -- verifies appends from multiple threads into a region allocated with
+ *			      PMEMSTREAM_REGION_MULTI_WRITER flag.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "common/util.h"
+#include "rapidcheck_helpers.hpp"
+#include "stream_helpers.hpp"
+#include "thread_helpers.hpp"
+#include "unittest.hpp"
+
+static constexpr size_t max_write_concurrency = 8;
+static constexpr size_t max_size = 64; /* Max number of elements in stream and max size of single entry. */
+static constexpr size_t region_size =
+	ALIGN_UP(max_write_concurrency * max_size * max_size * 10, 4096ULL); /* 10x-margin */
+static constexpr size_t stream_size = (region_size + REGION_METADATA_SIZE) + STREAM_METADATA_SIZE;
+
+namespace
+{
+std::vector<std::string> sorted(std::vector<std::string> v)
+{
+	std::sort(v.begin(), v.end());
+	return v;
+}
+
+/* Entries in multi-writer region are not ordered - compare them as multisets. */
+void verify_unordered(pmemstream_test_base &stream, pmemstream_region region, const std::vector<std::string> &expected)
+{
+	auto elements = stream.helpers.get_elements_in_region(region);
+	UT_ASSERTeq(elements.size(), expected.size());
+	UT_ASSERT(sorted(elements) == sorted(expected));
+
+	/* Each entry must have an unique timestamp. */
+	std::set<uint64_t> timestamps;
+	auto eiter = stream.sut.entry_iterator(region);
+	for (pmemstream_entry_iterator_seek_first(eiter.get()); pmemstream_entry_iterator_is_valid(eiter.get()) == 0;
+	     pmemstream_entry_iterator_next(eiter.get())) {
+		timestamps.insert(stream.sut.entry_timestamp(pmemstream_entry_iterator_get(eiter.get())));
+	}
+	UT_ASSERTeq(timestamps.size(), expected.size());
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::cout << "Usage: " << argv[0] << " file-path" << std::endl;
+		return -1;
+	}
+
+	struct test_config_type test_config;
+	test_config.stream_size = stream_size;
+	test_config.filename = std::string(argv[1]);
+	test_config.rc_params["noshrink"] = "1";
+	test_config.rc_params["max_size"] = std::to_string(max_size);
+
+	return run_test(test_config, [&] {
+		return_check ret;
+
+		ret += rc::check("verify if region allocation with unknown flags fails", [&](pmemstream_empty &&stream) {
+			auto [ret, region] = stream.sut.region_allocate_with_flags(region_size, ~0ULL);
+			UT_ASSERTeq(ret, -1);
+		});
+
+		ret += rc::check(
+			"verify if concurrent appends (and batched appends) to a multi-writer region store all entries",
+			[&](pmemstream_empty &&stream, const std::vector<std::string> &data, bool use_batch, bool reopen,
+			    concurrency_type<1, max_write_concurrency> concurrency) {
+				auto [ret, region] =
+					stream.sut.region_allocate_with_flags(region_size, PMEMSTREAM_REGION_MULTI_WRITER);
+				UT_ASSERTeq(ret, 0);
+
+				parallel_exec(concurrency, [&](size_t tid) {
+					if (use_batch && tid % 2 == 0) {
+						auto [ret, entries] = stream.sut.append_batch(region, data);
+						UT_ASSERTeq(ret, 0);
+					} else {
+						for (auto &e : data) {
+							auto [ret, entry] = stream.sut.append(region, e);
+							UT_ASSERTeq(ret, 0);
+						}
+					}
+				});
+
+				std::vector<std::string> all_data;
+				for (size_t i = 0; i < concurrency; i++)
+					all_data.insert(all_data.end(), data.begin(), data.end());
+
+				verify_unordered(stream, region, all_data);
+
+				if (reopen) {
+					stream.reopen();
+					verify_unordered(stream, region, all_data);
+				}
+			});
+
+		ret += rc::check(
+			"verify if entries reserved but not published before reopen are skipped by iterators",
+			[&](pmemstream_empty &&stream, const std::vector<std::string> &data,
+			    const std::vector<std::string> &extra_data, const std::string &reserved) {
+				auto [ret, region] =
+					stream.sut.region_allocate_with_flags(region_size, PMEMSTREAM_REGION_MULTI_WRITER);
+				UT_ASSERTeq(ret, 0);
+
+				stream.helpers.append(region, data);
+
+				auto [reserve_ret, reserved_entry, reserved_data] = stream.sut.reserve(region, reserved.size());
+				UT_ASSERTeq(reserve_ret, 0);
+
+				/* Entries appended after the reserved one are committed before it. */
+				stream.helpers.append(region, extra_data);
+
+				stream.reopen();
+
+				std::vector<std::string> expected = data;
+				expected.insert(expected.end(), extra_data.begin(), extra_data.end());
+				UT_ASSERT(stream.helpers.get_elements_in_region(region) == expected);
+
+				/* Region must be still usable after recovery. */
+				stream.helpers.append(region, data);
+				expected.insert(expected.end(), data.begin(), data.end());
+				UT_ASSERT(stream.helpers.get_elements_in_region(region) == expected);
+
+				stream.reopen();
+				UT_ASSERT(stream.helpers.get_elements_in_region(region) == expected);
+			});
+	});
+}